@@ -0,0 +1,60 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <liburing.h>
+#include <iostream>
+#include <string_view>
+#include "utils.h"
+#include "coroutine.h"
+
+// Copy a file with registered files and fixed buffers.
+// Usage: ./copy_fixed <from> <to>
+
+constexpr size_t CHUNK_SIZE = 64 * 1024;
+constexpr unsigned CONCURRENCY = 16;
+
+// Chunks [worker, worker + CONCURRENCY, ...].
+Task copy_chunks(io_uring *uring, Io_context &io_context,
+                 Fixed_file from, Fixed_file to, size_t size_bytes, size_t worker) {
+    // One lease per worker, never exhausted.
+    auto buf = io_context.lease_buffer();
+    assert(buf);
+    for(size_t offset = worker * CHUNK_SIZE; offset < size_bytes; offset += CONCURRENCY * CHUNK_SIZE) {
+        auto n = std::min(CHUNK_SIZE, size_bytes - offset);
+        auto nread = co_await async_read_fixed(uring, from, buf, n, offset) | nofail("read_fixed");
+        // Short write is not expected for regular files.
+        co_await async_write_fixed(uring, to, buf, nread, offset) | nofail("write_fixed");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <from> <to>" << std::endl;
+        return 1;
+    }
+    int from_fd = open(argv[1], O_RDONLY) | nofail("open");
+    int to_fd = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0644) | nofail("open");
+    struct stat stat;
+    fstat(from_fd, &stat) | nofail("fstat");
+
+    io_uring uring;
+    constexpr size_t ENTRIES = 64;
+    io_uring_queue_init(ENTRIES, &uring, 0) | nofail("io_uring_queue_init");
+    auto uring_cleanup = defer([&](...) { io_uring_queue_exit(&uring); });
+
+    Io_context io_context{uring};
+    io_context.register_files(2) | nofail("register_files");
+    io_context.register_buffers(CONCURRENCY, CHUNK_SIZE) | nofail("register_buffers");
+    auto from = io_context.register_file(from_fd);
+    auto to = io_context.register_file(to_fd);
+    from.index | nofail("register_file");
+    to.index | nofail("register_file");
+    // Held by the file table now.
+    close(from_fd);
+    close(to_fd);
+
+    for(size_t worker = 0; worker < CONCURRENCY; ++worker) {
+        co_spawn(io_context, copy_chunks(&uring, io_context, from, to, stat.st_size, worker));
+    }
+    while(!io_context.drained()) io_context.run_once();
+}
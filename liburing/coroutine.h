@@ -9,6 +9,10 @@
 #include <chrono>
 #include <algorithm>
 #include <ranges>
+#include <numeric>
+#include <vector>
+#include <cstdlib>
+#include <functional>
 #include <cassert>
 #include "utils.h"
 
@@ -87,6 +91,8 @@ struct Async_user_data {
     io_uring_sqe *sqe;
     io_uring_cqe *cqe;
     std::coroutine_handle<> h;
+    // Multishot operations: called for every cqe instead of resuming `h`.
+    void (*on_cqe)(Async_user_data *, io_uring_cqe *) {};
 };
 
 // Currently `Result` is unused.
@@ -127,18 +133,399 @@ inline auto async_operation(io_uring *uring, auto uring_prep_fn, auto &&...args)
     return Async_operation<Result>(uring, uring_prep_fn, std::forward<decltype(args)>(args)...);
 }
 
+// An index of the registered file table (IOSQE_FIXED_FILE).
+// A negative index is -ERRNO.
+struct Fixed_file {
+    int index;
+};
+
+class Fixed_buffer_pool;
+
+// RAII: a registered buffer, returned to its pool on destruction.
+// The pool (Io_context) must outlive the lease.
+class Buffer_lease {
+public:
+    Buffer_lease() = default;
+    Buffer_lease(Fixed_buffer_pool *pool, int index, char *data, size_t size) noexcept
+        : _pool(pool), _index(index), _data(data), _size(size) {}
+    Buffer_lease(Buffer_lease &&rhs) noexcept
+        : _pool(std::exchange(rhs._pool, nullptr)), _index(rhs._index), _data(rhs._data), _size(rhs._size) {}
+    Buffer_lease& operator=(Buffer_lease &&rhs) noexcept {
+        if(this != &rhs) {
+            release();
+            _pool = std::exchange(rhs._pool, nullptr);
+            _index = rhs._index;
+            _data = rhs._data;
+            _size = rhs._size;
+        }
+        return *this;
+    }
+    ~Buffer_lease() { release(); }
+
+    // False if the pool is exhausted.
+    explicit operator bool() const noexcept { return _pool; }
+    char* data() const noexcept { return _data; }
+    size_t size() const noexcept { return _size; }
+    // `buf_index` of read_fixed/write_fixed.
+    int index() const noexcept { return _index; }
+    inline void release() noexcept;
+
+private:
+    Fixed_buffer_pool *_pool {};
+    int _index {-1};
+    char *_data {};
+    size_t _size {};
+};
+
+// Equal-sized buffers in one page-aligned block, registered once (io_uring_register_buffers).
+// The kernel pins the pages at registration instead of per operation.
+class Fixed_buffer_pool {
+public:
+    Fixed_buffer_pool() = default;
+    Fixed_buffer_pool(const Fixed_buffer_pool &) = delete;
+    Fixed_buffer_pool& operator=(const Fixed_buffer_pool &) = delete;
+
+    // Return: 0 or -ERRNO.
+    int init(io_uring &uring, unsigned count, size_t buffer_size) {
+        constexpr size_t PAGE = 4096;
+        assert(!_memory && count > 0 && buffer_size > 0);
+        auto bytes = (count * buffer_size + PAGE - 1) / PAGE * PAGE;
+        _memory.reset(static_cast<char*>(std::aligned_alloc(PAGE, bytes)));
+        if(!_memory) return -ENOMEM;
+        std::vector<iovec> iovecs(count);
+        for(unsigned i = 0; i < count; ++i) {
+            iovecs[i] = {_memory.get() + i * buffer_size, buffer_size};
+        }
+        if(int ret = io_uring_register_buffers(&uring, iovecs.data(), count); ret < 0) {
+            _memory.reset();
+            return ret;
+        }
+        _buffer_size = buffer_size;
+        // Lease from index 0.
+        _free.resize(count);
+        std::iota(_free.rbegin(), _free.rend(), 0);
+        return 0;
+    }
+
+    // An empty lease if exhausted.
+    Buffer_lease lease() noexcept {
+        if(_free.empty()) return {};
+        int index = _free.back();
+        _free.pop_back();
+        return {this, index, _memory.get() + index * _buffer_size, _buffer_size};
+    }
+
+    bool registered() const noexcept { return !!_memory; }
+    size_t available() const noexcept { return _free.size(); }
+    size_t buffer_size() const noexcept { return _buffer_size; }
+
+private:
+    friend class Buffer_lease;
+    void give_back(int index) noexcept { _free.push_back(index); }
+
+    struct Free { void operator()(char *p) const noexcept { std::free(p); } };
+    std::unique_ptr<char[], Free> _memory;
+    std::vector<int> _free;
+    size_t _buffer_size {};
+};
+
+inline void Buffer_lease::release() noexcept {
+    if(auto pool = std::exchange(_pool, nullptr)) {
+        pool->give_back(_index);
+    }
+}
+
+class Provided_buffer_ring;
+
+// RAII: a buffer picked by the kernel from the provided buffer ring,
+// recycled to the ring on destruction.
+class Provided_buffer {
+public:
+    Provided_buffer() = default;
+    Provided_buffer(Provided_buffer_ring *ring, int bid, char *data, size_t size) noexcept
+        : _ring(ring), _bid(bid), _data(data), _size(size) {}
+    Provided_buffer(Provided_buffer &&rhs) noexcept
+        : _ring(std::exchange(rhs._ring, nullptr)), _bid(rhs._bid), _data(rhs._data), _size(rhs._size) {}
+    Provided_buffer& operator=(Provided_buffer &&rhs) noexcept {
+        if(this != &rhs) {
+            release();
+            _ring = std::exchange(rhs._ring, nullptr);
+            _bid = rhs._bid;
+            _data = rhs._data;
+            _size = rhs._size;
+        }
+        return *this;
+    }
+    ~Provided_buffer() { release(); }
+
+    explicit operator bool() const noexcept { return _ring; }
+    char* data() const noexcept { return _data; }
+    // Received bytes.
+    size_t size() const noexcept { return _size; }
+    int bid() const noexcept { return _bid; }
+    inline void release() noexcept;
+
+private:
+    Provided_buffer_ring *_ring {};
+    int _bid {-1};
+    char *_data {};
+    size_t _size {};
+};
+
+// Buffers shared by all connections (io_uring_buf_ring), the kernel picks one per recv.
+// Memory is sized for the active set instead of per connection.
+class Provided_buffer_ring {
+public:
+    // Recycled buffers are published to the kernel in batches.
+    constexpr static int RECYCLE_BATCH = 32;
+
+    Provided_buffer_ring() = default;
+    Provided_buffer_ring(const Provided_buffer_ring &) = delete;
+    Provided_buffer_ring& operator=(const Provided_buffer_ring &) = delete;
+    ~Provided_buffer_ring() {
+        if(_ring) io_uring_free_buf_ring(_uring, _ring, _entries, _group_id);
+    }
+
+    // `entries`: a power of 2.
+    // Return: 0 or -ERRNO.
+    int init(io_uring &uring, unsigned entries, size_t buffer_size, int group_id) {
+        assert(!_ring && entries > 0 && !(entries & (entries - 1)));
+        _memory.reset(static_cast<char*>(std::aligned_alloc(64, entries * buffer_size)));
+        if(!_memory) return -ENOMEM;
+        int ret;
+        if(!(_ring = io_uring_setup_buf_ring(&uring, entries, group_id, 0, &ret))) {
+            _memory.reset();
+            return ret;
+        }
+        _uring = &uring;
+        _entries = entries;
+        _mask = io_uring_buf_ring_mask(entries);
+        _buffer_size = buffer_size;
+        _group_id = group_id;
+        for(unsigned bid = 0; bid < entries; ++bid) {
+            io_uring_buf_ring_add(_ring, data(bid), buffer_size, bid, _mask, bid);
+        }
+        io_uring_buf_ring_advance(_ring, entries);
+        return 0;
+    }
+
+    Provided_buffer lease(int bid, size_t size) noexcept {
+        return {this, bid, data(bid), size};
+    }
+
+    void recycle(int bid) noexcept {
+        io_uring_buf_ring_add(_ring, data(bid), _buffer_size, bid, _mask, _uncommitted);
+        if(++_uncommitted >= RECYCLE_BATCH) commit();
+    }
+
+    // Called by io_context before submit, so no recycled buffer is held back.
+    void commit() noexcept {
+        if(_uncommitted) io_uring_buf_ring_advance(_ring, std::exchange(_uncommitted, 0));
+    }
+
+    bool registered() const noexcept { return _ring; }
+    int group_id() const noexcept { return _group_id; }
+    size_t buffer_size() const noexcept { return _buffer_size; }
+    char* data(int bid) const noexcept { return _memory.get() + bid * _buffer_size; }
+
+private:
+    struct Free { void operator()(char *p) const noexcept { std::free(p); } };
+    std::unique_ptr<char[], Free> _memory;
+    io_uring *_uring {};
+    io_uring_buf_ring *_ring {};
+    unsigned _entries {};
+    int _mask {};
+    size_t _buffer_size {};
+    int _group_id {};
+    int _uncommitted {};
+};
+
+inline void Provided_buffer::release() noexcept {
+    if(auto ring = std::exchange(_ring, nullptr)) {
+        ring->recycle(_bid);
+    }
+}
+
+// res > 0: `buffer` holds res bytes.
+// res == 0: EOF (or the stream is closed).
+// res < 0: -ERRNO, -ENOBUFS means the buffer ring ran dry, the next() re-arms.
+struct Recv_result {
+    int res;
+    Provided_buffer buffer;
+};
+
+// One multishot recv sqe (IORING_RECV_MULTISHOT + IOSQE_BUFFER_SELECT) yields many cqes.
+// Results are queued until next() and the sqe is re-armed only when the kernel terminates it,
+// a final cqe with data (e.g. the CQ was full) does not close the stream.
+//
+// Examples:
+//   auto stream = io_context.recv_multishot(fd);
+//   for(auto [n, buf] = co_await stream.next(); n > 0; ...) {...}
+//
+// NOTE: The stream must not be destroyed while armed,
+// drain it by an EOF/error result, or by `co_await stream.close()`.
+class Multishot_recv: Async_user_data {
+public:
+    Multishot_recv(io_uring *uring, Provided_buffer_ring &buffers, int fd) noexcept
+        : _buffers(buffers), _fd(fd)
+    {
+        Async_user_data::uring = uring;
+        on_cqe = &Multishot_recv::on_recv;
+        _cancel.on_cqe = [](Async_user_data *, io_uring_cqe *) {};
+    }
+    // Address-stable, it is the user data of in-flight sqes.
+    Multishot_recv(const Multishot_recv &) = delete;
+    Multishot_recv& operator=(const Multishot_recv &) = delete;
+    ~Multishot_recv() { assert(!_armed); }
+
+    auto next() noexcept {
+        struct awaiter {
+            bool await_ready() noexcept {
+                if(self->_head == self->_ready.size() && !self->_armed && !self->_closed) {
+                    self->arm();
+                }
+                return self->_head < self->_ready.size() || !self->_armed;
+            }
+            void await_suspend(std::coroutine_handle<> h) noexcept { self->_waiting = h; }
+            Recv_result await_resume() noexcept { return self->pop(); }
+
+            Multishot_recv *self;
+        };
+        return awaiter{this};
+    }
+
+    // Cancel the in-flight sqe and drop the queued results.
+    Task close() {
+        _closed = true;
+        if(_armed) {
+            if(auto sqe = io_uring_get_sqe(Async_user_data::uring)) [[likely]] {
+                io_uring_prep_cancel(sqe, static_cast<Async_user_data*>(this), 0);
+                io_uring_sqe_set_data(sqe, &_cancel);
+            }
+        }
+        while(_armed || _head < _ready.size()) {
+            co_await next();
+        }
+    }
+
+    bool armed() const noexcept { return _armed; }
+
+private:
+    struct Result {
+        int res;
+        unsigned flags;
+    };
+
+    void arm() noexcept {
+        auto sqe = io_uring_get_sqe(Async_user_data::uring);
+        if(!sqe) [[unlikely]] {
+            _ready.push_back({-ENOMEM, 0});
+            return;
+        }
+        io_uring_prep_recv_multishot(sqe, _fd, nullptr, 0, 0);
+        io_uring_sqe_set_flags(sqe, IOSQE_BUFFER_SELECT);
+        sqe->buf_group = _buffers.group_id();
+        io_uring_sqe_set_data(sqe, static_cast<Async_user_data*>(this));
+        _armed = true;
+    }
+
+    static void on_recv(Async_user_data *user_data, io_uring_cqe *cqe) {
+        auto self = static_cast<Multishot_recv*>(user_data);
+        self->_ready.push_back({cqe->res, cqe->flags});
+        if(!(cqe->flags & IORING_CQE_F_MORE)) {
+            self->_armed = false;
+            // Terminated by EOF or an error.
+            // A dry buffer ring (-ENOBUFS) or a full CQ (res > 0) also ends it,
+            // the stream is still open and the next() re-arms.
+            if(cqe->res == 0 || (cqe->res < 0 && cqe->res != -ENOBUFS)) self->_closed = true;
+        }
+        if(auto h = std::exchange(self->_waiting, nullptr)) {
+            h.resume();
+        }
+    }
+
+    Recv_result pop() noexcept {
+        // Closed and drained.
+        if(_head == _ready.size()) return {0, {}};
+        auto [res, flags] = _ready[_head++];
+        if(_head == _ready.size()) {
+            // No allocation after the first burst.
+            _ready.clear();
+            _head = 0;
+        }
+        if(!(flags & IORING_CQE_F_BUFFER)) return {res, {}};
+        int bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        return {res, _buffers.lease(bid, res > 0 ? res : 0)};
+    }
+
+    Provided_buffer_ring &_buffers;
+    int _fd;
+    bool _armed {false};
+    bool _closed {false};
+    std::coroutine_handle<> _waiting;
+    std::vector<Result> _ready;
+    size_t _head {};
+    // User data of the cancel sqe, its cqe is ignored.
+    Async_user_data _cancel {};
+};
+
+// Setup flags for the ring of an io_context.
+struct Io_uring_options {
+    // A kernel thread polls the SQ, submit needs no syscall while it is awake.
+    // io_uring_submit() wakes it up when IORING_SQ_NEED_WAKEUP is set.
+    bool sqpoll {false};
+    unsigned sqpoll_idle_ms {1000};
+    // Task work runs at the next kernel entry instead of interrupting the task (5.19+).
+    bool coop_taskrun {false};
+    // Task work runs only when waiting for cqes (6.1+).
+    // Single issuer thread, not compatible with SQPOLL.
+    bool defer_taskrun {false};
+};
+
+// Return: 0 or -ERRNO.
+inline int setup_uring(io_uring &uring, unsigned entries, const Io_uring_options &options = {}) {
+    io_uring_params params {};
+    if(options.sqpoll) {
+        params.flags |= IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = options.sqpoll_idle_ms;
+    }
+    if(options.coop_taskrun) {
+        params.flags |= IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+    }
+    if(options.defer_taskrun) {
+        params.flags |= IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_TASKRUN_FLAG;
+    }
+    return io_uring_queue_init_params(entries, &uring, &params);
+}
+
+struct Io_context_options {
+    // Keep polling after the last completion before sleeping in the kernel.
+    // Trades CPU for wakeup latency, 0: sleep as soon as idle.
+    std::chrono::nanoseconds busy_poll {};
+};
+
 // A quite simple io_context.
 class Io_context {
 public:
-    explicit Io_context(io_uring &uring): uring(uring) {}
+    using Clock = std::chrono::steady_clock;
+
+    explicit Io_context(io_uring &uring, Io_context_options options = {})
+        : uring(uring), _options(options) {}
     Io_context(const Io_context &) = delete;
     Io_context& operator=(const Io_context &) = delete;
+    ~Io_context() {
+        if(_buffers.registered()) io_uring_unregister_buffers(&uring);
+        if(_files_registered) io_uring_unregister_files(&uring);
+    }
 
-    void run() { for(_stop = false; running(); run_once()); }
+    // Returns when stopped, or drained since nothing can resume it then.
+    void run() { for(_stop = false; running() && !drained(); run_once()); }
 
     // Once = submit + reap.
+    // Waits in the kernel if idle, see Io_context_options.
     template <bool Exactly_once = false>
     void run_once() {
+        expire();
         auto loop_count = Exactly_once ? runtime_once() : runtime_plug();
         for(auto _ : std::views::iota(0, loop_count)) {
             auto h = _operations.front();
@@ -148,38 +535,50 @@ public:
             [](...){}(_);
         }
 
-        // TODO: SQPOLL.
-        if((_inflight += io_uring_submit(&uring)) == 0) {
-            hang();
-            return;
+        if(_provided_buffers.registered()) {
+            _provided_buffers.commit();
         }
 
+        // SQPOLL: only wakes up the sq thread if needed.
+        _inflight += io_uring_submit(&uring);
+
         // Some cqes are in-flight,
         // even if we currently have no any h.resume().
         // Just continue along the path!
 
-        io_uring_cqe *cqe;
-        unsigned head;
-        unsigned done = 0;
-        // Reap one operation / multiple operations.
-        // NOTE: One operation can also generate multiple cqes (awaiters).
-        io_uring_for_each_cqe(&uring, head, cqe) {
-            done++;
-            auto user_data = std::bit_cast<Async_user_data*>(cqe->user_data);
-            user_data->cqe = cqe;
-            user_data->h.resume();
+        if(reap() || loop_count) {
+            _last_active = Clock::now();
+            return;
         }
-        done ? io_uring_cq_advance(&uring, done) : hang();
+        if(_operations.empty() && idle()) {
+            reap();
+            _last_active = Clock::now();
+        }
+    }
+
+    // Resumed by run_once() once `deadline` is reached.
+    auto sleep_until(Clock::time_point deadline) {
+        struct awaiter {
+            bool await_ready() const noexcept { return deadline <= Clock::now(); }
+            void await_suspend(std::coroutine_handle<> h) { self->_timers.emplace(deadline, h); }
+            constexpr void await_resume() const noexcept {}
 
-        assert(_inflight >= done);
-        _inflight -= done;
+            Io_context *self;
+            Clock::time_point deadline;
+        };
+        return awaiter{this, deadline};
+    }
+
+    auto sleep_for(std::chrono::nanoseconds duration) {
+        return sleep_until(Clock::now() + duration);
     }
 
     // Some observable IO statistics.
     // These APIs are not affected by stop flag.
     auto pending() const { return _operations.size(); }
     auto inflight() const noexcept { return _inflight; }
-    bool drained() const { return !pending() && !inflight(); }
+    // Operations resumed by cqes may have prepared sqes that are not submitted yet.
+    bool drained() const { return !pending() && !inflight() && !io_uring_sq_ready(&uring) && _timers.empty(); }
 
     // Only affect the run() interface.
     // The stop flag will be reset upon re-run().
@@ -195,18 +594,138 @@ public:
     bool stopped() const { return _stop && !pending(); }
     bool running() const { return !stopped(); }
 
+    // Registered resources.
+    // Saves the fd lookup (fget/fput) and the page pinning of every operation.
+    // They are not thread-safe, same as the io_context itself.
+
+    // An empty file table with `count` slots, filled by register_file().
+    // Return: 0 or -ERRNO.
+    int register_files(unsigned count) {
+        assert(!_files_registered);
+        if(int ret = io_uring_register_files_sparse(&uring, count); ret < 0) {
+            return ret;
+        }
+        _files_registered = true;
+        _free_files.resize(count);
+        std::iota(_free_files.rbegin(), _free_files.rend(), 0);
+        return 0;
+    }
+
+    // The table holds its own reference, `fd` can be closed after this.
+    Fixed_file register_file(int fd) {
+        if(_free_files.empty()) return {-ENFILE};
+        int index = _free_files.back();
+        if(int ret = io_uring_register_files_update(&uring, index, &fd, 1); ret < 0) {
+            return {ret};
+        }
+        _free_files.pop_back();
+        return {index};
+    }
+
+    // In-flight operations on this file are not affected.
+    void unregister_file(Fixed_file file) {
+        int removed = -1;
+        io_uring_register_files_update(&uring, file.index, &removed, 1);
+        _free_files.push_back(file.index);
+    }
+
+    // `count` buffers of `buffer_size` bytes, leased by lease_buffer().
+    // Return: 0 or -ERRNO (e.g. -ENOMEM if RLIMIT_MEMLOCK is too small).
+    int register_buffers(unsigned count, size_t buffer_size) {
+        return _buffers.init(uring, count, buffer_size);
+    }
+
+    // An empty lease if exhausted.
+    Buffer_lease lease_buffer() noexcept { return _buffers.lease(); }
+    Fixed_buffer_pool& buffers() noexcept { return _buffers; }
+
+    // A provided buffer ring shared by all multishot recvs.
+    // `entries`: a power of 2, sized for the active connections rather than all of them.
+    // Return: 0 or -ERRNO.
+    int setup_buffer_ring(unsigned entries, size_t buffer_size, int group_id = 0) {
+        return _provided_buffers.init(uring, entries, buffer_size, group_id);
+    }
+
+    Multishot_recv recv_multishot(int fd) {
+        assert(_provided_buffers.registered());
+        return {&uring, _provided_buffers, fd};
+    }
+
     friend void co_spawn(Io_context &io_context, Task &&task) {
         io_context._operations.emplace(task.detach());
     }
 
 private:
-    void hang() {
-        // TODO: config option, event driven.
-        constexpr bool ENABLE_BUSY_LOOP = false;
-        if constexpr (!ENABLE_BUSY_LOOP) {
-            // FIXME: yield() in a single thread makes no sense.
-            using namespace std::chrono_literals;
-            std::this_thread::sleep_for(1ns);
+    // Return: the number of cqes.
+    unsigned reap() {
+        io_uring_cqe *cqe;
+        unsigned head;
+        unsigned done = 0;
+        // The last cqe of a sqe.
+        unsigned finished = 0;
+        // Reap one operation / multiple operations.
+        // NOTE: One operation can also generate multiple cqes (awaiters).
+        io_uring_for_each_cqe(&uring, head, cqe) {
+            done++;
+            // Internal timeout of io_uring_submit_and_wait_timeout() on kernels without EXT_ARG.
+            if(cqe->user_data == LIBURING_UDATA_TIMEOUT) [[unlikely]] {
+                continue;
+            }
+            if(!(cqe->flags & IORING_CQE_F_MORE)) finished++;
+            auto user_data = std::bit_cast<Async_user_data*>(cqe->user_data);
+            if(user_data->on_cqe) {
+                user_data->on_cqe(user_data, cqe);
+                continue;
+            }
+            user_data->cqe = cqe;
+            user_data->h.resume();
+        }
+        if(done) io_uring_cq_advance(&uring, done);
+
+        assert(_inflight >= finished);
+        _inflight -= finished;
+        return done;
+    }
+
+    // Nothing completed and nothing to resume.
+    // Return: true if it has waited in the kernel.
+    bool idle() {
+        auto now = Clock::now();
+        if(now - _last_active < _options.busy_poll) {
+            // Completions of DEFER_TASKRUN (or pending COOP_TASKRUN work) are posted
+            // only when entering the kernel.
+            if((uring.flags & IORING_SETUP_DEFER_TASKRUN)
+                    || (IO_URING_READ_ONCE(*uring.sq.kflags) & IORING_SQ_TASKRUN)) {
+                io_uring_get_events(&uring);
+            }
+            return false;
+        }
+        // Nothing can wake it up, run() returns as drained.
+        if(!_inflight && _timers.empty()) {
+            return false;
+        }
+        io_uring_cqe *cqe;
+        if(_timers.empty()) {
+            io_uring_submit_and_wait(&uring, 1);
+        } else {
+            using namespace std::chrono;
+            auto timeout = std::max<Clock::duration>(_timers.top().first - now, {});
+            auto timeout_s = duration_cast<seconds>(timeout);
+            auto ts = __kernel_timespec {
+                .tv_sec = timeout_s.count(),
+                .tv_nsec = duration_cast<nanoseconds>(timeout - timeout_s).count()
+            };
+            io_uring_submit_and_wait_timeout(&uring, &cqe, 1, &ts, nullptr);
+        }
+        // Expired timers are resumed in the next run_once().
+        return true;
+    }
+
+    void expire() {
+        if(_timers.empty()) return;
+        for(auto now = Clock::now(); !_timers.empty() && _timers.top().first <= now;) {
+            _operations.emplace(_timers.top().second);
+            _timers.pop();
         }
     }
 
@@ -223,6 +742,14 @@ private:
     std::queue<std::coroutine_handle<>> _operations;
     size_t _inflight {};
     bool _stop {false};
+    std::vector<int> _free_files;
+    bool _files_registered {false};
+    Fixed_buffer_pool _buffers;
+    Provided_buffer_ring _provided_buffers;
+    Io_context_options _options;
+    Clock::time_point _last_active {Clock::now()};
+    using Timer = std::pair<Clock::time_point, std::coroutine_handle<>>;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<>> _timers;
     // TODO: work_guard;
 };
 
@@ -251,3 +778,46 @@ inline auto async_close(io_uring *uring, int fd) {
     return async_operation(uring,
         io_uring_prep_close, fd);
 }
+
+// Same as `uring_prep_fn`, but the fd argument is an index of the registered file table.
+inline auto fixed_file(auto uring_prep_fn) {
+    return [=](io_uring_sqe *sqe, auto &&...args) {
+        uring_prep_fn(sqe, std::forward<decltype(args)>(args)...);
+        io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+    };
+}
+
+inline auto async_read(io_uring *uring, Fixed_file file, void *buf, size_t n, int flags = 0) {
+    return async_operation(uring,
+        fixed_file(io_uring_prep_read), file.index, buf, n, flags);
+}
+
+inline auto async_write(io_uring *uring, Fixed_file file, const void *buf, size_t n, int flags = 0) {
+    return async_operation(uring,
+        fixed_file(io_uring_prep_write), file.index, buf, n, flags);
+}
+
+// `n` bytes at the beginning of a leased buffer.
+inline auto async_read_fixed(io_uring *uring, int fd, const Buffer_lease &buf, size_t n, uint64_t offset = 0) {
+    assert(buf && n <= buf.size());
+    return async_operation(uring,
+        io_uring_prep_read_fixed, fd, buf.data(), n, offset, buf.index());
+}
+
+inline auto async_write_fixed(io_uring *uring, int fd, const Buffer_lease &buf, size_t n, uint64_t offset = 0) {
+    assert(buf && n <= buf.size());
+    return async_operation(uring,
+        io_uring_prep_write_fixed, fd, buf.data(), n, offset, buf.index());
+}
+
+inline auto async_read_fixed(io_uring *uring, Fixed_file file, const Buffer_lease &buf, size_t n, uint64_t offset = 0) {
+    assert(buf && n <= buf.size());
+    return async_operation(uring,
+        fixed_file(io_uring_prep_read_fixed), file.index, buf.data(), n, offset, buf.index());
+}
+
+inline auto async_write_fixed(io_uring *uring, Fixed_file file, const Buffer_lease &buf, size_t n, uint64_t offset = 0) {
+    assert(buf && n <= buf.size());
+    return async_operation(uring,
+        fixed_file(io_uring_prep_write_fixed), file.index, buf.data(), n, offset, buf.index());
+}
@@ -0,0 +1,65 @@
+#include <unistd.h>
+#include <netinet/in.h>
+#include <liburing.h>
+#include <utility>
+#include <iostream>
+#include <algorithm>
+#include <array>
+#include <ranges>
+#include <iterator>
+#include "utils.h"
+#include "coroutine.h"
+
+// Same as echo_coroutine.cpp, but connections have no buffer of their own.
+// Received data are in the buffer ring shared by all connections.
+
+Task echo(io_uring *uring, Io_context &io_context, int client_fd) {
+    auto stream = io_context.recv_multishot(client_fd);
+    for(;;) {
+        auto [n, buf] = co_await stream.next();
+        // The buffer ring ran dry, re-armed by the next().
+        if(n == -ENOBUFS) continue;
+        n | nofail("recv");
+        // EOF, the stream is terminated by kernel.
+        if(n == 0) break;
+
+        auto printer = std::ostream_iterator<char>{std::cout};
+        std::ranges::copy_n(buf.data(), n, printer);
+
+        co_await async_write(uring, client_fd, buf.data(), n) | nofail("write");
+
+        bool close_proactive = n > 2 && buf.data()[0] == 'Z' && buf.data()[1] == 'z';
+        if(close_proactive) {
+            co_await stream.close();
+            break;
+        }
+        // `buf` is recycled here.
+    }
+    co_await async_close(uring, client_fd);
+}
+
+Task server(io_uring *uring, Io_context &io_context, int server_fd) {
+    for(;;) {
+        auto client_fd = co_await async_accept(uring, server_fd) | nofail("accept");
+        // Fork a new connection.
+        co_spawn(io_context, echo(uring, io_context, client_fd));
+    }
+}
+
+int main() {
+    auto server_fd = make_server(8849);
+    auto server_fd_cleanup = defer([&](...) { close(server_fd); });
+
+    io_uring uring;
+    constexpr size_t ENTRIES = 256;
+    io_uring_queue_init(ENTRIES, &uring, 0);
+    auto uring_cleanup = defer([&](...) { io_uring_queue_exit(&uring); });
+
+    Io_context io_context{uring};
+    // 256 x 4 KiB for all connections.
+    constexpr unsigned BUFFERS = 256;
+    constexpr size_t BUFFER_SIZE = 4096;
+    io_context.setup_buffer_ring(BUFFERS, BUFFER_SIZE) | nofail("setup_buffer_ring");
+    co_spawn(io_context, server(&uring, io_context, server_fd));
+    io_context.run();
+}
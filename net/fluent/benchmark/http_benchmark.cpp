@@ -0,0 +1,225 @@
+// wrk-style local load generator for the fluent HTTP codec
+//
+// g++ -std=c++17 -O2 -pthread http_benchmark.cpp -o http_benchmark
+//
+// ./http_benchmark                      in-process server + load
+// ./http_benchmark server [port]        server only (MultiServer)
+// ./http_benchmark load [port]          load only, e.g. against another server
+// ./http_benchmark parse                parser only, ns/request
+//
+// load options (environment):
+//   THREADS=2 CONNECTIONS=64 PIPELINE=16 DURATION=5 (seconds) REACTORS=2
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <bits/stdc++.h>
+#include "../fluent.hpp"
+#include "../include/http/HttpCodec.h"
+
+using namespace fluent;
+using Clock = std::chrono::steady_clock;
+
+static const char REQUEST[] =
+    "GET /plaintext HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) Gecko/20100101 Firefox/120.0\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+static size_t env(const char *name, size_t fallback) {
+    const char *value = ::getenv(name);
+    return value ? std::strtoul(value, nullptr, 10) : fallback;
+}
+
+static void runServer(uint16_t port, std::atomic<bool> *ready, MultiServer **handle) {
+    MultiServer server {InetAddress{INADDR_ANY, port}, env("REACTORS", 2)};
+    server.onConnect([](Context *context) {
+        context->socket.setNoDelay();
+        context->any = HttpCodec{};
+    });
+    server.onMessage([](Context *context) {
+        cast<HttpCodec>(&context->any)->serve(context, [](const HttpRequest &request, HttpResponse &response) {
+            response.status(200)
+                    .header("Server", "fluent")
+                    .header("Content-Type", "text/plain")
+                    .keepAlive(request.keepAlive)
+                    .body("Hello, World!");
+        });
+    });
+    server.ready();
+    if(handle) *handle = &server;
+    if(ready) ready->store(true);
+    server.run();
+}
+
+// count complete responses in [data, data + length)
+// return: consumed bytes
+static size_t countResponses(const char *data, size_t length, size_t &responses) {
+    size_t consumed = 0;
+    for(;;) {
+        std::string_view rest {data + consumed, length - consumed};
+        size_t head = rest.find("\r\n\r\n");
+        if(head == std::string_view::npos) break;
+        size_t body = 0;
+        size_t field = rest.substr(0, head).find("Content-Length: ");
+        if(field != std::string_view::npos) body = std::strtoul(rest.data() + field + 16, nullptr, 10);
+        if(rest.size() < head + 4 + body) break;
+        consumed += head + 4 + body;
+        responses++;
+    }
+    return consumed;
+}
+
+struct LoadResult {
+    size_t requests {0};
+    size_t errors {0};
+    // per pipelined batch, microseconds
+    std::vector<uint32_t> latencies;
+};
+
+static void runLoad(uint16_t port, size_t connections, size_t pipeline, Clock::time_point deadline, LoadResult &result) {
+    struct Connection {
+        int fd;
+        std::string input;
+        size_t waiting;
+        Clock::time_point start;
+    };
+    std::string batch;
+    for(size_t i = 0; i < pipeline; ++i) batch += REQUEST;
+
+    int epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    std::vector<Connection> conns(connections);
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    auto fire = [&](Connection &conn) {
+        conn.waiting = pipeline;
+        conn.start = Clock::now();
+        if(::send(conn.fd, batch.data(), batch.size(), MSG_NOSIGNAL) != ssize_t(batch.size())) result.errors++;
+    };
+    for(size_t i = 0; i < connections; ++i) {
+        auto &conn = conns[i];
+        conn.fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if(::connect(conn.fd, (sockaddr*)&address, sizeof address)) {
+            ::perror("connect");
+            ::exit(1);
+        }
+        int on = 1;
+        ::setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+        epoll_event event {};
+        event.events = EPOLLIN;
+        event.data.u64 = i;
+        ::epoll_ctl(epollFd, EPOLL_CTL_ADD, conn.fd, &event);
+        fire(conn);
+    }
+    epoll_event events[256];
+    char buffer[1 << 16];
+    while(Clock::now() < deadline) {
+        int count = ::epoll_wait(epollFd, events, 256, 100);
+        for(int i = 0; i < count; ++i) {
+            auto &conn = conns[events[i].data.u64];
+            ssize_t n = ::recv(conn.fd, buffer, sizeof buffer, 0);
+            if(n <= 0) {
+                result.errors++;
+                ::epoll_ctl(epollFd, EPOLL_CTL_DEL, conn.fd, nullptr);
+                continue;
+            }
+            conn.input.append(buffer, n);
+            size_t responses = 0;
+            conn.input.erase(0, countResponses(conn.input.data(), conn.input.size(), responses));
+            result.requests += responses;
+            conn.waiting -= std::min(conn.waiting, responses);
+            if(conn.waiting == 0) {
+                auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - conn.start);
+                result.latencies.push_back(elapsed.count());
+                fire(conn);
+            }
+        }
+    }
+    for(auto &conn : conns) ::close(conn.fd);
+    ::close(epollFd);
+}
+
+static void load(uint16_t port) {
+    size_t threads = env("THREADS", 2);
+    size_t connections = env("CONNECTIONS", 64);
+    size_t pipeline = env("PIPELINE", 16);
+    size_t duration = env("DURATION", 5);
+    std::printf("%zu threads, %zu connections, pipeline %zu, %zus\n", threads, connections, pipeline, duration);
+
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::seconds(duration);
+    std::vector<LoadResult> results(threads);
+    std::vector<std::thread> workers;
+    for(size_t i = 0; i < threads; ++i) {
+        size_t share = connections / threads + (i < connections % threads);
+        workers.emplace_back(runLoad, port, share, pipeline, deadline, std::ref(results[i]));
+    }
+    for(auto &worker : workers) worker.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    LoadResult total;
+    for(auto &result : results) {
+        total.requests += result.requests;
+        total.errors += result.errors;
+        total.latencies.insert(total.latencies.end(), result.latencies.begin(), result.latencies.end());
+    }
+    std::sort(total.latencies.begin(), total.latencies.end());
+    auto percentile = [&](double p) -> uint32_t {
+        if(total.latencies.empty()) return 0;
+        return total.latencies[std::min(total.latencies.size() - 1, size_t(p * total.latencies.size()))];
+    };
+    std::printf("requests: %zu, errors: %zu\n", total.requests, total.errors);
+    std::printf("requests/sec: %.0f\n", total.requests / seconds);
+    std::printf("batch latency (us): p50 %u, p90 %u, p99 %u, max %u\n",
+        percentile(0.5), percentile(0.9), percentile(0.99), percentile(1.0));
+}
+
+static void parse() {
+    constexpr size_t PIPELINE = 64;
+    constexpr size_t ROUNDS = 100000;
+    std::string input;
+    for(size_t i = 0; i < PIPELINE; ++i) input += REQUEST;
+    HttpParser parser;
+    HttpRequest request;
+    size_t headers = 0;
+    auto start = Clock::now();
+    for(size_t round = 0; round < ROUNDS; ++round) {
+        size_t consumed = 0;
+        while(parser.parse(input.data() + consumed, input.size() - consumed, request) == HttpParser::Status::COMPLETE) {
+            consumed += request.length;
+            headers += request.headerCount;
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    std::printf("parse: %.1f ns/request (%zu bytes, %zu headers)\n",
+        ns / (ROUNDS * PIPELINE), sizeof(REQUEST) - 1, headers / (ROUNDS * PIPELINE));
+}
+
+int main(int argc, char *argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    uint16_t port = argc > 2 ? std::atoi(argv[2]) : 8848;
+    if(mode == "server") {
+        runServer(port, nullptr, nullptr);
+    } else if(mode == "load") {
+        load(port);
+    } else if(mode == "parse") {
+        parse();
+    } else {
+        std::atomic<bool> ready {false};
+        MultiServer *server = nullptr;
+        std::thread thread {runServer, port, &ready, &server};
+        while(!ready) std::this_thread::yield();
+        load(port);
+        std::printf("server: %s\n", Metrics::aggregate().toString().c_str());
+        server->stop();
+        thread.join();
+    }
+}
@@ -1,5 +1,7 @@
 #ifndef __FLUENT_HPP__
 #define __FLUENT_HPP__
 #include "include/app/Client.h"
+#include "include/app/ClientPool.h"
 #include "include/app/Server.h"
+#include "include/app/MultiServer.h"
 #endif
\ No newline at end of file
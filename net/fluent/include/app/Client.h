@@ -2,6 +2,7 @@
 #define __FLUENT_APP_CLIENT_H__
 #include <bits/stdc++.h>
 #include "../future/Futures.h"
+#include "../utils/Timestamp.h"
 #include "../network/Multiplexer.h"
 #include "../network/Connector.h"
 #include "../network/Pool.h"
@@ -10,31 +11,51 @@ namespace fluent {
 
 template <typename ConnectCallback,
           typename MessageCallback,
-          typename CloseCallback>
+          typename CloseCallback,
+          typename Codec = RawCodec>
 class BaseClient;
 
 using Client = BaseClient<std::function<void(Context*)>,
                           std::function<void(Context*)>,
                           std::function<void(Context*)>>;
 
+// message callback: void(Context*, Frame) per complete frame, see codec/Codec.h
+template <typename Codec>
+using FramedClient = BaseClient<std::function<void(Context*)>,
+                                std::function<void(Context*, Frame)>,
+                                std::function<void(Context*)>,
+                                Codec>;
+
 
 template <typename ConnectCallback,
           typename MessageCallback,
-          typename CloseCallback>
+          typename CloseCallback,
+          typename Codec>
 class BaseClient {
 public:
     using ConnectCallbackType = ConnectCallback;
     using MessageCallbackType = MessageCallback;
     using CloseCallbackType   = CloseCallback;
-    using HandlerType = Handler<ConnectCallback, MessageCallback, CloseCallback>;
+    using CodecType           = Codec;
+    using HandlerType = Handler<ConnectCallback, MessageCallback, CloseCallback, Codec>;
+
+    // upper bound of blocking poll
+    // stop() from other threads should be followed by looper()->postRemote() to wake it up
+    constexpr static Millisecond POLL_TIMEOUT_LIMIT {100};
 
 public:
-    void run() { for(_stop = false; !_stop; ) batch(); }
-    void batch();
+    // block in multiplexer until the nearest timer
+    void run() { for(_stop = false; !_stop; ) batch(_looper.nextTimeout(POLL_TIMEOUT_LIMIT)); }
+    // non-blocking
+    void batch() { batch(Millisecond::zero()); }
+    // timeout: multiplexer timeout, ignored if multiplexer is outer
+    void batch(Millisecond timeout);
 
     // connect group
-    // future: in client loop
-    Future<Context*> connect(InetAddress address);
+    // future: in client loop, resolved by the write event (no polling)
+    //         nullptr if it is not connected within timeout (0: retry until connected)
+    // C++20: Context *context = co_await client.connect(address);
+    Future<Context*> connect(InetAddress address, Millisecond timeout = Millisecond::zero());
 
     // callback: T(context*), no restriction on the return type T
     template <typename F>
@@ -43,10 +64,14 @@ public:
     void stop() { _stop = true; }
 
     Looper* looper() { return &_looper; }
+    // connection slab: live/free/high-water
+    Pool::Stats connectionStats() const { return _connections.stats(); }
 
     void onConnect(ConnectCallback callback) { _handler.onConnect(std::move(callback)); }
     void onMessage(MessageCallback callback) { _handler.onMessage(std::move(callback)); }
     void onClose(CloseCallback callback) { _handler.onClose(std::move(callback)); }
+    // framing codec options, e.g. max frame
+    void setCodec(Codec codec) { _handler.setCodec(std::move(codec)); }
 
     BaseClient();
     BaseClient(std::shared_ptr<Multiplexer> multiplexer);
@@ -77,76 +102,71 @@ private:
     bool _stop {false};
 };
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline void BaseClient<ConnectCallback, MessageCallback, CloseCallback>::batch() {
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void BaseClient<ConnectCallback, MessageCallback, CloseCallback, Codec>::batch(Millisecond timeout) {
+    auto begin = TimerClock::now();
     if(!_isOuterMultiplexer) {
-        _multiplexer->poll(std::chrono::milliseconds::zero());
+        _multiplexer->poll(timeout);
     }
+    auto ready = TimerClock::now();
     _handler.handleEvents(_token);
+    _connections.retire(_handler.closed());
+    _connections.retire(_connector.abandoned());
     _looper.loop();
+    _looper.metrics().recordTurn(begin, ready, TimerClock::now());
 }
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline Future<Context*> BaseClient<ConnectCallback, MessageCallback, CloseCallback>::connect(InetAddress address) {
-    return _connector.connect(address)
-        .then([this](std::pair<InetAddress, Socket> &&contextArgs) {
-            auto &address = contextArgs.first;
-            auto &socket = contextArgs.second;
-            Multiplexer::Bundle bundle = _connections.emplace(_token, &_looper, address, std::move(socket));
-            _handler.handleNewContext(bundle);
-            auto context = &bundle->second;
-            context->ensureLifecycle();
-            return context;
-        });
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline Future<Context*> BaseClient<ConnectCallback, MessageCallback, CloseCallback, Codec>::connect(InetAddress address, Millisecond timeout) {
+    Multiplexer::Bundle bundle = _connections.emplace(_token, &_looper, address, Socket());
+    bundle->second.ensureLifecycle();
+    return _connector.connect(_multiplexer.get(), bundle, timeout);
 }
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
 template <typename F>
-inline auto BaseClient<ConnectCallback, MessageCallback, CloseCallback>::connect(InetAddress address, F &&callback)
+inline auto BaseClient<ConnectCallback, MessageCallback, CloseCallback, Codec>::connect(InetAddress address, F &&callback)
 -> Future<typename FunctionTraits<F>::ReturnType> {
-    return _connector.connect(address)
-        .then([this, callback = std::forward<F>(callback)](std::pair<InetAddress, Socket> &&contextArgs) {
-            auto &address = contextArgs.first;
-            auto &socket = contextArgs.second;
-            Multiplexer::Bundle bundle = _connections.emplace(_token, &_looper, address, std::move(socket));
-            _handler.handleNewContext(bundle);
-            auto context = &bundle->second;
-            context->ensureLifecycle();
-            return callback(context);
-        });
+    return connect(address).then(std::forward<F>(callback));
 }
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline BaseClient<ConnectCallback, MessageCallback, CloseCallback>::
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline BaseClient<ConnectCallback, MessageCallback, CloseCallback, Codec>::
 BaseClient()
-    : _multiplexer(std::make_shared<Multiplexer>()),
+    : _multiplexer(std::make_shared<Multiplexer>(Exclusive{})),
       _isOuterMultiplexer(false),
       _token(_multiplexer->token()),
       _connector(&_looper),
-      _handler(_multiplexer.get()) {}
+      _handler(_multiplexer.get()) {
+    _multiplexer->watch(_looper.wakeupFd());
+}
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline BaseClient<ConnectCallback, MessageCallback, CloseCallback>::
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline BaseClient<ConnectCallback, MessageCallback, CloseCallback, Codec>::
 BaseClient(std::shared_ptr<Multiplexer> multiplexer)
     : _multiplexer(std::move(multiplexer)),
       _isOuterMultiplexer(true),
       _token(_multiplexer->token()),
       _connector(&_looper),
-      _handler(_multiplexer.get()) {}
+      _handler(_multiplexer.get()) {
+    _multiplexer->watch(_looper.wakeupFd());
+}
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline BaseClient<ConnectCallback, MessageCallback, CloseCallback>::
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline BaseClient<ConnectCallback, MessageCallback, CloseCallback, Codec>::
 BaseClient(ConnectCallback connectCallback,
            MessageCallback messageCallback,
            CloseCallback   closeCallback)
-    : _multiplexer(std::make_shared<Multiplexer>()),
+    : _multiplexer(std::make_shared<Multiplexer>(Exclusive{})),
       _isOuterMultiplexer(false),
       _token(_multiplexer->token()),
       _connector(&_looper),
-      _handler(_multiplexer.get(), std::move(connectCallback), std::move(messageCallback), std::move(closeCallback)) {}
+      _handler(_multiplexer.get(), std::move(connectCallback), std::move(messageCallback), std::move(closeCallback)) {
+    _multiplexer->watch(_looper.wakeupFd());
+}
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline BaseClient<ConnectCallback, MessageCallback, CloseCallback>::
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline BaseClient<ConnectCallback, MessageCallback, CloseCallback, Codec>::
 BaseClient(std::shared_ptr<Multiplexer> multiplexer,
            ConnectCallback connectCallback,
            MessageCallback messageCallback,
@@ -155,7 +175,9 @@ BaseClient(std::shared_ptr<Multiplexer> multiplexer,
        _isOuterMultiplexer(true),
        _token(_multiplexer->token()),
        _connector(&_looper),
-       _handler(_multiplexer.get(), std::move(connectCallback), std::move(messageCallback), std::move(closeCallback)) {}
+       _handler(_multiplexer.get(), std::move(connectCallback), std::move(messageCallback), std::move(closeCallback)) {
+    _multiplexer->watch(_looper.wakeupFd());
+}
 
 } // fluent
 #endif
\ No newline at end of file
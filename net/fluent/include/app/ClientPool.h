@@ -0,0 +1,375 @@
+#ifndef __FLUENT_APP_CLIENT_POOL_H__
+#define __FLUENT_APP_CLIENT_POOL_H__
+#include <bits/stdc++.h>
+#include "../future/Futures.h"
+#include "../utils/Timestamp.h"
+#include "../network/InetAddress.h"
+#include "../logger/Logger.h"
+#include "Client.h"
+namespace fluent {
+
+// client-side connection pool, keyed by backend address
+//
+// - connections are reused and pipelined, responses are matched in order by framer
+// - a request goes to the least loaded connection (or power of two choices)
+// - new connections are made by Connector (async) when all connections are full, up to maxConnections
+// - a connection not made in connectTimeout is dropped, waiting requests fail if nothing else can serve them
+// - health check evicts stuck (requestTimeout) and idle (idleTimeout) connections, keeps minConnections
+//
+// all methods are called in the pool looper
+class ClientPool {
+public:
+    enum class Selection {
+        LEAST_OUTSTANDING,
+        POWER_OF_TWO_CHOICES,
+    };
+
+    struct Options {
+        size_t minConnections {1};
+        size_t maxConnections {8};
+        // in-flight requests per connection
+        size_t maxPipeline {32};
+        Selection selection {Selection::LEAST_OUTSTANDING};
+        // close idle connections above minConnections, 0: never
+        Millisecond idleTimeout {30000};
+        // give up a connection that is not connected in time (retried by Connector until then), 0: never
+        Millisecond connectTimeout {3000};
+        // close the connection if its oldest request is not answered in time
+        // and fail the queued requests, 0: never
+        Millisecond requestTimeout {0};
+        Millisecond healthCheckInterval {1000};
+    };
+
+    struct Response {
+        // false: connection is closed or timed out
+        bool ok {false};
+        std::string data;
+    };
+
+    struct Stats {
+        size_t connections;
+        // included in connections
+        size_t connecting;
+        size_t outstanding;
+        // no connection is available
+        size_t waiting;
+        // total
+        size_t requests;
+        size_t connects;
+        // connects given up by connectTimeout
+        size_t connectFailures;
+        size_t evictions;
+    };
+
+    // return: length of the first complete response in [data, data + length), 0 if incomplete
+    using Framer = std::function<size_t(const char *data, size_t length)>;
+
+public:
+    // future: in pool looper
+    // C++20: auto response = co_await pool.request(address, payload);
+    Future<Response> request(const InetAddress &address, std::string payload);
+
+    // connect minConnections in advance
+    void prepare(const InetAddress &address) { backendOf(address); }
+
+    void run() { _client.run(); }
+    void batch() { _client.batch(); }
+    void batch(Millisecond timeout) { _client.batch(timeout); }
+    void stop() { _client.stop(); }
+
+    Looper* looper() { return _client.looper(); }
+    Client* client() { return &_client; }
+    Stats stats() const;
+
+    explicit ClientPool(Framer framer);
+    ClientPool(Framer framer, Options options);
+    ~ClientPool() { looper()->cancel(_healthCheck); }
+    ClientPool(const ClientPool&) = delete;
+    ClientPool(ClientPool&&) = delete;
+    ClientPool& operator=(const ClientPool&) = delete;
+    ClientPool& operator=(ClientPool&&) = delete;
+
+private:
+    struct Backend;
+
+    struct Pending {
+        Promise<Response> promise;
+        TimerPoint since;
+    };
+
+    struct Waiting {
+        std::string payload;
+        Promise<Response> promise;
+        TimerPoint since;
+    };
+
+    struct Connection {
+        Backend *backend;
+        // nullptr: connecting
+        Context *context {nullptr};
+        // requests in order
+        std::deque<Pending> pending;
+        TimerPoint lastUsed {};
+        // evicted, no more requests
+        bool draining {false};
+    };
+
+    struct Backend {
+        InetAddress address;
+        std::vector<std::unique_ptr<Connection>> connections;
+        size_t connecting {0};
+        std::deque<Waiting> waiting;
+    };
+
+    static uint64_t keyOf(const InetAddress &address) {
+        return (uint64_t(address.rawIp()) << 16) | address.rawPort();
+    }
+    static bool available(const Connection *connection, size_t maxPipeline) {
+        return connection->context && !connection->draining && connection->pending.size() < maxPipeline;
+    }
+
+    Backend& backendOf(const InetAddress &address);
+    // return: nullptr if all connections are full
+    Connection* select(Backend &backend);
+    void dispatch(Connection *connection, std::string &&payload, Promise<Response> &&promise);
+    // dispatch waiting requests, connect more if required
+    void drain(Backend &backend);
+    void connect(Backend &backend);
+    // connection is given up by connectTimeout
+    void handleConnectFailure(Connection *connection);
+
+    void handleMessage(Context *context);
+    void handleClose(Context *context);
+    void healthCheck();
+
+private:
+    Client _client;
+    Framer _framer;
+    Options _options;
+    // node-based, address stable
+    std::unordered_map<uint64_t, Backend> _backends;
+    std::unordered_map<Context*, Connection*> _connections;
+    std::minstd_rand _random;
+    TimerId _healthCheck;
+    size_t _requests {0};
+    size_t _connects {0};
+    size_t _connectFailures {0};
+    size_t _evictions {0};
+};
+
+inline Future<ClientPool::Response> ClientPool::request(const InetAddress &address, std::string payload) {
+    Promise<Response> promise {looper()};
+    auto future = promise.get();
+    auto &backend = backendOf(address);
+    _requests++;
+    // keep the order of waiting requests
+    Connection *connection = backend.waiting.empty() ? select(backend) : nullptr;
+    if(connection) {
+        dispatch(connection, std::move(payload), std::move(promise));
+    } else {
+        backend.waiting.push_back({std::move(payload), std::move(promise), looper()->now()});
+        drain(backend);
+    }
+    return future;
+}
+
+inline ClientPool::Stats ClientPool::stats() const {
+    Stats stats {0, 0, 0, 0, _requests, _connects, _connectFailures, _evictions};
+    for(auto &[_, backend] : _backends) {
+        stats.connections += backend.connections.size();
+        stats.connecting += backend.connecting;
+        stats.waiting += backend.waiting.size();
+        for(auto &connection : backend.connections) {
+            stats.outstanding += connection->pending.size();
+        }
+    }
+    return stats;
+}
+
+inline ClientPool::ClientPool(Framer framer)
+    : ClientPool(std::move(framer), Options{}) {}
+
+inline ClientPool::ClientPool(Framer framer, Options options)
+    : _framer(std::move(framer)),
+      _options(options),
+      _random(std::random_device{}()) {
+    _options.maxConnections = std::max<size_t>(_options.maxConnections, 1);
+    _options.minConnections = std::min(_options.minConnections, _options.maxConnections);
+    _options.maxPipeline = std::max<size_t>(_options.maxPipeline, 1);
+    _client.onMessage([this](Context *context) { handleMessage(context); });
+    _client.onClose([this](Context *context) { handleClose(context); });
+    _healthCheck = looper()->runEvery(_options.healthCheckInterval, [this] { healthCheck(); });
+}
+
+inline ClientPool::Backend& ClientPool::backendOf(const InetAddress &address) {
+    auto [iter, inserted] = _backends.try_emplace(keyOf(address));
+    auto &backend = iter->second;
+    if(inserted) {
+        backend.address = address;
+        while(backend.connections.size() < _options.minConnections) {
+            connect(backend);
+        }
+    }
+    return backend;
+}
+
+inline ClientPool::Connection* ClientPool::select(Backend &backend) {
+    auto &connections = backend.connections;
+    size_t maxPipeline = _options.maxPipeline;
+    if(_options.selection == Selection::POWER_OF_TWO_CHOICES && connections.size() >= 2) {
+        size_t first = _random() % connections.size();
+        size_t second = (first + 1 + _random() % (connections.size() - 1)) % connections.size();
+        Connection *a = connections[first].get();
+        Connection *b = connections[second].get();
+        bool useA = available(a, maxPipeline);
+        bool useB = available(b, maxPipeline);
+        if(useA && useB) return a->pending.size() <= b->pending.size() ? a : b;
+        if(useA) return a;
+        if(useB) return b;
+        // both are full or connecting, fall back to the scan
+    }
+    Connection *best = nullptr;
+    for(auto &connection : connections) {
+        if(!available(connection.get(), maxPipeline)) continue;
+        if(!best || connection->pending.size() < best->pending.size()) {
+            best = connection.get();
+            if(best->pending.empty()) break;
+        }
+    }
+    return best;
+}
+
+inline void ClientPool::dispatch(Connection *connection, std::string &&payload, Promise<Response> &&promise) {
+    auto now = looper()->now();
+    connection->context->send(payload);
+    connection->pending.push_back({std::move(promise), now});
+    connection->lastUsed = now;
+}
+
+inline void ClientPool::drain(Backend &backend) {
+    while(!backend.waiting.empty()) {
+        Connection *connection = select(backend);
+        if(!connection) break;
+        auto &waiting = backend.waiting.front();
+        dispatch(connection, std::move(waiting.payload), std::move(waiting.promise));
+        backend.waiting.pop_front();
+    }
+    // expected capacity of the connecting ones
+    while(backend.waiting.size() > backend.connecting * _options.maxPipeline
+            && backend.connections.size() < _options.maxConnections) {
+        connect(backend);
+    }
+}
+
+inline void ClientPool::connect(Backend &backend) {
+    auto connection = backend.connections.emplace_back(std::make_unique<Connection>()).get();
+    connection->backend = &backend;
+    backend.connecting++;
+    _connects++;
+    // retried by connector until connected or timed out
+    _client.connect(backend.address, _options.connectTimeout).then([this, connection](Context *context) {
+        auto &backend = *connection->backend;
+        backend.connecting--;
+        if(!context) {
+            handleConnectFailure(connection);
+            return false;
+        }
+        connection->context = context;
+        connection->lastUsed = looper()->now();
+        _connections[context] = connection;
+        FLUENT_LOG_DEBUG(context->simpleInfo(), "pooled. [BACKEND]", backend.address.toString());
+        drain(backend);
+        return true;
+    });
+}
+
+inline void ClientPool::handleConnectFailure(Connection *connection) {
+    auto &backend = *connection->backend;
+    auto &connections = backend.connections;
+    _connectFailures++;
+    FLUENT_LOG_WARN("connect failed. [BACKEND]", backend.address.toString());
+    connections.erase(std::find_if(connections.begin(), connections.end(),
+        [connection](const std::unique_ptr<Connection> &that) { return that.get() == connection; }));
+    bool usable = backend.connecting > 0 || std::any_of(connections.begin(), connections.end(),
+        [](const std::unique_ptr<Connection> &that) { return that->context && !that->draining; });
+    if(!usable) {
+        // no connection can be made now, do not wait for requestTimeout
+        while(!backend.waiting.empty()) {
+            backend.waiting.front().promise.setValue(Response {});
+            backend.waiting.pop_front();
+        }
+    }
+    // minConnections is restored by healthCheck(), not in a tight loop
+}
+
+inline void ClientPool::handleMessage(Context *context) {
+    auto iter = _connections.find(context);
+    if(iter == _connections.end()) return;
+    Connection *connection = iter->second;
+    auto &input = context->input;
+    while(!connection->pending.empty()) {
+        size_t length = _framer(input.readBuffer(), input.unread());
+        if(length == 0) break;
+        auto promise = std::move(connection->pending.front().promise);
+        connection->pending.pop_front();
+        promise.setValue(Response {true, std::string(input.readBuffer(), length)});
+        input.hasRead(length);
+    }
+    connection->lastUsed = looper()->now();
+    drain(*connection->backend);
+}
+
+inline void ClientPool::handleClose(Context *context) {
+    auto iter = _connections.find(context);
+    if(iter == _connections.end()) return;
+    Connection *connection = iter->second;
+    _connections.erase(iter);
+    for(auto &pending : connection->pending) {
+        pending.promise.setValue(Response {});
+    }
+    auto &backend = *connection->backend;
+    auto &connections = backend.connections;
+    connections.erase(std::find_if(connections.begin(), connections.end(),
+        [connection](const std::unique_ptr<Connection> &that) { return that.get() == connection; }));
+    FLUENT_LOG_DEBUG(context->simpleInfo(), "unpooled. [BACKEND]", backend.address.toString());
+    while(connections.size() < _options.minConnections) {
+        connect(backend);
+    }
+    drain(backend);
+}
+
+inline void ClientPool::healthCheck() {
+    auto now = looper()->now();
+    auto requestTimeout = _options.requestTimeout;
+    auto idleTimeout = _options.idleTimeout;
+    for(auto &[_, backend] : _backends) {
+        if(requestTimeout.count() > 0) {
+            while(!backend.waiting.empty() && now - backend.waiting.front().since > requestTimeout) {
+                backend.waiting.front().promise.setValue(Response {});
+                backend.waiting.pop_front();
+            }
+        }
+        // given up by connectTimeout, or evicted
+        while(backend.connections.size() < _options.minConnections) {
+            connect(backend);
+        }
+        size_t alive = backend.connections.size();
+        for(auto &connection : backend.connections) {
+            if(!connection->context || connection->draining) continue;
+            bool stuck = requestTimeout.count() > 0 && !connection->pending.empty()
+                && now - connection->pending.front().since > requestTimeout;
+            bool idle = idleTimeout.count() > 0 && connection->pending.empty()
+                && now - connection->lastUsed > idleTimeout && alive > _options.minConnections;
+            if(!stuck && !idle) continue;
+            FLUENT_LOG_INFO(connection->context->simpleInfo(), stuck ? "evicted (stuck)" : "evicted (idle)");
+            connection->draining = true;
+            alive--;
+            _evictions++;
+            // pending requests are failed in handleClose()
+            stuck ? connection->context->forceClose() : connection->context->shutdown();
+        }
+    }
+}
+
+} // fluent
+#endif
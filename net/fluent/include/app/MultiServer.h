@@ -0,0 +1,252 @@
+#ifndef __FLUENT_APP_MULTI_SERVER_H__
+#define __FLUENT_APP_MULTI_SERVER_H__
+#include <pthread.h>
+#include <sched.h>
+#include <bits/stdc++.h>
+#include "../logger/Logger.h"
+#include "Server.h"
+namespace fluent {
+
+template <typename ConnectCallback,
+          typename MessageCallback,
+          typename CloseCallback,
+          typename Codec = RawCodec>
+class BaseMultiServer;
+
+using MultiServer = BaseMultiServer<std::function<void(Context*)>,
+                                    std::function<void(Context*)>,
+                                    std::function<void(Context*)>>;
+
+// message callback: void(Context*, Frame) per complete frame, see codec/Codec.h
+template <typename Codec>
+using FramedMultiServer = BaseMultiServer<std::function<void(Context*)>,
+                                          std::function<void(Context*, Frame)>,
+                                          std::function<void(Context*)>,
+                                          Codec>;
+
+// factory function
+// help template argument deduction
+template <typename ConnectCallbackForward,
+          typename MessageCallbackForward,
+          typename CloseCallbackForward,
+          /// return type
+          typename ConnectCallback = typename std::remove_reference<ConnectCallbackForward>::type,
+          typename MessageCallback = typename std::remove_reference<MessageCallbackForward>::type,
+          typename CloseCallbackd  = typename std::remove_reference<CloseCallbackForward>::type>
+inline BaseMultiServer<ConnectCallback, MessageCallback, CloseCallbackd>
+makeMultiServer(const InetAddress      &address,
+                size_t                 reactors,
+                ConnectCallbackForward &&connectCallback,
+                MessageCallbackForward &&messageCallback,
+                CloseCallbackForward   &&closeCallback) {
+    return BaseMultiServer<ConnectCallback, MessageCallback, CloseCallbackd>(
+            address,
+            reactors,
+            std::forward<ConnectCallbackForward>(connectCallback),
+            std::forward<MessageCallbackForward>(messageCallback),
+            std::forward<CloseCallbackForward>(closeCallback)
+        );
+}
+
+// multi-reactor server
+// each reactor owns its looper, epoll fd, listen socket (SO_REUSEPORT) and pool,
+// and runs in a dedicated thread (optionally pinned to a cpu, off by default)
+// the kernel shards the incoming connections among the listen sockets
+// reactors share nothing, so there is no lock on the hot path
+//
+// note: callbacks are copied to every reactor, and will be called in different threads
+template <typename ConnectCallback,
+          typename MessageCallback,
+          typename CloseCallback,
+          typename Codec>
+class BaseMultiServer {
+public:
+    using ConnectCallbackType = ConnectCallback;
+    using MessageCallbackType = MessageCallback;
+    using CloseCallbackType   = CloseCallback;
+    using CodecType           = Codec;
+    using ServerType = BaseServer<ConnectCallback, MessageCallback, CloseCallback, Codec>;
+
+public:
+    // reactor[0] runs in the current thread
+    // block until stop()
+    void run();
+
+    void ready() { for(auto &reactor : _reactors) reactor->ready(); }
+    // thread-safe
+    // reactors are woken up by their looper inboxes
+    void stop();
+
+    size_t size() const { return _reactors.size(); }
+    // ensure: index < size()
+    ServerType& reactor(size_t index) { return *_reactors[index]; }
+
+    // reactor[i] is pinned to the allowed cpu (firstCpu + i) % n, see sched_getaffinity()
+    // the mask of the current thread (reactor[0]) is restored when run() returns
+    void setCpuAffinity(bool on = true, size_t firstCpu = 0) { _affinity = on; _firstCpu = firstCpu; }
+
+    void onConnect(ConnectCallback callback);
+    void onMessage(MessageCallback callback);
+    void onClose(CloseCallback callback);
+    // copied to every reactor
+    void setCodec(const Codec &codec);
+
+    BaseMultiServer(InetAddress address, size_t reactors = defaultReactors());
+    BaseMultiServer(InetAddress address,
+                    size_t reactors,
+                    ConnectCallback connectCallback,
+                    MessageCallback messageCallback,
+                    CloseCallback   closeCallback);
+    ~BaseMultiServer() = default;
+    BaseMultiServer(const BaseMultiServer&) = delete;
+    BaseMultiServer(BaseMultiServer&&);
+    BaseMultiServer& operator=(const BaseMultiServer&) = delete;
+    BaseMultiServer& operator=(BaseMultiServer&&) = delete;
+
+private:
+    void runReactor(size_t index);
+
+    static size_t defaultReactors();
+    // cpus this process may run on (taskset, cgroup cpuset)
+    static std::vector<int> allowedCpus();
+    static void bindToCpu(int cpu);
+
+private:
+    // unique_ptr makes reactor address stable (looper pointer is held by contexts)
+    std::vector<std::unique_ptr<ServerType>> _reactors;
+    std::atomic<bool> _stop {false};
+    bool _affinity {false};
+    size_t _firstCpu {0};
+    // allowedCpus() of the caller, taken by run() before any reactor is pinned
+    std::vector<int> _cpus;
+};
+
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void BaseMultiServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::stop() {
+    _stop.store(true, std::memory_order_relaxed);
+    // an empty task breaks the blocking poll
+    for(auto &reactor : _reactors) reactor->looper()->postRemote([] {});
+}
+
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void BaseMultiServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::run() {
+    _stop.store(false, std::memory_order_relaxed);
+    if(_affinity) _cpus = allowedCpus();
+    std::vector<std::thread> threads;
+    threads.reserve(_reactors.size());
+    for(size_t index = 1; index < _reactors.size(); ++index) {
+        threads.emplace_back([this, index] { runReactor(index); });
+    }
+    runReactor(0);
+    for(auto &thread : threads) thread.join();
+}
+
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void BaseMultiServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::onConnect(ConnectCallback callback) {
+    for(auto &reactor : _reactors) reactor->onConnect(callback);
+}
+
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void BaseMultiServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::onMessage(MessageCallback callback) {
+    for(auto &reactor : _reactors) reactor->onMessage(callback);
+}
+
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void BaseMultiServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::onClose(CloseCallback callback) {
+    for(auto &reactor : _reactors) reactor->onClose(callback);
+}
+
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void BaseMultiServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::setCodec(const Codec &codec) {
+    for(auto &reactor : _reactors) reactor->setCodec(codec);
+}
+
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline BaseMultiServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::
+BaseMultiServer(InetAddress address, size_t reactors) {
+    _reactors.reserve(reactors);
+    while(reactors--) {
+        _reactors.emplace_back(std::make_unique<ServerType>(address));
+    }
+}
+
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline BaseMultiServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::
+BaseMultiServer(InetAddress address,
+                size_t reactors,
+                ConnectCallback connectCallback,
+                MessageCallback messageCallback,
+                CloseCallback   closeCallback) {
+    _reactors.reserve(reactors);
+    while(reactors--) {
+        _reactors.emplace_back(std::make_unique<ServerType>(address,
+            connectCallback, messageCallback, closeCallback));
+    }
+}
+
+// only for factory function
+// ensure: not running
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline BaseMultiServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::
+BaseMultiServer(BaseMultiServer &&rhs)
+    : _reactors(std::move(rhs._reactors)),
+      _stop(rhs._stop.load(std::memory_order_relaxed)),
+      _affinity(rhs._affinity),
+      _firstCpu(rhs._firstCpu),
+      _cpus(std::move(rhs._cpus)) {}
+
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void BaseMultiServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::runReactor(size_t index) {
+    // reactor[0] borrows the caller's thread, give its mask back
+    cpu_set_t saved;
+    bool pinned = _affinity && !_cpus.empty()
+        && !::pthread_getaffinity_np(::pthread_self(), sizeof(saved), &saved);
+    if(pinned) {
+        bindToCpu(_cpus[(_firstCpu + index) % _cpus.size()]);
+    }
+    auto &reactor = *_reactors[index];
+    FLUENT_LOG_INFO("reactor", index, "running");
+    while(!_stop.load(std::memory_order_relaxed)) {
+        reactor.batch(reactor.looper()->nextTimeout(ServerType::POLL_TIMEOUT_LIMIT));
+    }
+    FLUENT_LOG_INFO("reactor", index, "stopped");
+    if(pinned) {
+        ::pthread_setaffinity_np(::pthread_self(), sizeof(saved), &saved);
+    }
+}
+
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline size_t BaseMultiServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::defaultReactors() {
+    return std::max<size_t>(allowedCpus().size(), 1);
+}
+
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline std::vector<int> BaseMultiServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::allowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(::sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if(CPU_ISSET(cpu, &set)) cpus.emplace_back(cpu);
+        }
+    } else {
+        for(unsigned cpu = 0; cpu < std::thread::hardware_concurrency(); ++cpu) {
+            cpus.emplace_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void BaseMultiServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::bindToCpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    // not fatal, just a hint
+    if(int err = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set)) {
+        FLUENT_LOG_WARN("cannot bind to cpu", cpu, ::strerror(err));
+    }
+}
+
+} // fluent
+#endif
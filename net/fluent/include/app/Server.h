@@ -2,6 +2,7 @@
 #define __FLUENT_APP_SERVER_H__
 #include <bits/stdc++.h>
 #include "../future/Futures.h"
+#include "../utils/Timestamp.h"
 #include "../network/Context.h"
 #include "../network/Acceptor.h"
 #include "../network/Multiplexer.h"
@@ -11,13 +12,21 @@ namespace fluent {
 
 template <typename ConnectCallback,
           typename MessageCallback,
-          typename CloseCallback>
+          typename CloseCallback,
+          typename Codec = RawCodec>
 class BaseServer;
 
 using Server = BaseServer<std::function<void(Context*)>,
                           std::function<void(Context*)>,
                           std::function<void(Context*)>>;
 
+// message callback: void(Context*, Frame) per complete frame, see codec/Codec.h
+template <typename Codec>
+using FramedServer = BaseServer<std::function<void(Context*)>,
+                                std::function<void(Context*, Frame)>,
+                                std::function<void(Context*)>,
+                                Codec>;
+
 // factory function
 // help template argument deduction
 template <typename ConnectCallbackForward,
@@ -42,27 +51,45 @@ makeServer(const InetAddress      &address,
 
 template <typename ConnectCallback,
           typename MessageCallback,
-          typename CloseCallback>
+          typename CloseCallback,
+          typename Codec>
 class BaseServer {
 public:
     using ConnectCallbackType = ConnectCallback;
     using MessageCallbackType = MessageCallback;
     using CloseCallbackType   = CloseCallback;
-    using HandlerType = Handler<ConnectCallback, MessageCallback, CloseCallback>;
+    using CodecType           = Codec;
+    using HandlerType = Handler<ConnectCallback, MessageCallback, CloseCallback, Codec>;
+
+    // upper bound of blocking poll
+    // stop() from other threads should be followed by looper()->postRemote() to wake it up
+    constexpr static Millisecond POLL_TIMEOUT_LIMIT {100};
 
 public:
-    void run() { for(_stop = false; !_stop; ) batch(); }
-    void batch();
+    // block in multiplexer until the nearest timer
+    void run() { for(_stop = false; !_stop; ) batch(_looper.nextTimeout(POLL_TIMEOUT_LIMIT)); }
+    // non-blocking
+    void batch() { batch(Millisecond::zero()); }
+    // timeout: multiplexer timeout, ignored if multiplexer is outer
+    void batch(Millisecond timeout);
 
     // TODO stop acceptor event
-    void ready() { _acceptor.start(); }
+    void ready();
     void stop() { _stop = true; }
 
     Looper* looper() { return &_looper; }
+    // accept batch and backpressure (max connections, fd reserve)
+    Acceptor* acceptor() { return &_acceptor; }
+    // connection slab: live/free/high-water
+    Pool::Stats connectionStats() const { return _connections.stats(); }
+    // accept rate and overflows
+    const Acceptor::Stats& acceptStats() const { return _acceptor.stats(); }
 
     void onConnect(ConnectCallback callback) { _handler.onConnect(std::move(callback)); }
     void onMessage(MessageCallback callback) { _handler.onMessage(std::move(callback)); }
     void onClose(CloseCallback callback) { _handler.onClose(std::move(callback)); }
+    // framing codec options, e.g. max frame
+    void setCodec(Codec codec) { _handler.setCodec(std::move(codec)); }
 
     BaseServer(InetAddress address);
     BaseServer(InetAddress address,
@@ -99,49 +126,64 @@ private:
     bool _stop {false};
 };
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline void BaseServer<ConnectCallback, MessageCallback, CloseCallback>::batch() {
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void BaseServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::batch(Millisecond timeout) {
+    auto begin = TimerClock::now();
     if(!_isOuterMultiplexer) {
-        _multiplexer->poll(std::chrono::milliseconds::zero());
+        _multiplexer->poll(timeout);
     }
+    auto ready = TimerClock::now();
     accept();
     _handler.handleEvents(_token);
+    _connections.retire(_handler.closed());
     _looper.loop();
+    _looper.metrics().recordTurn(begin, ready, TimerClock::now());
+}
+
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void BaseServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::ready() {
+    _acceptor.start(_multiplexer.get(), _token);
 }
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline BaseServer<ConnectCallback, MessageCallback, CloseCallback>::
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline BaseServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::
 BaseServer(InetAddress address)
-    : _multiplexer(std::make_shared<Multiplexer>()),
+    : _multiplexer(std::make_shared<Multiplexer>(Exclusive{})),
       _isOuterMultiplexer(false),
       _token(_multiplexer->token()),
       _acceptor(&_looper, address),
-      _handler(_multiplexer.get()) {}
+      _handler(_multiplexer.get()) {
+    _multiplexer->watch(_looper.wakeupFd());
+}
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline BaseServer<ConnectCallback, MessageCallback, CloseCallback>::
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline BaseServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::
 BaseServer(InetAddress address,
            std::shared_ptr<Multiplexer> multiplexer)
     : _multiplexer(std::move(multiplexer)),
       _isOuterMultiplexer(true),
       _token(_multiplexer->token()),
       _acceptor(&_looper, address),
-      _handler(_multiplexer.get()) {}
+      _handler(_multiplexer.get()) {
+    _multiplexer->watch(_looper.wakeupFd());
+}
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline BaseServer<ConnectCallback, MessageCallback, CloseCallback>::
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline BaseServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::
 BaseServer(InetAddress address,
            ConnectCallback connectCallback,
            MessageCallback messageCallback,
            CloseCallback   closeCallback)
-    : _multiplexer(std::make_shared<Multiplexer>()),
+    : _multiplexer(std::make_shared<Multiplexer>(Exclusive{})),
       _isOuterMultiplexer(false),
       _token(_multiplexer->token()),
       _acceptor(&_looper, address),
-      _handler(_multiplexer.get(), std::move(connectCallback), std::move(messageCallback), std::move(closeCallback)) {}
+      _handler(_multiplexer.get(), std::move(connectCallback), std::move(messageCallback), std::move(closeCallback)) {
+    _multiplexer->watch(_looper.wakeupFd());
+}
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline BaseServer<ConnectCallback, MessageCallback, CloseCallback>::
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline BaseServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::
 BaseServer(InetAddress address,
           std::shared_ptr<Multiplexer> multiplexer,
           ConnectCallback connectCallback,
@@ -151,15 +193,20 @@ BaseServer(InetAddress address,
       _isOuterMultiplexer(true),
       _token(_multiplexer->token()),
       _acceptor(&_looper, address),
-      _handler(_multiplexer.get(), std::move(connectCallback), std::move(messageCallback), std::move(closeCallback)) {}
+      _handler(_multiplexer.get(), std::move(connectCallback), std::move(messageCallback), std::move(closeCallback)) {
+    _multiplexer->watch(_looper.wakeupFd());
+}
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline void BaseServer<ConnectCallback, MessageCallback, CloseCallback>::accept() {
-    if(_acceptor.accept()) {
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void BaseServer<ConnectCallback, MessageCallback, CloseCallback, Codec>::accept() {
+    // bounded batch: drains a storm quickly but still leaves the turn to established connections
+    auto stats = _connections.stats();
+    for(size_t budget = _acceptor.budget(stats.live - stats.retired); budget && _acceptor.accept(); --budget) {
         std::pair<InetAddress, Socket> contextArguments = _acceptor.aceeptResult();
         auto &address = contextArguments.first;
         auto &socket = contextArguments.second;
         Multiplexer::Bundle bundle = _connections.emplace(_token, &_looper, address, std::move(socket));
+        _looper.metrics().add(Metrics::ACCEPTS);
         _handler.handleNewContext(bundle);
     }
 }
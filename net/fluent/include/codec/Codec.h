@@ -0,0 +1,30 @@
+#ifndef __FLUENT_CODEC_CODEC_H__
+#define __FLUENT_CODEC_CODEC_H__
+#include <bits/stdc++.h>
+namespace fluent {
+
+// payload of a complete frame, a view into Context::input
+// valid until the message callback returns, do not consume input in the callback
+// (input is contiguous, so every frame is delivered without copy)
+using Frame = std::string_view;
+
+// framing codec, a template policy of Handler (see Handler<..., Codec>)
+// resolved at compile time, one instance per handler (stateless for connections)
+//
+// required:
+//   // return: bytes of the first frame in [data, data + length) including header / delimiter,
+//   //         0 if incomplete, -1 if malformed or larger than the max frame
+//   // scanned: leading bytes already known to contain no frame end (a hint for searching)
+//   ssize_t decode(const char *data, size_t length, size_t scanned, Frame &frame) const;
+//
+// message callback: void(Context*, Frame), called once per frame
+// a malformed frame closes the connection (forceClose)
+
+// no framing, message callback: void(Context*) with the whole input
+struct RawCodec {};
+
+// 64 MiB
+constexpr size_t DEFAULT_MAX_FRAME = size_t(64) << 20;
+
+} // fluent
+#endif
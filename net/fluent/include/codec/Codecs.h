@@ -0,0 +1,7 @@
+#ifndef __FLUENT_CODEC_CODECS_H__
+#define __FLUENT_CODEC_CODECS_H__
+#include "Codec.h"
+#include "LengthPrefixCodec.h"
+#include "VarintCodec.h"
+#include "DelimiterCodec.h"
+#endif
@@ -0,0 +1,65 @@
+#ifndef __FLUENT_CODEC_DELIMITER_CODEC_H__
+#define __FLUENT_CODEC_DELIMITER_CODEC_H__
+#include <bits/stdc++.h>
+#include "../network/Context.h"
+#include "../utils/FindCharset.h"
+#include "Codec.h"
+namespace fluent {
+
+// payload + delimiter (e.g. "\r\n"), the frame excludes the delimiter
+// the first delimiter byte is searched by findCharset() (AVX2)
+// bytes scanned by the previous read are skipped
+class DelimiterCodec {
+public:
+    ssize_t decode(const char *data, size_t length, size_t scanned, Frame &frame) const;
+
+    // payload and delimiter are appended to output and sent by one write
+    Context::Completion encode(Context *context, Frame payload) const;
+
+    size_t maxFrame() const { return _maxFrame; }
+    const std::string& delimiter() const { return _delimiter; }
+
+    // ensure: delimiter is not empty
+    explicit DelimiterCodec(std::string delimiter = "\r\n", size_t maxFrame = DEFAULT_MAX_FRAME);
+
+private:
+    std::string _delimiter;
+    // the first byte of delimiter
+    Charset _first;
+    size_t _maxFrame;
+};
+
+inline ssize_t DelimiterCodec::decode(const char *data, size_t length, size_t scanned, Frame &frame) const {
+    size_t size = _delimiter.size();
+    // a delimiter may be split by the last read
+    size_t from = scanned >= size ? scanned - size + 1 : 0;
+    // the delimiter starts at most at maxFrame
+    size_t limit = std::min(length, _maxFrame + size);
+    while(from + size <= limit) {
+        ssize_t index = findCharset(data + from, limit - from - size + 1, _first);
+        if(index < 0) break;
+        size_t at = from + index;
+        if(::memcmp(data + at, _delimiter.data(), size) == 0) {
+            frame = Frame {data, at};
+            return at + size;
+        }
+        from = at + 1;
+    }
+    return length >= _maxFrame + size ? -1 : 0;
+}
+
+inline Context::Completion DelimiterCodec::encode(Context *context, Frame payload) const {
+    context->output.append(payload.data(), payload.size());
+    context->output.append(_delimiter.data(), _delimiter.size());
+    return context->sendAppended(payload.size() + _delimiter.size());
+}
+
+inline DelimiterCodec::DelimiterCodec(std::string delimiter, size_t maxFrame)
+    : _delimiter(std::move(delimiter)),
+      _maxFrame(maxFrame) {
+    if(_delimiter.empty()) _delimiter = "\r\n";
+    _first.add(_delimiter[0]);
+}
+
+} // fluent
+#endif
@@ -0,0 +1,65 @@
+#ifndef __FLUENT_CODEC_LENGTH_PREFIX_CODEC_H__
+#define __FLUENT_CODEC_LENGTH_PREFIX_CODEC_H__
+#include <bits/stdc++.h>
+#include "../network/Context.h"
+#include "Codec.h"
+namespace fluent {
+
+// fixed-size length header + payload
+// LengthType: uint8_t / uint16_t / uint32_t / uint64_t, the length excludes the header
+// NETWORK_ORDER: big-endian header, false: host byte order
+template <typename LengthType = uint32_t, bool NETWORK_ORDER = true>
+class LengthPrefixCodec {
+    static_assert(std::is_unsigned<LengthType>::value, "length must be unsigned");
+
+public:
+    constexpr static size_t HEADER_SIZE = sizeof(LengthType);
+
+    ssize_t decode(const char *data, size_t length, size_t scanned, Frame &frame) const;
+
+    // header and payload are appended to output and sent by one write
+    Context::Completion encode(Context *context, Frame payload) const;
+
+    size_t maxFrame() const { return _maxFrame; }
+
+    explicit LengthPrefixCodec(size_t maxFrame = DEFAULT_MAX_FRAME)
+        : _maxFrame(std::min<uint64_t>(maxFrame, std::numeric_limits<LengthType>::max())) {}
+
+private:
+    static LengthType swap(LengthType value);
+
+private:
+    size_t _maxFrame;
+};
+
+template <typename LengthType, bool NETWORK_ORDER>
+inline ssize_t LengthPrefixCodec<LengthType, NETWORK_ORDER>::decode(const char *data, size_t length, size_t, Frame &frame) const {
+    if(length < HEADER_SIZE) return 0;
+    LengthType header;
+    ::memcpy(&header, data, HEADER_SIZE);
+    uint64_t payload = swap(header);
+    if(payload > _maxFrame) return -1;
+    if(length - HEADER_SIZE < payload) return 0;
+    frame = Frame {data + HEADER_SIZE, size_t(payload)};
+    return HEADER_SIZE + payload;
+}
+
+template <typename LengthType, bool NETWORK_ORDER>
+inline Context::Completion LengthPrefixCodec<LengthType, NETWORK_ORDER>::encode(Context *context, Frame payload) const {
+    LengthType header = swap(LengthType(payload.size()));
+    context->output.append(header);
+    context->output.append(payload.data(), payload.size());
+    return context->sendAppended(HEADER_SIZE + payload.size());
+}
+
+template <typename LengthType, bool NETWORK_ORDER>
+inline LengthType LengthPrefixCodec<LengthType, NETWORK_ORDER>::swap(LengthType value) {
+    constexpr bool swapped = NETWORK_ORDER == (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__);
+    if constexpr (!swapped || HEADER_SIZE == 1) return value;
+    else if constexpr (HEADER_SIZE == 2) return __builtin_bswap16(value);
+    else if constexpr (HEADER_SIZE == 4) return __builtin_bswap32(value);
+    else return __builtin_bswap64(value);
+}
+
+} // fluent
+#endif
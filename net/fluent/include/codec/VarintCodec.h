@@ -0,0 +1,61 @@
+#ifndef __FLUENT_CODEC_VARINT_CODEC_H__
+#define __FLUENT_CODEC_VARINT_CODEC_H__
+#include <bits/stdc++.h>
+#include "../network/Context.h"
+#include "Codec.h"
+namespace fluent {
+
+// base-128 varint length (protobuf style, little-endian groups) + payload
+class VarintCodec {
+public:
+    // uint64_t
+    constexpr static size_t MAX_HEADER_SIZE = 10;
+
+    ssize_t decode(const char *data, size_t length, size_t scanned, Frame &frame) const;
+
+    // header and payload are appended to output and sent by one write
+    Context::Completion encode(Context *context, Frame payload) const;
+
+    size_t maxFrame() const { return _maxFrame; }
+
+    explicit VarintCodec(size_t maxFrame = DEFAULT_MAX_FRAME): _maxFrame(maxFrame) {}
+
+private:
+    size_t _maxFrame;
+};
+
+inline ssize_t VarintCodec::decode(const char *data, size_t length, size_t, Frame &frame) const {
+    uint64_t payload = 0;
+    size_t header = 0;
+    for(;;) {
+        if(header == length) return 0;
+        if(header == MAX_HEADER_SIZE) return -1;
+        auto byte = static_cast<uint8_t>(data[header]);
+        payload |= uint64_t(byte & 0x7f) << (7 * header);
+        ++header;
+        if(!(byte & 0x80)) break;
+        // no need to wait for the rest
+        if(payload > _maxFrame) return -1;
+    }
+    if(payload > _maxFrame) return -1;
+    if(length - header < payload) return 0;
+    frame = Frame {data + header, size_t(payload)};
+    return header + payload;
+}
+
+inline Context::Completion VarintCodec::encode(Context *context, Frame payload) const {
+    uint8_t header[MAX_HEADER_SIZE];
+    size_t size = 0;
+    uint64_t value = payload.size();
+    do {
+        header[size] = (value & 0x7f) | (value > 0x7f ? 0x80 : 0);
+        value >>= 7;
+        ++size;
+    } while(value);
+    context->output.append(reinterpret_cast<const char*>(header), size);
+    context->output.append(payload.data(), payload.size());
+    return context->sendAppended(size + payload.size());
+}
+
+} // fluent
+#endif
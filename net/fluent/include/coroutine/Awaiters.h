@@ -0,0 +1,134 @@
+#ifndef __FLUENT_COROUTINE_AWAITERS_H__
+#define __FLUENT_COROUTINE_AWAITERS_H__
+#include <coroutine>
+#include <bits/stdc++.h>
+#include "../future/Future.h"
+#include "../network/Context.h"
+#include "Coroutine.h"
+namespace fluent {
+
+// co_await context->read(n)
+// resumed by handler when input has n bytes at least, or the connection is closed
+class ReadAwaiter {
+public:
+    bool await_ready() const noexcept {
+        return size_t(_context->input.unread()) >= _want || _context->isDisConnected();
+    }
+    void await_suspend(std::coroutine_handle<> handle) noexcept;
+    // readable bytes
+    size_t await_resume() const noexcept { return _context->input.unread(); }
+
+    ReadAwaiter(Context *context, size_t want): _context(context), _want(want) {}
+
+private:
+    static void resume(void *arg, bool) { static_cast<ReadAwaiter*>(arg)->_handle.resume(); }
+
+private:
+    Context *_context;
+    size_t _want;
+    std::coroutine_handle<> _handle;
+};
+
+// co_await context->write(...)
+// resumed in looper when the bytes are released (true), or the connection is closed (false)
+class WriteAwaiter {
+public:
+    bool await_ready() noexcept { return _flushed = _completion.poll(); }
+    bool await_suspend(std::coroutine_handle<> handle) noexcept;
+    bool await_resume() const noexcept { return _flushed; }
+
+    WriteAwaiter(Context::Completion completion): _completion(completion) {}
+
+private:
+    static void resume(void *arg, bool flushed);
+
+private:
+    Context::Completion _completion;
+    bool _flushed {false};
+    std::coroutine_handle<> _handle;
+    // linked by the completion ring while suspended
+    Context::Waiter _waiter;
+};
+
+// co_await sleep(delay)
+// resumed by the timer wheel of the awaiting coroutine's looper
+class SleepAwaiter {
+public:
+    bool await_ready() const noexcept { return _delay.count() <= 0; }
+    template <typename Promise>
+    void await_suspend(std::coroutine_handle<Promise> handle);
+    void await_resume() const noexcept {}
+
+    explicit SleepAwaiter(std::chrono::nanoseconds delay): _delay(delay) {}
+
+private:
+    std::chrono::nanoseconds _delay;
+};
+
+// co_await future
+// the continuation is attached to the shared state, resumed in looper as then()
+// note: a cancelled future never resumes
+template <typename T>
+class FutureAwaiter {
+public:
+    bool await_ready() const noexcept { return _shared->_state == State::READY; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        _shared->_then = [handle](T&&) { handle.resume(); };
+    }
+    T await_resume() {
+        _shared->_state = State::DEAD;
+        return std::move(_shared->_value);
+    }
+
+    explicit FutureAwaiter(Future<T> &&future): _shared(future.getControlBlock()) {}
+
+private:
+    SharedPtr<ControlBlock<T>> _shared;
+};
+
+inline SleepAwaiter sleep(std::chrono::nanoseconds delay) { return SleepAwaiter{delay}; }
+
+template <typename T>
+inline FutureAwaiter<T> operator co_await(Future<T> &&future) { return FutureAwaiter<T>{std::move(future)}; }
+
+inline void ReadAwaiter::await_suspend(std::coroutine_handle<> handle) noexcept {
+    _handle = handle;
+    _context->_reader = Resumer {&ReadAwaiter::resume, this};
+    _context->_readWant = _want;
+}
+
+inline bool WriteAwaiter::await_suspend(std::coroutine_handle<> handle) noexcept {
+    _handle = handle;
+    _waiter.resumer = Resumer {&WriteAwaiter::resume, this};
+    if(_completion.await(_waiter)) {
+        return true;
+    }
+    // resolved in the meantime
+    _flushed = _completion.poll();
+    return false;
+}
+
+inline void WriteAwaiter::resume(void *arg, bool flushed) {
+    auto awaiter = static_cast<WriteAwaiter*>(arg);
+    awaiter->_flushed = flushed;
+    awaiter->_handle.resume();
+}
+
+template <typename Promise>
+inline void SleepAwaiter::await_suspend(std::coroutine_handle<Promise> handle) {
+    static_assert(std::is_base_of_v<CoroutinePromiseBase, Promise>, "sleep() requires fluent::Coroutine");
+    // a bare handle is stored inline by std::function, no allocation
+    handle.promise().looper->runAfter(_delay, [handle] { handle.resume(); });
+}
+
+inline ReadAwaiter Context::read(size_t n) {
+    return ReadAwaiter{this, n};
+}
+
+template <typename ...Args>
+inline WriteAwaiter Context::write(Args &&...args) {
+    return WriteAwaiter{send(std::forward<Args>(args)...)};
+}
+
+} // fluent
+#endif
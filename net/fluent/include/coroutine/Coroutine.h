@@ -0,0 +1,179 @@
+#ifndef __FLUENT_COROUTINE_COROUTINE_H__
+#define __FLUENT_COROUTINE_COROUTINE_H__
+#include <coroutine>
+#include <bits/stdc++.h>
+#include "../future/Looper.h"
+#include "../logger/Logger.h"
+#include "FramePool.h"
+namespace fluent {
+
+// C++20 coroutine front-end
+//
+// Coroutine<T> is lazy, it starts when it is awaited or spawned
+// - co_await coroutine: run in place, return T (or rethrow)
+// - spawn(looper, coroutine): detached, the frame is destroyed when it returns
+//
+// awaiters are resumed in looper thread (see coroutine/Awaiters.h)
+// a coroutine inherits the looper from its awaiter
+// frames come from the frame pool of the loop thread
+//
+// Coroutine<void> session(Context *context) {
+//     while(co_await context->read()) {
+//         std::string echo {context->input.readBuffer(), size_t(context->input.unread())};
+//         context->input.clear();
+//         if(!co_await context->write(echo)) break;
+//     }
+// }
+// server.onConnect([](Context *context) { spawn(context->looper, session(context)); });
+template <typename T = void>
+class Coroutine;
+
+class CoroutinePromiseBase {
+public:
+    // resumed by awaiters in this looper
+    Looper *looper {nullptr};
+
+public:
+    static void* operator new(size_t size) { return FramePool::local().allocate(size); }
+    static void operator delete(void *frame, size_t size) { FramePool::local().deallocate(frame, size); }
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    auto final_suspend() const noexcept { return FinalAwaiter{}; }
+    void unhandled_exception() { _exception = std::current_exception(); }
+
+protected:
+    template <typename> friend class Coroutine;
+    friend void spawn(Looper*, Coroutine<void>&&);
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) const noexcept;
+        void await_resume() const noexcept {}
+    };
+
+    // awaiting one, or noop if spawned
+    std::coroutine_handle<> _continuation {std::noop_coroutine()};
+    std::exception_ptr _exception;
+    bool _detached {false};
+};
+
+template <typename T>
+class CoroutinePromise: public CoroutinePromiseBase {
+public:
+    Coroutine<T> get_return_object() noexcept;
+
+    template <typename U>
+    void return_value(U &&value) { _value.emplace(std::forward<U>(value)); }
+
+    T result() {
+        if(_exception) std::rethrow_exception(_exception);
+        return std::move(*_value);
+    }
+
+private:
+    std::optional<T> _value;
+};
+
+template <>
+class CoroutinePromise<void>: public CoroutinePromiseBase {
+public:
+    Coroutine<void> get_return_object() noexcept;
+
+    void return_void() const noexcept {}
+
+    void result() {
+        if(_exception) std::rethrow_exception(_exception);
+    }
+};
+
+template <typename T>
+class Coroutine {
+public:
+    using promise_type = CoroutinePromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    struct Awaiter {
+        Handle handle;
+
+        // ensure: not released (e.g. moved or spawned)
+        bool await_ready() const noexcept { assert(handle); return false; }
+        template <typename Promise>
+        Handle await_suspend(std::coroutine_handle<Promise> awaiting) noexcept;
+        T await_resume() { return handle.promise().result(); }
+    };
+
+public:
+    // run in place, the frame is destroyed with this object
+    Awaiter operator co_await() && noexcept { return Awaiter{_handle}; }
+
+    // give up the frame, e.g. spawn()
+    Handle release() noexcept { return std::exchange(_handle, {}); }
+
+    explicit Coroutine(Handle handle) noexcept: _handle(handle) {}
+    ~Coroutine() { if(_handle) _handle.destroy(); }
+    Coroutine(const Coroutine&) = delete;
+    Coroutine(Coroutine &&rhs) noexcept: _handle(rhs.release()) {}
+    Coroutine& operator=(const Coroutine&) = delete;
+    Coroutine& operator=(Coroutine &&rhs) noexcept { Coroutine(std::move(rhs)).swap(*this); return *this; }
+    void swap(Coroutine &that) noexcept { std::swap(_handle, that._handle); }
+
+private:
+    Handle _handle;
+};
+
+// start a detached coroutine in place
+// ensure: called in looper thread
+void spawn(Looper *looper, Coroutine<void> &&coroutine);
+
+template <typename Promise>
+inline std::coroutine_handle<> CoroutinePromiseBase::FinalAwaiter::await_suspend(std::coroutine_handle<Promise> handle) const noexcept {
+    auto &promise = handle.promise();
+    if(!promise._detached) {
+        // symmetric transfer, the result is taken by the awaiter
+        return promise._continuation;
+    }
+    if(promise._exception) {
+        try {
+            std::rethrow_exception(promise._exception);
+        } catch(const std::exception &e) {
+            FLUENT_LOG_WARN("spawned coroutine catches an exception:", e.what());
+        } catch(...) {
+            FLUENT_LOG_WARN("spawned coroutine catches an unknown exception");
+        }
+    }
+    handle.destroy();
+    return std::noop_coroutine();
+}
+
+template <typename T>
+inline Coroutine<T> CoroutinePromise<T>::get_return_object() noexcept {
+    return Coroutine<T>{std::coroutine_handle<CoroutinePromise<T>>::from_promise(*this)};
+}
+
+inline Coroutine<void> CoroutinePromise<void>::get_return_object() noexcept {
+    return Coroutine<void>{std::coroutine_handle<CoroutinePromise<void>>::from_promise(*this)};
+}
+
+template <typename T>
+template <typename Promise>
+inline auto Coroutine<T>::Awaiter::await_suspend(std::coroutine_handle<Promise> awaiting) noexcept -> Handle {
+    auto &promise = handle.promise();
+    promise._continuation = awaiting;
+    if constexpr (std::is_base_of_v<CoroutinePromiseBase, Promise>) {
+        promise.looper = awaiting.promise().looper;
+    }
+    return handle;
+}
+
+inline void spawn(Looper *looper, Coroutine<void> &&coroutine) {
+    auto handle = coroutine.release();
+    if(!handle) return;
+    auto &promise = handle.promise();
+    promise.looper = looper;
+    promise._detached = true;
+    handle.resume();
+}
+
+} // fluent
+#endif
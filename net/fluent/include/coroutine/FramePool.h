@@ -0,0 +1,97 @@
+#ifndef __FLUENT_COROUTINE_FRAME_POOL_H__
+#define __FLUENT_COROUTINE_FRAME_POOL_H__
+#include <bits/stdc++.h>
+namespace fluent {
+
+// coroutine frames of a loop thread
+// size classes of 32 bytes up to MAX_SIZE, larger frames fall back to the global allocator
+// freed blocks are reused in O(1), chunks are never freed until the thread exits
+// note: a frame must be freed in the thread it is allocated (looper resumes its coroutines in its own thread)
+class FramePool {
+public:
+    constexpr static size_t GRANULARITY = 32;
+    constexpr static size_t MAX_SIZE = 2048;
+    // blocks per refill
+    constexpr static size_t CHUNK_BLOCKS = 32;
+
+    struct Stats {
+        // allocated from free lists
+        size_t hits;
+        // refills and large frames
+        size_t misses;
+        size_t bytes;
+    };
+
+public:
+    void* allocate(size_t size);
+    void deallocate(void *frame, size_t size);
+
+    const Stats& stats() const { return _stats; }
+
+    // the pool of the current (loop) thread
+    static FramePool& local() { thread_local FramePool pool; return pool; }
+
+    FramePool() = default;
+    ~FramePool() = default;
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+private:
+    struct Block {
+        Block *next;
+    };
+
+    constexpr static size_t CLASSES = MAX_SIZE / GRANULARITY;
+
+    static size_t classOf(size_t size) { return (size + GRANULARITY - 1) / GRANULARITY - 1; }
+    void refill(size_t index);
+
+private:
+    std::array<Block*, CLASSES> _free {};
+    std::vector<std::unique_ptr<char[]>> _chunks;
+    Stats _stats {};
+};
+
+inline void* FramePool::allocate(size_t size) {
+    if(size > MAX_SIZE) {
+        _stats.misses++;
+        return ::operator new(size);
+    }
+    size_t index = classOf(size);
+    if(!_free[index]) {
+        _stats.misses++;
+        refill(index);
+    } else {
+        _stats.hits++;
+    }
+    Block *block = _free[index];
+    _free[index] = block->next;
+    return block;
+}
+
+inline void FramePool::deallocate(void *frame, size_t size) {
+    if(size > MAX_SIZE) {
+        ::operator delete(frame);
+        return;
+    }
+    size_t index = classOf(size);
+    auto block = static_cast<Block*>(frame);
+    block->next = _free[index];
+    _free[index] = block;
+}
+
+inline void FramePool::refill(size_t index) {
+    size_t blockSize = (index + 1) * GRANULARITY;
+    // new char[] is aligned to __STDCPP_DEFAULT_NEW_ALIGNMENT__, so are the blocks
+    auto chunk = std::make_unique<char[]>(blockSize * CHUNK_BLOCKS);
+    for(size_t i = CHUNK_BLOCKS; i--;) {
+        auto block = reinterpret_cast<Block*>(&chunk[i * blockSize]);
+        block->next = _free[index];
+        _free[index] = block;
+    }
+    _stats.bytes += blockSize * CHUNK_BLOCKS;
+    _chunks.emplace_back(std::move(chunk));
+}
+
+} // fluent
+#endif
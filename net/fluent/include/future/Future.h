@@ -175,26 +175,33 @@ public:
               bool ShouldReturnVoid = std::is_same<typename FunctionTraits<Functor>::ReturnType, void>::value,
               typename WaitRequired = typename std::enable_if<AtLeastThenValid && WontAcceptRvalue && ShouldReturnVoid>::type>
     Future<T> wait(size_t count, std::chrono::milliseconds duration, Functor &&f) {
-        auto start = std::chrono::system_clock::time_point{};
-        return poll([f = std::forward<Functor>(f), start, duration, remain = count](T &self) mutable {
-            auto current = std::chrono::system_clock::now();
-            // call once
-            if(start == std::chrono::system_clock::time_point{}) {
+        Promise<T> promise(_looper);
+        auto future = promise.get();
+        State state = _shared->_state;
+        if(state == State::NEW || state == State::READY) {
+            // timer based, no busy polling in looper
+            setCallback([f = std::forward<Functor>(f), promise = std::move(promise), looper = _looper, count, duration](T &&value) mutable {
                 // unlikely
-                if(remain == 0) {
-                    return true;
+                if(count == 0) {
+                    promise.setValue(value);
+                    return;
                 }
-                start = current;
-            }
-            if(current - start >= duration) {
-                f(self);
-                if(--remain == 0) {
-                    return true;
-                }
-                start = /*current*/ std::chrono::system_clock::now();
+                auto id = std::make_shared<TimerId>();
+                *id = looper->runEvery(duration, [f = std::move(f), promise = std::move(promise), looper, id, value, remain = count]() mutable {
+                    f(value);
+                    if(--remain == 0) {
+                        looper->cancel(*id);
+                        promise.setValue(std::move(value));
+                    }
+                });
+            });
+            if(state == State::READY) {
+                postRequest();
             }
-            return false;
-        });
+        } else if(state == State::CANCEL) {
+            promise.cancel();
+        }
+        return future;
     }
 
     // receive: void(T) void(T&)
@@ -216,14 +223,24 @@ public:
               bool ShouldReturnVoid = std::is_same<typename FunctionTraits<Functor>::ReturnType, void>::value,
               typename WaitRequired = typename std::enable_if<AtLeastThenValid && WontAcceptRvalue && ShouldReturnVoid>::type>
     Future<T> wait(std::chrono::system_clock::time_point timePoint, Functor &&f) {
-        return poll([f = std::forward<Functor>(f), timePoint](T &self) mutable {
-            auto current = std::chrono::system_clock::now();
-            if(current >= timePoint) {
-                f(self);
-                return true;
+        Promise<T> promise(_looper);
+        auto future = promise.get();
+        State state = _shared->_state;
+        if(state == State::NEW || state == State::READY) {
+            setCallback([f = std::forward<Functor>(f), promise = std::move(promise), looper = _looper, timePoint](T &&value) mutable {
+                auto delay = timePoint - std::chrono::system_clock::now();
+                looper->runAfter(delay, [f = std::move(f), promise = std::move(promise), value]() mutable {
+                    f(value);
+                    promise.setValue(std::move(value));
+                });
+            });
+            if(state == State::READY) {
+                postRequest();
             }
-            return false;
-        });
+        } else if(state == State::CANCEL) {
+            promise.cancel();
+        }
+        return future;
     }
 
 private:
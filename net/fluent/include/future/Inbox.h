@@ -0,0 +1,137 @@
+#ifndef __FLUENT_FUTURE_INBOX_H__
+#define __FLUENT_FUTURE_INBOX_H__
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <bits/stdc++.h>
+#include "../throws/FluentException.h"
+#include "TaskQueue.h"
+namespace fluent {
+
+// lock-free MPSC task inbox of a looper, with an eventfd doorbell
+// producers: any thread, post()
+// consumer: the looper thread, drain()
+//
+// a burst of posts rings the doorbell once,
+// the consumer rearms it before draining
+//
+// the doorbell may stay readable with nothing posted (a ring() after drain()),
+// so it should be watched edge-triggered, see Multiplexer::watch()
+class Inbox {
+public:
+    // drain() stops at this count, the rest rings the doorbell again
+    constexpr static size_t DRAIN_LIMIT = 1024;
+
+    // thread-safe
+    template <typename F>
+    void post(F &&f);
+
+    // move the tasks to sink(Task&&)
+    // return: count of tasks
+    template <typename Sink>
+    size_t drain(Sink &&sink);
+
+    // readable when there are new tasks
+    int fd() const { return _eventFd; }
+
+    Inbox();
+    ~Inbox();
+    Inbox(const Inbox&) = delete;
+    Inbox& operator=(const Inbox&) = delete;
+
+private:
+    struct Node {
+        std::atomic<Node*> next {nullptr};
+        Task task;
+    };
+
+    void push(Node *node);
+    // return: nullptr if empty (or a producer is linking)
+    Node* pop();
+    void ring();
+
+private:
+    // consumer side, a dummy node whose next is the first task
+    alignas(64) Node *_head;
+    // producer side
+    alignas(64) std::atomic<Node*> _tail;
+    std::atomic<bool> _notified {false};
+    int _eventFd;
+};
+
+template <typename F>
+inline void Inbox::post(F &&f) {
+    auto node = new Node;
+    if constexpr (std::is_same<typename std::decay<F>::type, Task>::value) {
+        node->task = std::forward<F>(f);
+    } else {
+        // not the looper arena (not thread-safe)
+        node->task.emplace(std::forward<F>(f), nullptr);
+    }
+    push(node);
+    // coalesce: only the first post after drain() writes the eventfd
+    if(!_notified.exchange(true, std::memory_order_acq_rel)) {
+        ring();
+    }
+}
+
+template <typename Sink>
+inline size_t Inbox::drain(Sink &&sink) {
+    // fast path, nothing posted
+    if(!_notified.load(std::memory_order_acquire)) return 0;
+    // rearm before reading tasks, later posts will ring again
+    // acq_rel: see the nodes pushed before the last exchange(true)
+    _notified.exchange(false, std::memory_order_acq_rel);
+    uint64_t value;
+    while(::read(_eventFd, &value, sizeof value) < 0 && errno == EINTR);
+    size_t count = 0;
+    while(count < DRAIN_LIMIT) {
+        Node *node = pop();
+        if(!node) break;
+        sink(std::move(node->task));
+        delete node;
+        ++count;
+    }
+    if(count == DRAIN_LIMIT && !_notified.exchange(true, std::memory_order_acq_rel)) {
+        ring();
+    }
+    return count;
+}
+
+inline Inbox::Inbox()
+    : _head(new Node),
+      _tail(_head),
+      _eventFd(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    if(_eventFd < 0) {
+        throw FluentException("cannot create eventfd");
+    }
+}
+
+inline Inbox::~Inbox() {
+    while(Node *node = pop()) delete node;
+    delete _head;
+    ::close(_eventFd);
+}
+
+inline void Inbox::push(Node *node) {
+    Node *prev = _tail.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+}
+
+inline Inbox::Node* Inbox::pop() {
+    Node *head = _head;
+    Node *next = head->next.load(std::memory_order_acquire);
+    if(!next) return nullptr;
+    // next becomes the dummy, move its task to the old dummy and return it
+    _head = next;
+    head->task = std::move(next->task);
+    head->next.store(nullptr, std::memory_order_relaxed);
+    return head;
+}
+
+inline void Inbox::ring() {
+    uint64_t one = 1;
+    while(::write(_eventFd, &one, sizeof one) < 0 && errno == EINTR);
+}
+
+} // fluent
+#endif
@@ -1,89 +1,121 @@
 #ifndef __FLUENT_FUTURE_LOOPER_H__
 #define __FLUENT_FUTURE_LOOPER_H__
 
-#define SKYWIND3000_CPU_LOOP_UNROLL_4X(actionx1, actionx2, actionx4, width) do { \
-    unsigned long __width = (unsigned long)(width);    \
-    unsigned long __increment = __width >> 2; \
-    for (; __increment > 0; __increment--) { actionx4; }    \
-    if (__width & 2) { actionx2; } \
-    if (__width & 1) { actionx1; } \
-}   while (0)
-
-#define CATURRA_2X(action)  do { {action;} {action;} } while(0)
-#define CATURRA_4X(action)  do { CATURRA_2X(action); CATURRA_2X(action); } while(0)
-#define CATURRA_8X(action)  do { CATURRA_4X(action); CATURRA_4X(action); } while(0)
-#define CATURRA_16X(action) do { CATURRA_8X(action); CATURRA_8X(action); } while(0)
-
 #include <bits/stdc++.h>
+#include "Timer.h"
+#include "TaskQueue.h"
+#include "Inbox.h"
+#include "../metrics/Metrics.h"
+#include "../network/Slab.h"
 
 namespace fluent {
 
 class Looper {
 public:
+    using Stats = TaskQueue::Stats;
 
-    void loop() { unroll4x(); }
+    // batch drain, tasks posted in this turn run in the next loop()
+    void loop() { expire(); receive(); _tasks.drain(_tasks.size()); }
 
     void stop() {}
 
-    void unroll4x() {
-        size_t n = _mq.size();
-        SKYWIND3000_CPU_LOOP_UNROLL_4X(
-            {
-                loopOnceUnchecked();
-            },
-            {
-                CATURRA_2X(loopOnceUnchecked());
-            },
-            {
-                CATURRA_4X(loopOnceUnchecked());
-            },
-            n
-        );
-
-    }
-
-    // unsafe
-    void loopOnceUnchecked() {
-        // debug();
-        _lastEvent = std::move(_mq.front());
-        _mq.pop();
-        _lastEvent();
-    }
-
-    void loopOnce() { if(!_mq.empty()) loopOnceUnchecked(); }
+    void loopOnce() { _tasks.drain(1); }
 
     // TODO
     // receive and return a context object
     //
     // since it is a FAKE yield (will break any result and no context)
     // you should save context by yourself (via lambda reference capture)
-    void yield() {
-        _mq.emplace(std::move(_lastEvent));
+    // ensure: called in a running task
+    void yield() { _tasks.yield(); }
+
+    // callable: void(), stored inline if it is small enough (see Task::INLINE_SIZE)
+    template <typename F>
+    void post(F &&event) {
+        if(isNull(event)) return;
+        _tasks.push(std::forward<F>(event));
     }
 
-    void post(std::function<void()> event) {
-        if(event) {
-            _mq.emplace(std::move(event));
-        }
+    // thread-safe, e.g. hand back the result from a worker thread
+    // the looper is woken up if it is blocked in multiplexer (see wakeupFd())
+    template <typename F>
+    void postRemote(F &&event) {
+        if(isNull(event)) return;
+        _inbox->post(std::forward<F>(event));
+    }
+
+    // should be watched by multiplexer
+    int wakeupFd() const { return _inbox->fd(); }
+
+    size_t pending() const { return _tasks.size(); }
+    // counters and histograms of this loop, see Metrics::aggregate()
+    Metrics& metrics() { return *_metrics; }
+    // slabs of the context buffers in this loop (see network/ChainBuffer.h)
+    SlabPool& slabs() { return *_slabs; }
+    // tasks/turn = tasks / turns
+    const Stats& stats() const { return _tasks.stats(); }
+
+// timer
+public:
+    // cached clock, updated per loop()
+    TimerPoint now() const { return _now; }
+
+    TimerId runAt(TimerPoint when, std::function<void()> callback) {
+        return _timers.add(when, {}, std::move(callback));
+    }
+
+    TimerId runAfter(std::chrono::nanoseconds delay, std::function<void()> callback) {
+        return _timers.add(TimerClock::now() + delay, {}, std::move(callback));
+    }
+
+    TimerId runEvery(std::chrono::nanoseconds interval, std::function<void()> callback) {
+        return _timers.add(TimerClock::now() + interval, interval, std::move(callback));
+    }
+
+    bool cancel(TimerId id) { return _timers.cancel(id); }
+
+    // timeout for multiplexer, 0 if there are pending tasks
+    std::chrono::milliseconds nextTimeout(std::chrono::milliseconds limit) const {
+        if(!_tasks.empty()) return std::chrono::milliseconds::zero();
+        auto nearest = _timers.nearest();
+        if(nearest == TimerPoint::max()) return limit;
+        auto current = TimerClock::now();
+        if(nearest <= current) return std::chrono::milliseconds::zero();
+        // round up, or wake up too early
+        auto timeout = std::chrono::ceil<std::chrono::milliseconds>(nearest - current);
+        return std::min(timeout, limit);
     }
 
 private:
-    void debug() {
-        std::cout << "[loop msg] " << _global++ << std::endl;
+    void receive() {
+        _inbox->drain([this](Task &&task) { _tasks.push(std::move(task)); });
+    }
+
+    void expire() {
+        _now = TimerClock::now();
+        if(!_timers.empty()) _timers.advance(_now);
     }
 
 private:
-    std::queue<std::function<void()>> _mq;
-    std::function<void()>             _lastEvent;
-    int                               _global {}; // debug
+    template <typename F>
+    static bool isNull(const std::function<F> &f) { return !f; }
+    template <typename F>
+    static bool isNull(F *f) { return !f; }
+    template <typename F>
+    static bool isNull(const F&) { return false; }
+
+private:
+    TaskQueue                         _tasks;
+    // address stable for producers
+    std::unique_ptr<Inbox>            _inbox {std::make_unique<Inbox>()};
+    TimerWheel                        _timers;
+    TimerPoint                        _now {TimerClock::now()};
+    // address stable, registered for aggregation
+    std::unique_ptr<Metrics>          _metrics {std::make_unique<Metrics>()};
+    // address stable, held by buffers
+    std::unique_ptr<SlabPool>         _slabs {std::make_unique<SlabPool>()};
 };
 
 } // fluent
 
-#undef CATURRA_16X
-#undef CATURRA_8X
-#undef CATURRA_4X
-#undef CATURRA_2X
-#undef SKYWIND3000_CPU_LOOP_UNROLL_4X
-
-#endif
\ No newline at end of file
+#endif
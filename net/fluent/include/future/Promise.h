@@ -22,6 +22,11 @@ public:
           _shared(std::make_shared<ControlBlock<T>>()) {}
 #endif
 
+    // attach to the shared state of an existing future
+    Promise(Looper *looper, SharedPtr<ControlBlock<T>> shared)
+        : _looper(looper),
+          _shared(std::move(shared)) {}
+
     // T_: a forward type of T, just reuse the code
     // case:
     // - T / T& : value copies to _state, if has _then, force cast (not actually moved, depends on then() argument)
@@ -0,0 +1,288 @@
+#ifndef __FLUENT_FUTURE_TASK_QUEUE_H__
+#define __FLUENT_FUTURE_TASK_QUEUE_H__
+#include <bits/stdc++.h>
+namespace fluent {
+
+// size-class free lists for the tasks that cannot be stored inline
+// one arena per looper, not thread-safe
+class TaskArena {
+public:
+    constexpr static size_t MIN_CLASS = 64;
+    constexpr static size_t CLASSES = 5; // 64 ... 1024
+    constexpr static size_t MAX_CLASS = MIN_CLASS << (CLASSES - 1);
+
+    void* allocate(size_t size);
+    void deallocate(void *pointer, size_t size);
+
+    TaskArena() = default;
+    ~TaskArena();
+    TaskArena(const TaskArena&) = delete;
+    TaskArena& operator=(const TaskArena&) = delete;
+
+private:
+    struct Block { Block *next; };
+
+    static size_t classOf(size_t size);
+
+private:
+    Block *_free[CLASSES] {};
+};
+
+// move-only void() with a fixed inline capture size
+// larger callables live in the arena
+class Task {
+public:
+    // Task is a cache line
+    constexpr static size_t INLINE_SIZE = 48;
+
+    template <typename F>
+    constexpr static bool isInline() {
+        return sizeof(F) <= INLINE_SIZE
+            && alignof(F) <= alignof(std::max_align_t)
+            && std::is_nothrow_move_constructible<F>::value;
+    }
+
+    void operator()() { _ops->invoke(*this); }
+    explicit operator bool() const { return _ops != nullptr; }
+
+    // ensure: this is empty
+    // arena == nullptr: use global heap for large callables (e.g. from other threads)
+    template <typename F>
+    void emplace(F &&f, TaskArena *arena);
+
+    Task() = default;
+    ~Task() { reset(); }
+    Task(Task &&rhs) noexcept { relocate(rhs); }
+    Task& operator=(Task &&rhs) noexcept { if(this != &rhs) { reset(); relocate(rhs); } return *this; }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+private:
+    struct Ops {
+        void (*invoke)(Task&);
+        // move src to dst (empty), src will be empty
+        void (*relocate)(Task &dst, Task &src);
+        void (*destroy)(Task&);
+    };
+
+    template <typename F> struct InlineOps;
+    template <typename F> struct ArenaOps;
+
+    void reset() { if(_ops) { _ops->destroy(*this); _ops = nullptr; } }
+    void relocate(Task &rhs) { if((_ops = rhs._ops)) { _ops->relocate(*this, rhs); rhs._ops = nullptr; } }
+
+private:
+    alignas(std::max_align_t) unsigned char _storage[INLINE_SIZE];
+    const Ops *_ops {nullptr};
+};
+
+// FIFO ring of tasks
+// the running task is popped before invoked, so it is safe to push / yield in a task
+class TaskQueue {
+public:
+    constexpr static size_t INIT_CAPACITY = 64;
+
+    struct Stats {
+        // invoked tasks
+        uint64_t tasks;
+        // drain() calls with at least one task
+        uint64_t turns;
+        // tasks stored in arena
+        uint64_t heapFallbacks;
+        // the largest batch
+        uint64_t maxBatch;
+    };
+
+    template <typename F>
+    void push(F &&f);
+
+    // run at most n tasks
+    // return: invoked count
+    size_t drain(size_t n);
+
+    // re-push the running task after it returns
+    void yield() { _yield = true; }
+
+    size_t size() const { return _tail - _head; }
+    bool empty() const { return _tail == _head; }
+    const Stats& stats() const { return _stats; }
+
+    TaskQueue(): _ring(INIT_CAPACITY) {}
+    TaskQueue(const TaskQueue&) = delete;
+    // ensure: not running
+    TaskQueue(TaskQueue&&) = default;
+    TaskQueue& operator=(const TaskQueue&) = delete;
+    TaskQueue& operator=(TaskQueue&&) = default;
+
+private:
+    Task& slot(size_t index) { return _ring[index & (_ring.size() - 1)]; }
+    void grow();
+
+private:
+    // arena outlives the tasks
+    std::unique_ptr<TaskArena> _arena {std::make_unique<TaskArena>()};
+    std::vector<Task> _ring;
+    // monotonic
+    size_t _head {0};
+    size_t _tail {0};
+    // the running task is in the old ring if the ring grows
+    std::vector<Task> _retired;
+    bool _running {false};
+    bool _yield {false};
+    Stats _stats {};
+};
+
+template <typename F>
+struct Task::InlineOps {
+    static F* get(Task &task) { return reinterpret_cast<F*>(task._storage); }
+    static void invoke(Task &task) { (*get(task))(); }
+    static void relocate(Task &dst, Task &src) {
+        new (dst._storage) F(std::move(*get(src)));
+        get(src)->~F();
+    }
+    static void destroy(Task &task) { get(task)->~F(); }
+    constexpr static Ops ops {invoke, relocate, destroy};
+};
+
+template <typename F>
+struct Task::ArenaOps {
+    struct Holder {
+        TaskArena *arena;
+        F f;
+    };
+    static Holder*& get(Task &task) { return *reinterpret_cast<Holder**>(task._storage); }
+    static void invoke(Task &task) { get(task)->f(); }
+    static void relocate(Task &dst, Task &src) {
+        new (dst._storage) Holder*(get(src));
+    }
+    static void destroy(Task &task) {
+        Holder *holder = get(task);
+        TaskArena *arena = holder->arena;
+        holder->~Holder();
+        if(arena) {
+            arena->deallocate(holder, sizeof(Holder));
+        } else {
+            ::operator delete(holder);
+        }
+    }
+    constexpr static Ops ops {invoke, relocate, destroy};
+};
+
+template <typename F>
+inline void Task::emplace(F &&f, TaskArena *arena) {
+    using Functor = typename std::decay<F>::type;
+    if constexpr (isInline<Functor>()) {
+        new (_storage) Functor(std::forward<F>(f));
+        _ops = &InlineOps<Functor>::ops;
+    } else {
+        using Holder = typename ArenaOps<Functor>::Holder;
+        void *memory = arena ? arena->allocate(sizeof(Holder)) : ::operator new(sizeof(Holder));
+        new (_storage) Holder*(new (memory) Holder{arena, std::forward<F>(f)});
+        _ops = &ArenaOps<Functor>::ops;
+    }
+}
+
+template <typename F>
+inline void TaskQueue::push(F &&f) {
+    using Functor = typename std::decay<F>::type;
+    // keep one slot for the running task
+    if(size() + 1 >= _ring.size()) grow();
+    Task &task = slot(_tail);
+    if constexpr (std::is_same<Functor, Task>::value) {
+        task = std::forward<F>(f);
+    } else {
+        if constexpr (!Task::isInline<Functor>()) {
+            _stats.heapFallbacks++;
+        }
+        task.emplace(std::forward<F>(f), _arena.get());
+    }
+    ++_tail;
+}
+
+inline size_t TaskQueue::drain(size_t n) {
+    size_t count = 0;
+    for(; count < n && _head != _tail; ++count) {
+        // if the ring grows in task, this slot is kept in _retired
+        Task &task = slot(_head++);
+        struct Finally {
+            TaskQueue *queue;
+            Task &task;
+            ~Finally() {
+                queue->_running = false;
+                if(queue->_yield) {
+                    queue->_yield = false;
+                    // push may grow and free the ring of this slot
+                    Task self = std::move(task);
+                    queue->push(std::move(self));
+                } else {
+                    task = Task{};
+                }
+                queue->_retired.clear();
+            }
+        } finally {this, task};
+        _running = true;
+        task();
+    }
+    if(count) {
+        _stats.tasks += count;
+        _stats.turns++;
+        _stats.maxBatch = std::max<uint64_t>(_stats.maxBatch, count);
+    }
+    return count;
+}
+
+inline void TaskQueue::grow() {
+    std::vector<Task> ring(_ring.size() << 1);
+    size_t size = this->size();
+    for(size_t i = 0; i < size; ++i) {
+        ring[i] = std::move(slot(_head + i));
+    }
+    _head = 0;
+    _tail = size;
+    // free the old ring after the running task returns
+    // vector move keeps the buffer, so the running task reference is still valid
+    if(_running && _retired.empty()) {
+        _retired = std::move(_ring);
+    }
+    _ring = std::move(ring);
+}
+
+inline void* TaskArena::allocate(size_t size) {
+    if(size > MAX_CLASS) return ::operator new(size);
+    size_t index = classOf(size);
+    if(Block *block = _free[index]) {
+        _free[index] = block->next;
+        return block;
+    }
+    return ::operator new(MIN_CLASS << index);
+}
+
+inline void TaskArena::deallocate(void *pointer, size_t size) {
+    if(size > MAX_CLASS) {
+        ::operator delete(pointer);
+        return;
+    }
+    size_t index = classOf(size);
+    auto block = static_cast<Block*>(pointer);
+    block->next = _free[index];
+    _free[index] = block;
+}
+
+inline TaskArena::~TaskArena() {
+    for(auto &head : _free) {
+        while(head) {
+            Block *block = head;
+            head = block->next;
+            ::operator delete(block);
+        }
+    }
+}
+
+inline size_t TaskArena::classOf(size_t size) {
+    size_t index = 0;
+    while((MIN_CLASS << index) < size) ++index;
+    return index;
+}
+
+} // fluent
+#endif
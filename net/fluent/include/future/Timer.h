@@ -0,0 +1,272 @@
+#ifndef __FLUENT_FUTURE_TIMER_H__
+#define __FLUENT_FUTURE_TIMER_H__
+#include <bits/stdc++.h>
+namespace fluent {
+
+using TimerClock = std::chrono::steady_clock;
+using TimerPoint = TimerClock::time_point;
+
+struct TimerId {
+    uint32_t index;
+    uint32_t generation;
+};
+
+// hierarchical timing wheel, 1ms per tick
+// 4 levels x 64 slots cover 64^4 ms (~4.6h), farther timers wait in an overflow list
+// insert / cancel: O(1)
+// advance: skips empty slots by occupied bitmaps
+// not thread-safe, owned by looper
+class TimerWheel {
+public:
+    using Callback = std::function<void()>;
+    using Tick = uint64_t;
+
+    constexpr static size_t LEVELS = 4;
+    constexpr static size_t SLOT_BITS = 6;
+    constexpr static size_t SLOTS = 1 << SLOT_BITS;
+    constexpr static std::chrono::milliseconds TICK {1};
+
+    // interval == 0: oneshot
+    TimerId add(TimerPoint when, std::chrono::nanoseconds interval, Callback callback);
+    // return: false if timer is expired (oneshot) or cancelled
+    bool cancel(TimerId id);
+
+    // run all expired timers before now
+    // return: count of callbacks
+    size_t advance(TimerPoint now);
+
+    // lower bound of the nearest deadline
+    // return: TimerPoint::max() if empty
+    TimerPoint nearest() const;
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    TimerWheel(TimerPoint origin = TimerClock::now()): _origin(origin) { clearSlots(); }
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel(TimerWheel&&) = default;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+    TimerWheel& operator=(TimerWheel&&) = default;
+
+private:
+    constexpr static uint32_t NIL = std::numeric_limits<uint32_t>::max();
+    constexpr static size_t OVERFLOW_LIST = LEVELS * SLOTS;
+
+    struct Node {
+        Callback callback;
+        Tick expire;
+        Tick interval;
+        uint32_t prev;
+        uint32_t next;
+        uint32_t generation;
+        // list index, or NIL if not linked
+        uint32_t list;
+    };
+
+    Tick toTick(TimerPoint point) const;
+    TimerPoint toPoint(Tick tick) const { return _origin + tick * TICK; }
+
+    // ensure: node is not linked
+    void link(uint32_t index);
+    void unlink(uint32_t index);
+    void release(uint32_t index);
+    // move the list to the lower levels
+    void cascade(size_t list);
+    // the first tick that needs work (expire or cascade)
+    Tick nearestTick() const;
+    void clearSlots();
+
+private:
+    TimerPoint _origin;
+    // next tick to be processed
+    Tick _current {0};
+    std::vector<Node> _nodes;
+    std::vector<uint32_t> _free;
+    // LEVELS * SLOTS + overflow
+    uint32_t _heads[LEVELS * SLOTS + 1];
+    uint64_t _occupied[LEVELS] {};
+    size_t _size {0};
+    // swapped by advance()
+    std::vector<std::pair<uint32_t, uint32_t>> _expired;
+};
+
+inline TimerId TimerWheel::add(TimerPoint when, std::chrono::nanoseconds interval, Callback callback) {
+    uint32_t index;
+    if(!_free.empty()) {
+        index = _free.back();
+        _free.pop_back();
+    } else {
+        index = _nodes.size();
+        _nodes.push_back(Node{{}, 0, 0, NIL, NIL, 0, NIL});
+    }
+    auto &node = _nodes[index];
+    node.callback = std::move(callback);
+    node.expire = std::max(toTick(when), _current);
+    // round up, at least 1 tick for periodic timers
+    node.interval = interval.count() > 0
+        ? std::max<Tick>(1, (interval + TICK - std::chrono::nanoseconds{1}) / TICK) : 0;
+    link(index);
+    ++_size;
+    return TimerId{index, node.generation};
+}
+
+inline bool TimerWheel::cancel(TimerId id) {
+    if(id.index >= _nodes.size()) return false;
+    auto &node = _nodes[id.index];
+    if(node.generation != id.generation) return false;
+    if(node.list != NIL) {
+        unlink(id.index);
+        release(id.index);
+    } else {
+        // firing, release it in advance()
+        ++node.generation;
+    }
+    return true;
+}
+
+inline size_t TimerWheel::advance(TimerPoint now) {
+    Tick target = toTick(now);
+    size_t count = 0;
+    while(_size) {
+        Tick tick = nearestTick();
+        if(tick > target) break;
+        _current = tick;
+        // higher levels first
+        for(size_t level = LEVELS; level-- > 1;) {
+            if(tick & ((Tick(1) << (level * SLOT_BITS)) - 1)) continue;
+            if(level == LEVELS - 1) cascade(OVERFLOW_LIST);
+            cascade(level * SLOTS + ((tick >> (level * SLOT_BITS)) & (SLOTS - 1)));
+        }
+        size_t slot = tick & (SLOTS - 1);
+        _expired.clear();
+        for(uint32_t index = _heads[slot]; index != NIL; index = _nodes[index].next) {
+            _expired.emplace_back(index, _nodes[index].generation);
+        }
+        _heads[slot] = NIL;
+        _occupied[0] &= ~(uint64_t(1) << slot);
+        _current = tick + 1;
+        // callback may add / cancel timers
+        auto expired = std::move(_expired);
+        for(auto &e : expired) {
+            _nodes[e.first].list = NIL;
+        }
+        for(auto &e : expired) {
+            auto index = e.first;
+            // cancelled by the previous callback
+            if(_nodes[index].generation != e.second) {
+                release(index);
+                continue;
+            }
+            auto callback = std::move(_nodes[index].callback);
+            callback();
+            ++count;
+            auto &node = _nodes[index];
+            if(node.interval && node.generation == e.second) {
+                node.callback = std::move(callback);
+                node.expire = tick + node.interval;
+                link(index);
+            } else {
+                release(index);
+            }
+        }
+        _expired = std::move(expired);
+    }
+    if(_current <= target) _current = target + 1;
+    return count;
+}
+
+inline TimerPoint TimerWheel::nearest() const {
+    if(_size == 0) return TimerPoint::max();
+    return toPoint(nearestTick());
+}
+
+inline TimerWheel::Tick TimerWheel::toTick(TimerPoint point) const {
+    if(point <= _origin) return 0;
+    return std::chrono::duration_cast<std::chrono::milliseconds>(point - _origin).count();
+}
+
+inline void TimerWheel::link(uint32_t index) {
+    auto &node = _nodes[index];
+    Tick expire = std::max(node.expire, _current);
+    // level: the highest differing slot group of expire and current
+    size_t list = OVERFLOW_LIST;
+    for(size_t level = 0; level < LEVELS; ++level) {
+        if((expire >> ((level + 1) * SLOT_BITS)) == (_current >> ((level + 1) * SLOT_BITS))) {
+            size_t slot = (expire >> (level * SLOT_BITS)) & (SLOTS - 1);
+            list = level * SLOTS + slot;
+            _occupied[level] |= uint64_t(1) << slot;
+            break;
+        }
+    }
+    node.list = list;
+    node.prev = NIL;
+    node.next = _heads[list];
+    if(node.next != NIL) _nodes[node.next].prev = index;
+    _heads[list] = index;
+}
+
+inline void TimerWheel::unlink(uint32_t index) {
+    auto &node = _nodes[index];
+    if(node.prev != NIL) {
+        _nodes[node.prev].next = node.next;
+    } else {
+        _heads[node.list] = node.next;
+        if(node.next == NIL && node.list != OVERFLOW_LIST) {
+            _occupied[node.list / SLOTS] &= ~(uint64_t(1) << (node.list % SLOTS));
+        }
+    }
+    if(node.next != NIL) _nodes[node.next].prev = node.prev;
+    node.list = NIL;
+}
+
+inline void TimerWheel::release(uint32_t index) {
+    auto &node = _nodes[index];
+    node.callback = nullptr;
+    ++node.generation;
+    _free.push_back(index);
+    --_size;
+}
+
+inline void TimerWheel::cascade(size_t list) {
+    uint32_t index = _heads[list];
+    _heads[list] = NIL;
+    if(list != OVERFLOW_LIST) {
+        _occupied[list / SLOTS] &= ~(uint64_t(1) << (list % SLOTS));
+    }
+    while(index != NIL) {
+        uint32_t next = _nodes[index].next;
+        link(index);
+        index = next;
+    }
+}
+
+inline TimerWheel::Tick TimerWheel::nearestTick() const {
+    // pending cascade at the current boundary
+    for(size_t level = 1; level < LEVELS; ++level) {
+        size_t shift = level * SLOT_BITS;
+        if(_current & ((Tick(1) << shift) - 1)) break;
+        if((_occupied[level] >> ((_current >> shift) & (SLOTS - 1))) & 1) return _current;
+        if(level == LEVELS - 1 && _heads[OVERFLOW_LIST] != NIL) return _current;
+    }
+    // otherwise lower levels are always earlier
+    for(size_t level = 0; level < LEVELS; ++level) {
+        size_t shift = level * SLOT_BITS;
+        size_t from = (_current >> shift) & (SLOTS - 1);
+        // level 0 includes the current slot
+        uint64_t mask = _occupied[level] & (~uint64_t(0) << from);
+        if(mask) {
+            Tick block = (_current >> (shift + SLOT_BITS)) << (shift + SLOT_BITS);
+            return block + (Tick(__builtin_ctzll(mask)) << shift);
+        }
+    }
+    // overflow: the next top level block
+    size_t shift = LEVELS * SLOT_BITS;
+    return ((_current >> shift) + 1) << shift;
+}
+
+inline void TimerWheel::clearSlots() {
+    std::fill(std::begin(_heads), std::end(_heads), NIL);
+}
+
+} // fluent
+#endif
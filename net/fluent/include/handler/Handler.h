@@ -4,33 +4,48 @@
 #include "../network/Multiplexer.h"
 #include "../network/Context.h"
 #include "../logger/Logger.h"
+#include "../codec/Codecs.h"
 #include "HandlerBase.h"
 namespace fluent {
 
 template <typename ConnectCallback,
           typename MessageCallback,
-          typename CloseCallback>
+          typename CloseCallback,
+          typename Codec = RawCodec>
 class Handler
-    : public HandlerBase<Handler<ConnectCallback, MessageCallback, CloseCallback>,
+    : public HandlerBase<Handler<ConnectCallback, MessageCallback, CloseCallback, Codec>,
                          Multiplexer::Token,
                          Multiplexer::Bundle> {
 public:
     using ConnectCallbackType = ConnectCallback;
     using MessageCallbackType = MessageCallback;
     using CloseCallbackType   = CloseCallback;
+    using CodecType           = Codec;
 
     using Token = Multiplexer::Token;
     using Bundle = Multiplexer::Bundle;
 
-    using ThisType = Handler<ConnectCallback, MessageCallback, CloseCallback>;
+    using ThisType = Handler<ConnectCallback, MessageCallback, CloseCallback, Codec>;
     using Base = HandlerBase<ThisType, Token, Bundle>;
 
+    // reads per readiness event, the message callback is called once after them
+    // edge-triggered: drain until EAGAIN (or a short read), the rest is deferred to
+    // a looper task if the budget runs out, so a busy connection cannot starve the others
+    constexpr static size_t READ_BUDGET = Context::EDGE_TRIGGERED ? 16 : 1;
+
 public:
     // side effect: event vector .clear()
     void handleEvents(Token token);
 
     void handleNewContext(Bundle bundle);
 
+    // CONNECTING context is writable, or failed (POLLERR / POLLHUP)
+    // see Connector and Multiplexer::connect()
+    void handleConnect(Bundle bundle, uint32_t revent);
+
+    // closed contexts, should be retired by pool
+    std::vector<Bundle>& closed() { return _closedBuffer; }
+
 // require
 public:
     void handleRead(Bundle bundle);
@@ -53,6 +68,9 @@ public:
     void onConnect(ConnectCallback callback) { _connectCallback = std::move(callback); _connectFlag = true; }
     void onMessage(MessageCallback callback) { _messageCallback = std::move(callback); _messageFlag = true;}
     void onClose(CloseCallback callback) { _closeCallback = std::move(callback); _closeFlag = true; }
+    // e.g. max frame
+    void setCodec(Codec codec) { _codec = std::move(codec); }
+    const Codec& codec() const { return _codec; }
 
 public:
     Handler() = delete;
@@ -82,30 +100,41 @@ public:
 
 private:
     void handleWriteComplete(Context *context, ssize_t n);
+    // edge-triggered: continue the read in looper
+    void deferRead(Bundle bundle);
+    // Context::enableRead()
+    static void deferReadOf(void *handler, Bundle bundle) { static_cast<Handler*>(handler)->deferRead(bundle); }
+    // codec: call the message callback per complete frame
+    // fresh: bytes appended to input by this read
+    void handleFrames(Context *context, size_t fresh);
 
 private:
     Multiplexer     *_multiplexer;
     ConnectCallback _connectCallback;
     MessageCallback _messageCallback;
     CloseCallback   _closeCallback;
+    Codec           _codec;
     std::vector<epoll_event> _eventBuffer;
+    std::vector<Bundle> _closedBuffer;
     // template functor cannot cast bool(f) to check flag (std::function is fine)
     bool _connectFlag;
     bool _messageFlag;
     bool _closeFlag;
 };
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline void Handler<ConnectCallback, MessageCallback, CloseCallback>::handleEvents(Token token) {
-    {
-        std::lock_guard<std::mutex> _{_multiplexer->_mutex};
-        auto &eventVector = _multiplexer->visit(token);
-        std::swap(eventVector, _eventBuffer);
-    }
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void Handler<ConnectCallback, MessageCallback, CloseCallback, Codec>::handleEvents(Token token) {
+    _multiplexer->exchange(token, _eventBuffer);
     for(auto &event : _eventBuffer) {
-        auto bundle = static_cast<Bundle>(event.data.ptr);
+        auto bundle = Multiplexer::bundleOf(event);
+        // stale event of a reused slot
+        if(!bundle) continue;
         auto revent = event.events;
         try {
+            if(bundle->second.isConnecting()) {
+                handleConnect(bundle, revent);
+                continue;
+            }
             Base::handleEvent(bundle, revent);
         } catch(const std::exception &e) {
             auto context = &bundle->second;
@@ -113,14 +142,15 @@ inline void Handler<ConnectCallback, MessageCallback, CloseCallback>::handleEven
             FLUENT_LOG_DEBUG("context handling:", context->simpleInfo(),
                 context->networkInfo(), context->eventStateInfo(), context->eventsInfo());
             context->exception = std::current_exception();
+            context->looper->metrics().add(Metrics::EXCEPTIONS);
             // TODO _exceptionCallback(context);
         }
     }
     _eventBuffer.clear();
 }
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline void Handler<ConnectCallback, MessageCallback, CloseCallback>::handleNewContext(Bundle bundle) try {
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void Handler<ConnectCallback, MessageCallback, CloseCallback, Codec>::handleNewContext(Bundle bundle) try {
     auto context = &bundle->second;
     FLUENT_LOG_DEBUG(context->simpleInfo(), "connecting");
     // ensure
@@ -129,6 +159,9 @@ inline void Handler<ConnectCallback, MessageCallback, CloseCallback>::handleNewC
     // assert CONNECTING
     context->_nState = Context::NetworkState::CONNECTED;
     context->enableRead();
+    // after the first enableRead(), epoll reports the bytes that are already there
+    context->_deferRead = &Handler::deferReadOf;
+    context->_handler = this;
     Context::EpollOperationHint operation;
     if((operation = context->updateEventState()) != Context::EPOLL_CTL_NONE) {
         _multiplexer->update(operation, bundle);
@@ -139,35 +172,87 @@ inline void Handler<ConnectCallback, MessageCallback, CloseCallback>::handleNewC
     auto context = &bundle->second;
     FLUENT_LOG_WARN(context->simpleInfo(), "catches an exception:", e.what());
     context->exception = std::current_exception();
+    context->looper->metrics().add(Metrics::EXCEPTIONS);
     // TODO _exceptionCallback(context);
 }
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline void Handler<ConnectCallback, MessageCallback, CloseCallback>::handleRead(Bundle bundle) {
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void Handler<ConnectCallback, MessageCallback, CloseCallback, Codec>::handleConnect(Bundle bundle, uint32_t revent) {
+    auto context = &bundle->second;
+    if(revent & (POLLERR | POLLHUP)) {
+        FLUENT_LOG_WARN(context->simpleInfo(), "connect failed");
+        // the next attempt needs a new socket, closing fd also removes it from epoll
+        Socket().swap(context->socket);
+        context->_eState = Context::EventState::NEW;
+        context->_hashcode = 0;
+        context->_cachedInfo.clear();
+        context->wakeConnector(false);
+        return;
+    }
+    handleNewContext(bundle);
+    context->wakeConnector(true);
+    // edge-triggered: the first bytes may arrive with the connect event
+    if(Context::EDGE_TRIGGERED && (revent & (POLLIN | POLLPRI | POLLRDHUP))) {
+        handleRead(bundle);
+    }
+}
+
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void Handler<ConnectCallback, MessageCallback, CloseCallback, Codec>::handleRead(Bundle bundle) {
     auto context = &bundle->second;
-    ssize_t n = context->input.readFrom(context->socket.fd());
-    FLUENT_LOG_DEBUG(context->simpleInfo(), "<--", "(stream length)", n);
-    if(n > 0) {
-        if(_messageFlag) _messageCallback(context);
-    } else if(n == 0) {
+    // edge-triggered: always armed, paused by disableRead()
+    if(Context::EDGE_TRIGGERED && !context->readEventEnabled()) return;
+    ssize_t n;
+    ssize_t total = 0;
+    size_t budget = READ_BUDGET;
+    for(;;) {
+        ssize_t limit = context->input.readLimit();
+        n = _multiplexer->readFrom(bundle);
+        FLUENT_LOG_DEBUG(context->simpleInfo(), "<--", "(stream length)", n);
+        if(n > 0) total += n;
+        // stream socket: a short read means it is drained, no need to wait for EAGAIN
+        if(n < limit || --budget == 0) break;
+    }
+    // callbacks may overwrite it
+    int error = errno;
+    if(total > 0) {
+        context->_lastRead = context->looper->now();
+        // coroutine reader first, then the callback
+        context->wakeReader(context->input.unread(), false);
+        if(_messageFlag) {
+            auto begin = TimerClock::now();
+            if constexpr (std::is_same<Codec, RawCodec>::value) {
+                _messageCallback(context);
+            } else {
+                handleFrames(context, total);
+            }
+            context->looper->metrics().callbackTime().record(TimerClock::now() - begin);
+        }
+    }
+    if(n == 0) {
         // TODO add: const char *callbackReason / size_t reasonCode in Context
         // TODO handleClose(context, "reason...")
         FLUENT_LOG_INFO(context->simpleInfo(), "<--", "FIN");
         handleClose(bundle);
-    } else if(errno != EAGAIN && errno != EINTR) {
+    } else if(n < 0 && error != EAGAIN && error != EINTR) {
         handleError(bundle);
+    } else if(Context::EDGE_TRIGGERED && (budget == 0 || (n < 0 && error == EINTR))) {
+        // no more edge for the unread bytes
+        deferRead(bundle);
     }
 }
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline void Handler<ConnectCallback, MessageCallback, CloseCallback>::handleWrite(Bundle bundle) {
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void Handler<ConnectCallback, MessageCallback, CloseCallback, Codec>::handleWrite(Bundle bundle) {
     auto context = &bundle->second;
     if(context->writeEventEnabled()) {
-        ssize_t n = context->output.writeTo(context->socket.fd());
+        ssize_t n = _multiplexer->writeTo(bundle);
         FLUENT_LOG_DEBUG(context->simpleInfo(), "-->", "(stream length)", n);
         // assert n >= 0
+        if(n > 0) context->_lastWrite = context->looper->now();
         handleWriteComplete(context, n);
-        if(n > 0 && context->output.unread() == 0) {
+        // MSG_ZEROCOPY: n may be 0 but the send queue is drained
+        if(_multiplexer->flushed(bundle)) {
             Context::EpollOperationHint operation;
             if(context->disableWrite()
                     && ((operation = context->updateEventState()) != Context::EPOLL_CTL_NONE)) {
@@ -177,8 +262,8 @@ inline void Handler<ConnectCallback, MessageCallback, CloseCallback>::handleWrit
     }
 }
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline void Handler<ConnectCallback, MessageCallback, CloseCallback>::handleClose(Bundle bundle) {
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void Handler<ConnectCallback, MessageCallback, CloseCallback, Codec>::handleClose(Bundle bundle) {
     auto context = &bundle->second;
     if(context->isConnected() || context->isDisConnecting()) {
         // try to shutdown if force close
@@ -191,43 +276,92 @@ inline void Handler<ConnectCallback, MessageCallback, CloseCallback>::handleClos
             _multiplexer->update(operation, bundle);
         }
         context->_nState = Context::NetworkState::DISCONNECTED;
+        // the rest will never be flushed
+        context->abortSend(context->looper);
+        context->wakeReader(context->input.unread(), true);
+        _closedBuffer.emplace_back(bundle);
         if(_closeFlag) _closeCallback(context);
         FLUENT_LOG_INFO(context->simpleInfo(), "close. [HASHCODE]", context->hashcode());
     }
 }
 
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline void Handler<ConnectCallback, MessageCallback, CloseCallback>::handleError(Bundle bundle) {
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void Handler<ConnectCallback, MessageCallback, CloseCallback, Codec>::handleError(Bundle bundle) {
+    auto context = &bundle->second;
+    // MSG_ZEROCOPY notification is not a real error
+    if(context->_zeroCopy) {
+        ssize_t n = context->reapZeroCopy();
+        if(n >= 0) {
+            handleWriteComplete(context, n);
+            return;
+        }
+    }
     // auto context = &bundle->second;
     // try {
     //     throw FluentException("error callback");
     // } catch(...) {
     //     context->exception = std::current_exception();
     // }
-    FLUENT_LOG_WARN((&bundle->second)->simpleInfo(), "error callback!");
+    FLUENT_LOG_WARN(context->simpleInfo(), "error callback!");
+    // edge-triggered: the error (e.g. RST) is reported once, nobody would close it later
+    if(Context::EDGE_TRIGGERED) handleClose(bundle);
     throw FluentException("error callback");
 }
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline void Handler<ConnectCallback, MessageCallback, CloseCallback>::handleError(Bundle bundle, const char *errorMessage) {
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void Handler<ConnectCallback, MessageCallback, CloseCallback, Codec>::handleError(Bundle bundle, const char *errorMessage) {
     FLUENT_LOG_WARN((&bundle->second)->simpleInfo(), errorMessage);
     throw FluentException(errorMessage);
 }
 
-template <typename ConnectCallback, typename MessageCallback, typename CloseCallback>
-inline void Handler<ConnectCallback, MessageCallback, CloseCallback>::handleWriteComplete(Context *context, ssize_t n) {
-    auto &provider = context->_sendProvider;
-    while(n > 0 && !provider.empty()) {
-        if(provider.front() > n) {
-            provider.front() -= n;
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void Handler<ConnectCallback, MessageCallback, CloseCallback, Codec>::handleWriteComplete(Context *context, ssize_t n) {
+    if(n > 0) context->completeSend(n, context->looper);
+}
+
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void Handler<ConnectCallback, MessageCallback, CloseCallback, Codec>::handleFrames(Context *context, size_t fresh) {
+    auto &input = context->input;
+    size_t unread = input.unread();
+    size_t consumed = 0;
+    // the rest of the previous read has been searched
+    size_t scanned = unread - std::min(unread, fresh);
+    while(consumed < unread) {
+        Frame frame;
+        ssize_t n = _codec.decode(input.readBuffer() + consumed, unread - consumed, scanned, frame);
+        if(n == 0) break;
+        if(n < 0) {
+            FLUENT_LOG_WARN(context->simpleInfo(), "bad frame");
+            consumed = unread;
+            context->forceClose();
             break;
         }
-        // else
-        n -= provider.front();
-        provider.pop();
-        context->_sendCompletedIndex++;
+        scanned = 0;
+        consumed += n;
+        _messageCallback(context, frame);
     }
+    // frames are invalid now
+    input.hasRead(consumed);
+}
+
+template <typename ConnectCallback, typename MessageCallback, typename CloseCallback, typename Codec>
+inline void Handler<ConnectCallback, MessageCallback, CloseCallback, Codec>::deferRead(Bundle bundle) {
+    auto context = &bundle->second;
+    // tasks posted in this turn run after all ready events
+    context->looper->post([this, bundle, generation = context->_generation] {
+        auto context = &bundle->second;
+        // retired or reused
+        if(context->_generation != generation) return;
+        if(!context->isConnected() && !context->isDisConnecting()) return;
+        try {
+            handleRead(bundle);
+        } catch(const std::exception &e) {
+            FLUENT_LOG_WARN(context->simpleInfo(), "catches an exception:", e.what());
+            context->exception = std::current_exception();
+            context->looper->metrics().add(Metrics::EXCEPTIONS);
+        }
+    });
 }
 
 } // fluent
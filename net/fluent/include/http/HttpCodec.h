@@ -0,0 +1,61 @@
+#ifndef __FLUENT_HTTP_HTTP_CODEC_H__
+#define __FLUENT_HTTP_HTTP_CODEC_H__
+#include <bits/stdc++.h>
+#include "../network/Context.h"
+#include "HttpRequest.h"
+#include "HttpParser.h"
+#include "HttpResponse.h"
+namespace fluent {
+
+// per-connection HTTP/1.1 server codec
+//
+// server.onConnect([](Context *context) { context->any = HttpCodec{}; });
+// server.onMessage([](Context *context) {
+//     cast<HttpCodec>(&context->any)->serve(context, [](const HttpRequest &request, HttpResponse &response) {
+//         response.status(200).keepAlive(request.keepAlive).body("hello");
+//     });
+// });
+class HttpCodec {
+public:
+    // handler: void(const HttpRequest&, HttpResponse&), formats exactly one response
+    // all pipelined requests in input are handled, and their responses are sent by one write
+    // return: false if the connection is shutdown (bad request or not keep-alive)
+    template <typename RequestHandler>
+    bool serve(Context *context, RequestHandler &&handler);
+
+    HttpParser& parser() { return _parser; }
+
+private:
+    HttpParser _parser;
+    HttpRequest _request;
+};
+
+template <typename RequestHandler>
+inline bool HttpCodec::serve(Context *context, RequestHandler &&handler) {
+    auto &input = context->input;
+    HttpResponse response {context};
+    size_t consumed = 0;
+    bool open = true;
+    while(open) {
+        auto status = _parser.parse(input.readBuffer() + consumed, input.unread() - consumed, _request);
+        if(status == HttpParser::Status::INCOMPLETE) break;
+        if(status == HttpParser::Status::ERROR) {
+            FLUENT_LOG_INFO(context->simpleInfo(), "bad request", _parser.error());
+            response.status(_parser.error()).keepAlive(false).end();
+            _parser.reset();
+            open = false;
+            break;
+        }
+        handler(static_cast<const HttpRequest&>(_request), response);
+        consumed += _request.length;
+        open = _request.keepAlive;
+    }
+    // views in request are invalid now
+    input.hasRead(open ? consumed : input.unread());
+    response.send();
+    if(!open) context->shutdown();
+    return open;
+}
+
+} // fluent
+#endif
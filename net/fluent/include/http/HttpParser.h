@@ -0,0 +1,234 @@
+#ifndef __FLUENT_HTTP_HTTP_PARSER_H__
+#define __FLUENT_HTTP_HTTP_PARSER_H__
+#include <bits/stdc++.h>
+#include "../network/Buffer.h"
+#include "../utils/FindCharset.h"
+#include "HttpRequest.h"
+namespace fluent {
+
+// incremental HTTP/1.1 request parser, zero-copy
+// one parser per connection, e.g. stored in Context::any
+//
+// pipelining: parse() returns the first request in data,
+// the caller consumes request.length bytes and parses again
+//
+// incremental: a partial request is rescanned only from the new bytes
+// until the end of head arrives, so it must be parsed from the same start
+//
+// not supported: chunked request body (501)
+class HttpParser {
+public:
+    constexpr static size_t MAX_HEAD_SIZE = 64 * 1024;
+    constexpr static size_t MAX_BODY_SIZE = 8 * 1024 * 1024;
+
+    enum class Status {
+        COMPLETE,
+        INCOMPLETE,
+        ERROR,
+    };
+
+    Status parse(const char *data, size_t length, HttpRequest &request);
+    Status parse(const Buffer &input, HttpRequest &request) { return parse(input.readBuffer(), input.unread(), request); }
+
+    // response status code if parse() returns ERROR
+    int error() const { return _error; }
+
+    void reset() { _scanned = 0; _expected = 0; _error = 0; }
+
+private:
+    // full parse, return INCOMPLETE if the data ends in head or body
+    Status parseRequest(const char *data, size_t length, HttpRequest &request);
+    // the end of head is in [_scanned - 3, length)
+    bool headArrived(const char *data, size_t length) const;
+    Status incomplete(size_t length);
+    Status fail(int status) { _error = status; return Status::ERROR; }
+
+private:
+    // scanned bytes with no end of head
+    size_t _scanned {0};
+    // head + body length if the head is parsed but the body is incomplete
+    size_t _expected {0};
+    int _error {0};
+};
+
+namespace http {
+
+// CTL: 0x00-0x1f, 0x7f
+constexpr Charset makeCharset(const char *chars, bool ctl, bool tab = true) {
+    Charset charset {chars};
+    if(ctl) {
+        charset.addRange(0x00, 0x1f);
+        charset.add(0x7f);
+        if(!tab) charset.remove('\t');
+    }
+    return charset;
+}
+
+// method / target end, or invalid char
+constexpr Charset TOKEN_END = makeCharset(" ", true);
+// header name end, or invalid char
+constexpr Charset NAME_END = makeCharset(": ", true);
+// header value end (CR / LF), or invalid char, HTAB is allowed
+constexpr Charset VALUE_END = makeCharset("", true, false);
+constexpr Charset LINE_FEED = makeCharset("\n", false);
+
+} // http
+
+inline HttpParser::Status HttpParser::parse(const char *data, size_t length, HttpRequest &request) {
+    // fast incomplete checks
+    if(_expected) {
+        if(length < _expected) return Status::INCOMPLETE;
+    } else if(_scanned && !headArrived(data, length)) {
+        return incomplete(length);
+    }
+    Status status = parseRequest(data, length, request);
+    if(status == Status::COMPLETE) reset();
+    return status;
+}
+
+inline HttpParser::Status HttpParser::parseRequest(const char *data, size_t length, HttpRequest &request) {
+    const char *cursor = data;
+    const char *end = data + length;
+    auto find = [&](const Charset &charset) -> const char* {
+        ssize_t index = findCharset(cursor, end - cursor, charset);
+        return index < 0 ? nullptr : cursor + index;
+    };
+    // consume CRLF or LF, return false if incomplete
+    // ensure: cursor points to CR or LF
+    auto newline = [&](bool &ok) -> bool {
+        if(*cursor == '\r') {
+            if(cursor + 1 == end) return false;
+            if(cursor[1] != '\n') { ok = false; return true; }
+            cursor += 2;
+        } else if(*cursor == '\n') {
+            ++cursor;
+        } else {
+            ok = false;
+        }
+        return true;
+    };
+    bool ok = true;
+
+    // request line
+    const char *delimiter = find(http::TOKEN_END);
+    if(!delimiter) return incomplete(length);
+    if(*delimiter != ' ' || delimiter == cursor) return fail(400);
+    request.method = {cursor, size_t(delimiter - cursor)};
+    cursor = delimiter + 1;
+
+    delimiter = find(http::TOKEN_END);
+    if(!delimiter) return incomplete(length);
+    if(*delimiter != ' ' || delimiter == cursor) return fail(400);
+    request.target = {cursor, size_t(delimiter - cursor)};
+    cursor = delimiter + 1;
+
+    // HTTP/1.x
+    constexpr size_t VERSION_SIZE = 8;
+    if(size_t(end - cursor) <= VERSION_SIZE) return incomplete(length);
+    if(::memcmp(cursor, "HTTP/1.", VERSION_SIZE - 1)) return fail(505);
+    if(cursor[VERSION_SIZE - 1] != '0' && cursor[VERSION_SIZE - 1] != '1') return fail(505);
+    request.version = 10 + (cursor[VERSION_SIZE - 1] - '0');
+    cursor += VERSION_SIZE;
+    if(!newline(ok)) return incomplete(length);
+    if(!ok) return fail(400);
+
+    // headers
+    std::string_view contentLength;
+    std::string_view connection;
+    bool chunked = false;
+    request.headerCount = 0;
+    for(;;) {
+        if(cursor == end) return incomplete(length);
+        if(*cursor == '\r' || *cursor == '\n') {
+            if(!newline(ok)) return incomplete(length);
+            if(!ok) return fail(400);
+            break;
+        }
+        // obsolete line folding is rejected
+        if(*cursor == ' ' || *cursor == '\t') return fail(400);
+
+        delimiter = find(http::NAME_END);
+        if(!delimiter) return incomplete(length);
+        if(*delimiter != ':' || delimiter == cursor) return fail(400);
+        std::string_view name {cursor, size_t(delimiter - cursor)};
+        cursor = delimiter + 1;
+        while(cursor != end && (*cursor == ' ' || *cursor == '\t')) ++cursor;
+
+        delimiter = find(http::VALUE_END);
+        if(!delimiter) return incomplete(length);
+        const char *valueEnd = delimiter;
+        while(valueEnd != cursor && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t')) --valueEnd;
+        std::string_view value {cursor, size_t(valueEnd - cursor)};
+        cursor = delimiter;
+        if(!newline(ok)) return incomplete(length);
+        if(!ok) return fail(400);
+
+        if(request.headerCount == HttpRequest::MAX_HEADERS) return fail(431);
+        request.headers[request.headerCount++] = {name, value};
+        // the known headers, compared only if the length matches
+        switch(name.size()) {
+            case 10:
+                if(HttpRequest::equalsIgnoreCase(name, "Connection")) connection = value;
+            break;
+            case 14:
+                if(HttpRequest::equalsIgnoreCase(name, "Content-Length")) {
+                    // conflicting lengths are an attack vector of request smuggling
+                    if(!contentLength.empty() && contentLength != value) return fail(400);
+                    contentLength = value;
+                }
+            break;
+            case 17:
+                if(HttpRequest::equalsIgnoreCase(name, "Transfer-Encoding")) chunked = true;
+            break;
+        }
+    }
+    size_t headLength = cursor - data;
+    if(headLength > MAX_HEAD_SIZE) return fail(431);
+    if(chunked) return fail(501);
+
+    size_t bodyLength = 0;
+    if(!contentLength.empty()) {
+        for(char c : contentLength) {
+            if(c < '0' || c > '9') return fail(400);
+            bodyLength = bodyLength * 10 + (c - '0');
+            if(bodyLength > MAX_BODY_SIZE) return fail(413);
+        }
+    }
+    if(length - headLength < bodyLength) {
+        _expected = headLength + bodyLength;
+        return Status::INCOMPLETE;
+    }
+    request.body = {cursor, bodyLength};
+    request.length = headLength + bodyLength;
+    if(request.version == 11) {
+        request.keepAlive = !HttpRequest::containsToken(connection, "close");
+    } else {
+        request.keepAlive = HttpRequest::containsToken(connection, "keep-alive");
+    }
+    return Status::COMPLETE;
+}
+
+inline bool HttpParser::headArrived(const char *data, size_t length) const {
+    // "\n\r\n" or "\n\n" may cross the last scanned bytes
+    size_t from = _scanned < 3 ? 0 : _scanned - 3;
+    while(from < length) {
+        ssize_t index = findCharset(data + from, length - from, http::LINE_FEED);
+        if(index < 0) return false;
+        size_t lf = from + index;
+        if(lf + 1 < length && data[lf + 1] == '\n') return true;
+        if(lf + 2 < length && data[lf + 1] == '\r' && data[lf + 2] == '\n') return true;
+        // the end is not arrived
+        if(lf + 2 >= length) return false;
+        from = lf + 1;
+    }
+    return false;
+}
+
+inline HttpParser::Status HttpParser::incomplete(size_t length) {
+    if(length > MAX_HEAD_SIZE) return fail(431);
+    _scanned = length;
+    return Status::INCOMPLETE;
+}
+
+} // fluent
+#endif
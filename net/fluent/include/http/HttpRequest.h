@@ -0,0 +1,67 @@
+#ifndef __FLUENT_HTTP_HTTP_REQUEST_H__
+#define __FLUENT_HTTP_HTTP_REQUEST_H__
+#include <bits/stdc++.h>
+namespace fluent {
+
+struct HttpHeader {
+    std::string_view name;
+    std::string_view value;
+};
+
+// parsed by HttpParser
+// all views point into the input buffer, valid until the request is consumed
+struct HttpRequest {
+    constexpr static size_t MAX_HEADERS = 64;
+
+    std::string_view method;
+    std::string_view target;
+    // 10: HTTP/1.0, 11: HTTP/1.1
+    int version;
+    HttpHeader headers[MAX_HEADERS];
+    size_t headerCount;
+    std::string_view body;
+    bool keepAlive;
+    // bytes of the whole request (head and body)
+    size_t length;
+
+    // case-insensitive, return the first one
+    // return: empty if not found
+    std::string_view header(std::string_view name) const;
+
+    static bool equalsIgnoreCase(std::string_view lhs, std::string_view rhs);
+    // comma-separated list contains token, e.g. Connection: keep-alive, Upgrade
+    static bool containsToken(std::string_view list, std::string_view token);
+};
+
+inline std::string_view HttpRequest::header(std::string_view name) const {
+    for(size_t i = 0; i < headerCount; ++i) {
+        if(equalsIgnoreCase(headers[i].name, name)) return headers[i].value;
+    }
+    return {};
+}
+
+inline bool HttpRequest::equalsIgnoreCase(std::string_view lhs, std::string_view rhs) {
+    if(lhs.size() != rhs.size()) return false;
+    for(size_t i = 0; i < lhs.size(); ++i) {
+        // ascii only, (c | 0x20) is lowercase for letters
+        char l = lhs[i], r = rhs[i];
+        if(l != r && ((l | 0x20) != (r | 0x20) || (l | 0x20) < 'a' || (l | 0x20) > 'z')) return false;
+    }
+    return true;
+}
+
+inline bool HttpRequest::containsToken(std::string_view list, std::string_view token) {
+    while(!list.empty()) {
+        size_t comma = list.find(',');
+        auto item = list.substr(0, comma);
+        while(!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+        while(!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+        if(equalsIgnoreCase(item, token)) return true;
+        if(comma == std::string_view::npos) break;
+        list.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+} // fluent
+#endif
@@ -0,0 +1,134 @@
+#ifndef __FLUENT_HTTP_HTTP_RESPONSE_H__
+#define __FLUENT_HTTP_HTTP_RESPONSE_H__
+#include <sys/uio.h>
+#include <bits/stdc++.h>
+#include "../network/Context.h"
+namespace fluent {
+
+// response builder, formats straight into Context::output
+// usage: status() -> header()... -> body() / end()
+//
+// the bytes are not sent until send(), so pipelined responses can be batched:
+//     HttpResponse response {context};
+//     for(each request) response.status(200).header(...).body(...);
+//     response.send();
+class HttpResponse {
+public:
+    explicit HttpResponse(Context *context)
+        : _context(context),
+          _mark(context->output.unread()) {}
+
+    HttpResponse& status(int code, std::string_view reason = {});
+    HttpResponse& header(std::string_view name, std::string_view value);
+    HttpResponse& header(std::string_view name, size_t value);
+    // default: keep-alive (HTTP/1.1)
+    HttpResponse& keepAlive(bool on) { if(!on) header("Connection", "close"); return *this; }
+
+    // Content-Length and body, end of message
+    HttpResponse& body(std::string_view content);
+    // large body is not copied, held by owner until it is sent
+    HttpResponse& body(std::shared_ptr<const std::string> content);
+    // no body
+    HttpResponse& end() { return body(std::string_view{}); }
+
+    // send the formatted responses by one write
+    Context::Completion send();
+
+    // formatted and not yet sent bytes
+    size_t pending() const { return _context->output.unread() - _mark; }
+
+    static std::string_view reasonOf(int code);
+
+private:
+    void append(std::string_view bytes) { _context->output.append(bytes.data(), bytes.size()); }
+
+private:
+    Context *_context;
+    // output.unread() before this builder
+    size_t _mark;
+};
+
+inline HttpResponse& HttpResponse::status(int code, std::string_view reason) {
+    // "HTTP/1.1 200 OK\r\n"
+    char line[16] = "HTTP/1.1 000 ";
+    line[9] = '0' + code / 100 % 10;
+    line[10] = '0' + code / 10 % 10;
+    line[11] = '0' + code % 10;
+    append({line, 13});
+    append(reason.empty() ? reasonOf(code) : reason);
+    append("\r\n");
+    return *this;
+}
+
+inline HttpResponse& HttpResponse::header(std::string_view name, std::string_view value) {
+    append(name);
+    append(": ");
+    append(value);
+    append("\r\n");
+    return *this;
+}
+
+inline HttpResponse& HttpResponse::header(std::string_view name, size_t value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof digits, value);
+    return header(name, {digits, size_t(result.ptr - digits)});
+}
+
+inline HttpResponse& HttpResponse::body(std::string_view content) {
+    header("Content-Length", content.size());
+    append("\r\n");
+    append(content);
+    return *this;
+}
+
+inline HttpResponse& HttpResponse::body(std::shared_ptr<const std::string> content) {
+    // small body: copy is cheaper than a send queue segment
+    constexpr size_t COPY_THRESHOLD = 4096;
+    if(content->size() < COPY_THRESHOLD) return body(std::string_view{*content});
+    header("Content-Length", content->size());
+    append("\r\n");
+    // keep the order: formatted head -> referenced body
+    send();
+    _context->send(std::move(content));
+    return *this;
+}
+
+inline Context::Completion HttpResponse::send() {
+    size_t n = pending();
+    _mark = _context->output.unread();
+    auto completion = _context->sendAppended(n);
+    // flushed bytes are consumed from output
+    _mark = _context->output.unread();
+    return completion;
+}
+
+inline std::string_view HttpResponse::reasonOf(int code) {
+    switch(code) {
+        case 100: return "Continue";
+        case 101: return "Switching Protocols";
+        case 200: return "OK";
+        case 201: return "Created";
+        case 202: return "Accepted";
+        case 204: return "No Content";
+        case 206: return "Partial Content";
+        case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 413: return "Content Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        case 505: return "HTTP Version Not Supported";
+        default:  return "Unknown";
+    }
+}
+
+} // fluent
+#endif
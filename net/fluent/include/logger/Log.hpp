@@ -658,6 +658,13 @@ inline Chrono::Time Chrono::calTime(std::chrono::system_clock::duration duration
 #include <bits/stdc++.h>
 namespace dlog {
 
+// per-thread buffer is full
+enum class OverflowPolicy {
+    BLOCK, // wait for wthread
+    DROP,  // drop and count the message
+    GROW,  // chain a larger buffer
+};
+
 struct StaticConfig {
     const char *log_dir;
     const char *log_filename;
@@ -670,11 +677,26 @@ struct StaticConfig {
     bool wtfOn;
     std::chrono::milliseconds fileRollingInterval;
     size_t msg_align;
+    // false: global double buffer
+    bool perThreadBuffer;
+    size_t threadBufferSize;
+    OverflowPolicy overflowPolicy;
+    // true: arguments are copied in binary, formatted by wthread
+    bool deferredFormat;
+    // io_uring writer if DLOG_FLAG_IO_URING is defined, otherwise blocking write
+    bool asyncWriter;
+    size_t writerDepth;
+    // fdatasync cadence, 0: never
+    std::chrono::milliseconds fileSyncInterval;
     constexpr StaticConfig(const char *log_dir, const char *log_filename, const char *log_filename_extension,
         size_t fileMaxSize,
         bool debugOn, bool infoOn, bool warnOn, bool errorOn, bool wtfOn,
         std::chrono::milliseconds fileRollingInterval,
-        size_t msg_align)
+        size_t msg_align,
+        bool perThreadBuffer, size_t threadBufferSize, OverflowPolicy overflowPolicy,
+        bool deferredFormat,
+        bool asyncWriter, size_t writerDepth,
+        std::chrono::milliseconds fileSyncInterval)
         : log_dir(log_dir),
           log_filename(log_filename),
           log_filename_extension(log_filename_extension),
@@ -685,7 +707,14 @@ struct StaticConfig {
           errorOn(errorOn),
           wtfOn(wtfOn),
           fileRollingInterval(fileRollingInterval),
-          msg_align(msg_align) {}
+          msg_align(msg_align),
+          perThreadBuffer(perThreadBuffer),
+          threadBufferSize(threadBufferSize),
+          overflowPolicy(overflowPolicy),
+          deferredFormat(deferredFormat),
+          asyncWriter(asyncWriter),
+          writerDepth(writerDepth),
+          fileSyncInterval(fileSyncInterval) {}
 };
 // constexpr const StaticConfig &staticConfig
 
@@ -706,6 +735,10 @@ struct config {
         MAX_FILE_SIZE,
         ROLLING,
         MSG_ALIGN,
+        BUFFER,
+        FORMAT,
+        WRITER,
+        SYNC,
     } _type;
 
     const char *_path {"log_default.log"};
@@ -717,6 +750,13 @@ struct config {
     size_t _logOpenFlags[5] {};
     std::chrono::milliseconds _fileRollingInterval {24h};
     size_t _msg_align {20};
+    bool _perThreadBuffer {false};
+    size_t _threadBufferSize {1<<18};
+    OverflowPolicy _overflowPolicy {OverflowPolicy::BLOCK};
+    bool _deferredFormat {false};
+    bool _asyncWriter {false};
+    size_t _writerDepth {16};
+    std::chrono::milliseconds _fileSyncInterval {0};
 
     constexpr config(enum type type)
         : _type(type) {}
@@ -746,6 +786,21 @@ struct config {
                     case type::MSG_ALIGN:
                         _msg_align = l._msg_align;
                     break;
+                    case type::BUFFER:
+                        _perThreadBuffer = l._perThreadBuffer;
+                        _threadBufferSize = l._threadBufferSize;
+                        _overflowPolicy = l._overflowPolicy;
+                    break;
+                    case type::FORMAT:
+                        _deferredFormat = l._deferredFormat;
+                    break;
+                    case type::WRITER:
+                        _asyncWriter = l._asyncWriter;
+                        _writerDepth = l._writerDepth;
+                    break;
+                    case type::SYNC:
+                        _fileSyncInterval = l._fileSyncInterval;
+                    break;
                     default:
                     break;
                 }
@@ -759,6 +814,14 @@ struct config {
         _log_filename_extension = rhs._log_filename_extension;
         _fileMaxSize = rhs._fileMaxSize;
         _fileRollingInterval = rhs._fileRollingInterval;
+        _msg_align = rhs._msg_align;
+        _perThreadBuffer = rhs._perThreadBuffer;
+        _threadBufferSize = rhs._threadBufferSize;
+        _overflowPolicy = rhs._overflowPolicy;
+        _deferredFormat = rhs._deferredFormat;
+        _asyncWriter = rhs._asyncWriter;
+        _writerDepth = rhs._writerDepth;
+        _fileSyncInterval = rhs._fileSyncInterval;
         for(size_t i = 0; i < sizeof(_logOpenFlags)/sizeof(decltype(_logOpenFlags[0])); ++i) {
             _logOpenFlags[i] = rhs._logOpenFlags[i];
         }
@@ -770,7 +833,11 @@ struct config {
             _fileMaxSize,
             _logOpenFlags[0], _logOpenFlags[1], _logOpenFlags[2], _logOpenFlags[3], _logOpenFlags[4],
             _fileRollingInterval,
-            _msg_align
+            _msg_align,
+            _perThreadBuffer, _threadBufferSize, _overflowPolicy,
+            _deferredFormat,
+            _asyncWriter, _writerDepth,
+            _fileSyncInterval
         );
     }
 };
@@ -855,6 +922,43 @@ struct file_rolling_interval: public config {
         : config(type::ROLLING) { _fileRollingInterval = fileRollingInterval; }
 };
 
+// example: file_sync_interval {1s}
+struct file_sync_interval: public config {
+    explicit constexpr file_sync_interval(std::chrono::milliseconds fileSyncInterval)
+        : config(type::SYNC) { _fileSyncInterval = fileSyncInterval; }
+};
+
+// example: async_writer {16}
+// depth: max in-flight writes of UringWriter::CHUNK_SIZE
+struct async_writer: public config {
+    explicit constexpr async_writer(size_t depth)
+        : config(type::WRITER) { _asyncWriter = true; _writerDepth = depth; }
+};
+
+constexpr OverflowPolicy BLOCK = OverflowPolicy::BLOCK;
+constexpr OverflowPolicy DROP = OverflowPolicy::DROP;
+constexpr OverflowPolicy GROW = OverflowPolicy::GROW;
+
+// example: per_thread_buffer {256KB, DROP}
+// size is rounded up to power of 2
+struct per_thread_buffer: public config {
+    explicit constexpr per_thread_buffer(size_t size, OverflowPolicy policy = BLOCK)
+        : config(type::BUFFER) {
+        _perThreadBuffer = true;
+        _threadBufferSize = 1;
+        while(_threadBufferSize < size) _threadBufferSize <<= 1;
+        _overflowPolicy = policy;
+    }
+};
+
+// example: deferred_format {}
+// the hot path only copies raw arguments, text is formatted by wthread
+struct deferred_format: public config {
+    constexpr deferred_format(): config(type::FORMAT) {
+        _deferredFormat = true;
+    }
+};
+
 constexpr static StaticConfig globalConfigBoot {
 #ifdef DLOG_CONF_PATH
 #include DLOG_CONF_PATH
@@ -1165,6 +1269,7 @@ inline void Resolver::resolveDispatch(ResolveContext &ctx, std::array<IoVector,
 #define __DLOG_FS_H__
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/uio.h>
 #include <bits/stdc++.h>
 
 namespace dlog {
@@ -1172,20 +1277,22 @@ namespace dlog {
 // a very simple file util class, used for append-write
 class File {
 public:
-    explicit File(std::string path)
+    // positional: opened without O_APPEND, written by offset from allocate()
+    explicit File(std::string path, bool positional = false)
         : _path(std::move(path)),
           _timePoint(std::chrono::system_clock::now()),
           _written(0),
-          _fd(::open(_path.c_str(), OPEN_FLAG, OPEN_MODE)) { // blocking
+          _fd(::open(_path.c_str(), positional ? POSITIONAL_FLAG : OPEN_FLAG, OPEN_MODE)), // blocking
+          _offset(positional && _fd != INVALID_FD ? ::lseek(_fd, 0, SEEK_END) : 0) {
         // if(fd < 0) throw
     }
     // unsafe
-    explicit File(int fd): _fd(fd) {}
+    explicit File(int fd): _written(0), _fd(fd), _offset(0) {}
     ~File() { if(_fd != INVALID_FD) ::close(_fd); } // throw...
 
     // support rvalue
 
-    File(File &&rhs): _fd(rhs._fd) { rhs._fd = INVALID_FD; }
+    File(File &&rhs): _written(0), _fd(INVALID_FD), _offset(0) { swap(rhs); }
     File& operator=(File &&that) {
         File(static_cast<File&&>(that)).swap(*this);
         return *this;
@@ -1194,23 +1301,34 @@ public:
     // basic operations
 
     int fd() { return _fd; }
+    const std::string& path() const { return _path; }
     void detach() { _fd = INVALID_FD; }
     void swap(File &that);
-    void append(const char *buf, size_t count);
+    // return: false if failed, errno is set and the rest is dropped
+    bool append(const char *buf, size_t count);
+    // iov may be modified if partially written
+    bool appendv(iovec *iov, size_t count);
+    // positional write, reserve count bytes
+    // return: offset
+    size_t allocate(size_t count);
 
     // feature
 
     bool updatable(size_t count);
     void update(std::string newPath);
+    // the file is renamed to path by others, restart rolling
+    void restart(std::string path);
 
 private:
     constexpr static int INVALID_FD = -1;
     constexpr static int OPEN_FLAG = O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC;
+    constexpr static int POSITIONAL_FLAG = O_WRONLY | O_CREAT | O_CLOEXEC;
     constexpr static int OPEN_MODE = 0644;
     std::string _path;
     std::chrono::system_clock::time_point _timePoint;
     size_t _written;
     int _fd;
+    size_t _offset;
 };
 
 /// impl
@@ -1220,17 +1338,38 @@ inline void File::swap(File &that) {
     std::swap(this->_timePoint, that._timePoint);
     std::swap(this->_written, that._written);
     std::swap(this->_fd, that._fd);
+    std::swap(this->_offset, that._offset);
 }
 
-inline void File::append(const char *buf, size_t count) {
-    size_t written = 0;
-    while(written != count) {
-        size_t remain = count - written;
-        size_t n = ::write(_fd, buf + written, remain);
-        if(n < 0) ; // throw...
-        written += n;
+inline bool File::append(const char *buf, size_t count) {
+    iovec iov {const_cast<char*>(buf), count};
+    return appendv(&iov, 1);
+}
+
+inline bool File::appendv(iovec *iov, size_t count) {
+    while(count) {
+        ssize_t n = ::writev(_fd, iov, std::min<size_t>(count, IOV_MAX));
+        if(n < 0) {
+            if(errno == EINTR) continue;
+            return false;
+        }
+        _written += n;
+        for(; count && size_t(n) >= iov->iov_len; ++iov, --count) {
+            n -= iov->iov_len;
+        }
+        if(n) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+            iov->iov_len -= n;
+        }
     }
-    _written += written;
+    return true;
+}
+
+inline size_t File::allocate(size_t count) {
+    size_t offset = _offset;
+    _offset += count;
+    _written += count;
+    return offset;
 }
 
 inline bool File::updatable(size_t count) {
@@ -1249,11 +1388,381 @@ inline void File::update(std::string newPath) {
     roll.swap(*this);
 }
 
+inline void File::restart(std::string path) {
+    _path = std::move(path);
+    _timePoint = std::chrono::system_clock::now();
+    _written = 0;
+}
+
+} // dlog
+#endif
+
+#ifndef __DLOG_WRITER_H__
+#define __DLOG_WRITER_H__
+#include <unistd.h>
+#include <sys/uio.h>
+#include <bits/stdc++.h>
+#ifdef DLOG_FLAG_IO_URING
+#include <liburing.h>
+#endif
+
+namespace dlog {
+
+// writer backend observability, updated by wthread only
+struct WriterStats {
+    constexpr static size_t BUCKETS = 24;
+
+    std::atomic<uint64_t> writes {0};
+    std::atomic<uint64_t> bytes {0};
+    std::atomic<uint64_t> errors {0};
+    std::atomic<uint64_t> syncs {0};
+    // in-flight async requests
+    std::atomic<size_t> queueDepth {0};
+    // write latency, latency[i]: [2^i, 2^(i+1)) us, latency[0] includes < 1us
+    std::atomic<uint64_t> latency[BUCKETS] {};
+
+    void record(std::chrono::steady_clock::duration elapsed, size_t n);
+};
+
+inline void WriterStats::record(std::chrono::steady_clock::duration elapsed, size_t n) {
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    size_t bucket = us ? std::min<size_t>(63 - __builtin_clzll(us), BUCKETS - 1) : 0;
+    latency[bucket].fetch_add(1, std::memory_order_relaxed);
+    writes.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(n, std::memory_order_relaxed);
+}
+
+#ifdef DLOG_FLAG_IO_URING
+
+// asynchronous writer backend, staticConfig.asyncWriter
+// bytes are copied to (registered) chunks and written by offset,
+// so wthread is blocked only if all chunks are in flight
+class UringWriter {
+public:
+    constexpr static size_t CHUNK_SIZE = 1<<18;
+    // O_DIRECT-friendly chunk address
+    constexpr static size_t ALIGNMENT = 4096;
+
+    // return: nullptr if io_uring is not available
+    static std::unique_ptr<UringWriter> make(size_t depth, WriterStats &stats);
+    ~UringWriter();
+    UringWriter(const UringWriter&) = delete;
+    UringWriter& operator=(const UringWriter&) = delete;
+
+    // file: opened as positional
+    // sync: fdatasync after the writes
+    void write(File &file, const iovec *iov, size_t count, bool sync);
+    // wait for all in-flight requests
+    void drain();
+
+private:
+    struct Chunk {
+        char *data;
+        size_t len;
+        int index;
+        int fd;
+        size_t offset;
+        // written bytes of a submitted chunk
+        size_t done;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    UringWriter(size_t depth, WriterStats &stats);
+    Chunk* acquire();
+    void submit(File &file, Chunk *chunk);
+    // write the rest of chunk
+    void prepare(Chunk *chunk);
+    void release(Chunk *chunk);
+    io_uring_sqe* sqe();
+    void complete(io_uring_cqe *cqe);
+    // wait: block for at least one completion
+    void reap(bool wait);
+    void updateDepth() { _stats.queueDepth.store(_inflight, std::memory_order_relaxed); }
+
+    io_uring _ring;
+    bool _initialized;
+    bool _registered;
+    WriterStats &_stats;
+    std::unique_ptr<char, decltype(&::free)> _storage;
+    std::vector<Chunk> _chunks;
+    std::vector<Chunk*> _free;
+    size_t _inflight;
+};
+
+/// impl
+
+inline std::unique_ptr<UringWriter> UringWriter::make(size_t depth, WriterStats &stats) {
+    std::unique_ptr<UringWriter> writer {new UringWriter(std::max<size_t>(depth, 1), stats)};
+    if(!writer->_initialized || !writer->_storage) return nullptr;
+    return writer;
+}
+
+inline UringWriter::UringWriter(size_t depth, WriterStats &stats)
+    : _initialized(false),
+      _registered(false),
+      _stats(stats),
+      _storage(static_cast<char*>(::aligned_alloc(ALIGNMENT, depth * CHUNK_SIZE)), &::free),
+      _chunks(depth),
+      _inflight(0) {
+    // a sqe for each chunk, and fdatasync
+    if(::io_uring_queue_init(2 * depth, &_ring, 0) < 0 || !_storage) return;
+    _initialized = true;
+    std::vector<iovec> buffers(depth);
+    for(size_t i = 0; i < depth; ++i) {
+        auto &chunk = _chunks[i];
+        chunk.data = _storage.get() + i * CHUNK_SIZE;
+        chunk.len = 0;
+        chunk.index = i;
+        buffers[i] = {chunk.data, CHUNK_SIZE};
+        _free.emplace_back(&chunk);
+    }
+    // may fail by RLIMIT_MEMLOCK, then unregistered writes are used
+    _registered = ::io_uring_register_buffers(&_ring, buffers.data(), depth) == 0;
+}
+
+inline UringWriter::~UringWriter() {
+    if(!_initialized) return;
+    drain();
+    ::io_uring_queue_exit(&_ring);
+}
+
+inline void UringWriter::write(File &file, const iovec *iov, size_t count, bool sync) {
+    reap(false);
+    Chunk *chunk = nullptr;
+    for(size_t i = 0; i < count; ++i) {
+        auto data = static_cast<const char*>(iov[i].iov_base);
+        size_t remain = iov[i].iov_len;
+        while(remain) {
+            if(!chunk) chunk = acquire();
+            size_t n = std::min(remain, CHUNK_SIZE - chunk->len);
+            std::memcpy(chunk->data + chunk->len, data, n);
+            chunk->len += n;
+            data += n;
+            remain -= n;
+            if(chunk->len == CHUNK_SIZE) {
+                submit(file, chunk);
+                chunk = nullptr;
+            }
+        }
+    }
+    if(chunk) submit(file, chunk);
+    if(sync) {
+        auto request = sqe();
+        ::io_uring_prep_fsync(request, file.fd(), IORING_FSYNC_DATASYNC);
+        // positional writes are not ordered by links,
+        // drain: start after all previous requests (including other submits) are completed
+        request->flags |= IOSQE_IO_DRAIN;
+        ::io_uring_sqe_set_data(request, nullptr);
+        _inflight++;
+        updateDepth();
+    }
+    ::io_uring_submit(&_ring);
+}
+
+inline void UringWriter::drain() {
+    while(_inflight) reap(true);
+}
+
+inline UringWriter::Chunk* UringWriter::acquire() {
+    while(_free.empty()) reap(true);
+    Chunk *chunk = _free.back();
+    _free.pop_back();
+    return chunk;
+}
+
+inline void UringWriter::submit(File &file, Chunk *chunk) {
+    chunk->fd = file.fd();
+    chunk->offset = file.allocate(chunk->len);
+    chunk->done = 0;
+    chunk->start = std::chrono::steady_clock::now();
+    _inflight++;
+    updateDepth();
+    prepare(chunk);
+}
+
+inline void UringWriter::prepare(Chunk *chunk) {
+    auto request = sqe();
+    const char *data = chunk->data + chunk->done;
+    size_t len = chunk->len - chunk->done;
+    size_t offset = chunk->offset + chunk->done;
+    if(_registered) {
+        ::io_uring_prep_write_fixed(request, chunk->fd, data, len, offset, chunk->index);
+    } else {
+        ::io_uring_prep_write(request, chunk->fd, data, len, offset);
+    }
+    ::io_uring_sqe_set_data(request, chunk);
+}
+
+inline void UringWriter::release(Chunk *chunk) {
+    chunk->len = 0;
+    _free.emplace_back(chunk);
+    _inflight--;
+    updateDepth();
+}
+
+inline io_uring_sqe* UringWriter::sqe() {
+    io_uring_sqe *request;
+    while(!(request = ::io_uring_get_sqe(&_ring))) {
+        ::io_uring_submit(&_ring);
+    }
+    return request;
+}
+
+inline void UringWriter::complete(io_uring_cqe *cqe) {
+    auto chunk = static_cast<Chunk*>(::io_uring_cqe_get_data(cqe));
+    int result = cqe->res;
+    if(!chunk) {
+        // fdatasync
+        if(result < 0) _stats.errors.fetch_add(1, std::memory_order_relaxed);
+        else _stats.syncs.fetch_add(1, std::memory_order_relaxed);
+        _inflight--;
+        updateDepth();
+        return;
+    }
+    if(result == -EINTR || result == -EAGAIN) {
+        prepare(chunk);
+        return;
+    }
+    if(result > 0) {
+        chunk->done += result;
+        // short write
+        if(chunk->done < chunk->len) {
+            prepare(chunk);
+            return;
+        }
+        _stats.record(std::chrono::steady_clock::now() - chunk->start, chunk->len);
+    } else {
+        // the rest is dropped
+        _stats.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    release(chunk);
+}
+
+inline void UringWriter::reap(bool wait) {
+    io_uring_cqe *cqe;
+    if(wait) ::io_uring_submit_and_wait(&_ring, 1);
+    unsigned head;
+    unsigned count = 0;
+    io_uring_for_each_cqe(&_ring, head, cqe) {
+        complete(cqe);
+        count++;
+    }
+    ::io_uring_cq_advance(&_ring, count);
+    // retried writes
+    if(count) ::io_uring_submit(&_ring);
+}
+
+#endif
+
+} // dlog
+#endif
+
+#ifndef __DLOG_TBUF_H__
+#define __DLOG_TBUF_H__
+#include <sys/uio.h>
+#include <bits/stdc++.h>
+
+namespace dlog {
+
+// per-thread SPSC buffer, used if staticConfig.perThreadBuffer
+// producer: the logging thread, consumer: wthread
+class ThreadBuffer {
+public:
+    explicit ThreadBuffer(size_t capacity);
+    ~ThreadBuffer();
+    ThreadBuffer(const ThreadBuffer&) = delete;
+    ThreadBuffer& operator=(const ThreadBuffer&) = delete;
+
+    // producer
+
+    // put(char *buf) writes n bytes to buf
+    // return: false if dropped
+    template <typename Put>
+    bool write(size_t n, Put &&put);
+    bool write(ResolveContext &args) {
+        return write(Resolver::calspace(args), [&args](char *buf) { Resolver::put(args, buf); });
+    }
+    // the thread is exited, no more write
+    void retire() { _retired.store(true, std::memory_order_release); }
+
+    // consumer
+
+    // append readable bytes to iov (at most 2 iovecs)
+    // return: readable bytes
+    size_t peek(std::vector<iovec> &iov);
+    void consume(size_t n);
+    // retired and drained, can be removed
+    bool finished();
+
+private:
+    // byte ring, head and tail increase monotonically
+    struct Ring {
+        explicit Ring(size_t capacity): data(new char[capacity]), capacity(capacity) {}
+        std::unique_ptr<char[]> data;
+        const size_t capacity; // power of 2
+        alignas(64) std::atomic<size_t> head {0};
+        alignas(64) std::atomic<size_t> tail {0};
+        // GROW: a larger ring written after this one
+        std::atomic<Ring*> next {nullptr};
+    };
+
+    // ensure _producer has n bytes free, by overflow policy
+    bool reserve(size_t n);
+
+    Ring *_producer;
+    Ring *_consumer;
+    std::atomic<bool> _retired {false};
+};
+
+} // dlog
+#endif
+#ifndef __DLOG_TID_H__
+#define __DLOG_TID_H__
+#include <unistd.h>
+#include <bits/stdc++.h>
+
+namespace dlog {
+
+class Tid {
+public:
+    static const Tid& get() {
+        static const thread_local Tid instance;
+        return instance;
+    }
+
+    static IoVector format() {
+        auto &instance = get();
+        return { .base = instance.buf, .len = instance.len };
+    }
+
+    pid_t getTid() const { return tid; }
+
+    // lazily registered to wthread
+    ThreadBuffer& buffer() const;
+
+    ~Tid() { if(_buffer) _buffer->retire(); }
+
+private:
+    Tid(): tid(::gettid()), len(Stream::parseLength(tid)) {
+        Stream::parse(buf, tid, len);
+    }
+
+    pid_t tid;
+    size_t len;
+    char buf[33]{};
+    // shared with wthread, which may write the remaining bytes after thread exits
+    mutable std::shared_ptr<ThreadBuffer> _buffer;
+};
+
 } // dlog
 #endif
 
 namespace dlog {
 
+// staticConfig.deferredFormat, a record is [Decoder][encoded arguments]
+// decoder appends the formatted line to text, returns the end of record
+using Decoder = const char* (*)(const char *record, std::string &text);
+
 // shared for writer thread (backend) and scheduler (frontend)
 // use singleton instead of global variables as a inline field
 struct Shared {
@@ -1272,6 +1781,17 @@ struct Shared {
     std::condition_variable cond;
     bool sflag = true; // swap finished
 
+    // per-thread buffers
+
+    std::vector<std::shared_ptr<ThreadBuffer>> tbufs; // guarded by smtx
+    std::atomic<bool> tflag {false}; // a thread buffer is half full
+    std::atomic<bool> closed {false}; // wthread is exited
+    std::atomic<uint64_t> dropped {0};
+
+    // writer
+
+    WriterStats stats;
+
     static Shared& singleton() {
         static Shared instance;
         return instance;
@@ -1285,19 +1805,50 @@ public:
     ~Wthread();
     void kill() { kflag.store(true); }
 private:
+    // constructed before wthread, so destroyed after the writer thread is joined
+    Shared &shared;
     File file;
     std::atomic<bool> kflag;
+    // the next file, opened ahead by a background task
+    std::future<File> roller;
+    std::chrono::steady_clock::time_point lastSync;
+#ifdef DLOG_FLAG_IO_URING
+    std::unique_ptr<UringWriter> uring;
+#endif
     std::thread writer;
     void writeFunc();
+    // write to file, roll and sync if needed
+    void write(iovec *iov, size_t count, size_t total);
+    // switch to the pre-opened file without blocking on open / close
+    void roll();
+    // staticConfig.perThreadBuffer
+    void writeThreadBuffers();
+    // staticConfig.deferredFormat
+    // records in [data, data + n) -> text
+    static void decode(const char *data, size_t n, std::string &text);
     static std::string generateFileName();
+    // the pre-opened file, renamed to generateFileName() when rolling
+    static std::string temporaryFileName();
+    // opened for UringWriter
+    static bool positional();
 }; // wthread;
 
 // interact with wthread
 struct Scheduler {
     static void apply(ResolveContext &args) {
+        apply(Resolver::calspace(args), [&args](char *buf) { Resolver::put(args, buf); });
+    }
+
+    // put(char *buf) writes n bytes to buf
+    template <typename Put>
+    static void apply(size_t n, Put &&put) {
+        if(staticConfig.perThreadBuffer) {
+            Tid::get().buffer().write(n, std::forward<Put>(put));
+            return;
+        }
         auto &s = Shared::singleton();
         std::lock_guard<std::mutex> lk{s.rmtx};
-        if(s.rcur + Resolver::calspace(args) >= sizeof(s.buf[0])) {
+        if(s.rcur + n >= sizeof(s.buf[0])) {
             {
                 std::unique_lock<std::mutex> _{s.smtx};
                 s.sflag = false;
@@ -1305,16 +1856,22 @@ struct Scheduler {
             while(!s.sflag) s.cond.notify_one();
         }
         auto rbuf = s.buf[s.ridx];
-        Resolver::put(args, rbuf + s.rcur);
-        s.rcur += Resolver::calspace(args);
+        put(rbuf + s.rcur);
+        s.rcur += n;
     }
 };
 
 /// impl
 
 inline Wthread::Wthread()
-    : file(generateFileName()),
+    : shared(Shared::singleton()),
+      file(generateFileName(), positional()),
       kflag(false),
+      roller(std::async(std::launch::async, [] { return File(temporaryFileName(), positional()); })),
+      lastSync(std::chrono::steady_clock::now()),
+#ifdef DLOG_FLAG_IO_URING
+      uring(positional() ? UringWriter::make(staticConfig.writerDepth, shared.stats) : nullptr),
+#endif
       writer {[this] { writeFunc(); }} {}
 
 inline Wthread::~Wthread() {
@@ -1322,12 +1879,64 @@ inline Wthread::~Wthread() {
     if(writer.joinable()) {
         writer.join();
     }
+    // the pre-opened file is not used
+    if(roller.valid()) {
+        File next = roller.get();
+        ::unlink(next.path().c_str());
+    }
+}
+
+inline void Wthread::write(iovec *iov, size_t count, size_t total) {
+    auto &stats = shared.stats;
+    if(file.updatable(total)) {
+        roll();
+    }
+    auto start = std::chrono::steady_clock::now();
+    bool sync = staticConfig.fileSyncInterval.count() && start - lastSync >= staticConfig.fileSyncInterval;
+    if(sync) lastSync = start;
+#ifdef DLOG_FLAG_IO_URING
+    if(uring) {
+        uring->write(file, iov, count, sync);
+        return;
+    }
+#endif
+    if(!file.appendv(iov, count)) {
+        stats.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    stats.record(std::chrono::steady_clock::now() - start, total);
+    if(sync) {
+        if(::fdatasync(file.fd())) stats.errors.fetch_add(1, std::memory_order_relaxed);
+        else stats.syncs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+inline void Wthread::roll() {
+    File next = roller.valid() ? roller.get() : File(temporaryFileName(), positional());
+    std::string temporary = next.path();
+    std::string path = generateFileName();
+    next.restart(path);
+    file.swap(next);
+#ifdef DLOG_FLAG_IO_URING
+    // in-flight and retried writes use the fd of the previous file,
+    // which may be reused by the next file once it is closed
+    if(uring) uring->drain();
+#endif
+    roller = std::async(std::launch::async, [previous = std::move(next), temporary, path]() mutable {
+        ::rename(temporary.c_str(), path.c_str());
+        { File closed {std::move(previous)}; }
+        return File(temporary, positional());
+    });
 }
 
 inline void Wthread::writeFunc() {
     using namespace std::literals::chrono_literals;
+    if(staticConfig.perThreadBuffer) {
+        writeThreadBuffers();
+        return;
+    }
     int cur, idx;
-    auto &s = Shared::singleton();
+    auto &s = shared;
+    std::string text;
     auto swap = [&] {
         s.ridx ^= 1;
         s.widx ^= 1;
@@ -1352,11 +1961,217 @@ inline void Wthread::writeFunc() {
                 continue;
             }
         }
-        if(file.updatable(cur)) {
-            file.update(generateFileName());
+        iovec iov {s.buf[idx], size_t(cur)};
+        if(staticConfig.deferredFormat) {
+            text.clear();
+            decode(s.buf[idx], cur, text);
+            iov = {text.data(), text.size()};
         }
-        file.append(s.buf[idx], cur);
+        if(iov.iov_len) write(&iov, 1, iov.iov_len);
+    }
+}
+
+inline void Wthread::writeThreadBuffers() {
+    using namespace std::literals::chrono_literals;
+    auto &s = shared;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::vector<iovec> iov;
+    std::vector<size_t> sizes;
+    std::string text, wrapped;
+    for(bool last = false; !last;) {
+        last = kflag.load();
+        {
+            std::unique_lock<std::mutex> lk{s.smtx};
+            if(!last) s.cond.wait_for(lk, 10ms, [&] { return s.tflag.load(std::memory_order_relaxed); });
+            s.tflag.store(false, std::memory_order_relaxed);
+            s.tbufs.erase(std::remove_if(s.tbufs.begin(), s.tbufs.end(),
+                [](auto &buffer) { return buffer->finished(); }), s.tbufs.end());
+            buffers = s.tbufs;
+        }
+        // one batch per wakeup, drain all before exit
+        do {
+            iov.clear();
+            sizes.clear();
+            size_t total = 0;
+            for(auto &buffer : buffers) {
+                sizes.emplace_back(buffer->peek(iov));
+                total += sizes.back();
+            }
+            if(!total) break;
+            if(staticConfig.deferredFormat) {
+                text.clear();
+                auto part = iov.begin();
+                for(size_t size : sizes) {
+                    if(!size) continue;
+                    auto data = static_cast<const char*>(part->iov_base);
+                    if(part->iov_len == size) {
+                        decode(data, size, text);
+                        ++part;
+                        continue;
+                    }
+                    // a record may cross the end of ring
+                    wrapped.assign(data, part->iov_len);
+                    ++part;
+                    wrapped.append(static_cast<const char*>(part->iov_base), part->iov_len);
+                    ++part;
+                    decode(wrapped.data(), wrapped.size(), text);
+                }
+                iov.assign(1, {text.data(), text.size()});
+                total = text.size();
+            }
+            write(iov.data(), iov.size(), total);
+            for(size_t i = 0; i < buffers.size(); ++i) {
+                buffers[i]->consume(sizes[i]);
+            }
+        } while(last);
+    }
+    s.closed.store(true);
+}
+
+inline void Wthread::decode(const char *data, size_t n, std::string &text) {
+    for(const char *end = data + n; data < end;) {
+        Decoder decoder;
+        std::memcpy(&decoder, data, sizeof decoder);
+        data = decoder(data + sizeof decoder, text);
+    }
+}
+
+inline ThreadBuffer::ThreadBuffer(size_t capacity)
+    : _producer(new Ring(capacity)),
+      _consumer(_producer) {}
+
+inline ThreadBuffer::~ThreadBuffer() {
+    for(Ring *ring = _consumer; ring;) {
+        delete std::exchange(ring, ring->next.load(std::memory_order_acquire));
+    }
+}
+
+template <typename Put>
+inline bool ThreadBuffer::write(size_t n, Put &&put) {
+    auto &s = Shared::singleton();
+    Ring *ring = _producer;
+    size_t tail = ring->tail.load(std::memory_order_relaxed);
+    if(ring->capacity - (tail - ring->head.load(std::memory_order_acquire)) < n) {
+        if(!reserve(n)) {
+            s.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        ring = _producer;
+        tail = ring->tail.load(std::memory_order_relaxed);
+    }
+    size_t mask = ring->capacity - 1;
+    char *base = ring->data.get();
+    size_t offset = tail & mask;
+    if(offset + n <= ring->capacity) {
+        put(base + offset);
+    } else {
+        // wrapped
+        char tmp[n];
+        put(tmp);
+        size_t first = ring->capacity - offset;
+        std::memcpy(base + offset, tmp, first);
+        std::memcpy(base, tmp + first, n - first);
+    }
+    ring->tail.store(tail + n, std::memory_order_release);
+    // wake up wthread early if half full
+    if(tail + n - ring->head.load(std::memory_order_relaxed) >= ring->capacity / 2
+            && !s.tflag.load(std::memory_order_relaxed)
+            && !s.tflag.exchange(true)) {
+        s.cond.notify_one();
+    }
+    return true;
+}
+
+inline bool ThreadBuffer::reserve(size_t n) {
+    auto &s = Shared::singleton();
+    Ring *ring = _producer;
+    auto available = [ring] {
+        return ring->capacity - (ring->tail.load(std::memory_order_relaxed)
+            - ring->head.load(std::memory_order_acquire));
+    };
+    switch(staticConfig.overflowPolicy) {
+        case OverflowPolicy::BLOCK:
+            if(n > ring->capacity) return false;
+            while(available() < n) {
+                if(s.closed.load()) return false;
+                if(!s.tflag.exchange(true)) s.cond.notify_one();
+                std::this_thread::yield();
+            }
+            return true;
+        case OverflowPolicy::DROP:
+            return false;
+        case OverflowPolicy::GROW: {
+            size_t capacity = ring->capacity << 1;
+            while(capacity < n) capacity <<= 1;
+            _producer = new Ring(capacity);
+            // published after the last write to ring
+            ring->next.store(_producer, std::memory_order_release);
+            return true;
+        }
+    }
+    return false;
+}
+
+inline size_t ThreadBuffer::peek(std::vector<iovec> &iov) {
+    Ring *ring = _consumer;
+    size_t head = ring->head.load(std::memory_order_relaxed);
+    size_t tail = ring->tail.load(std::memory_order_acquire);
+    while(head == tail) {
+        Ring *next = ring->next.load(std::memory_order_acquire);
+        if(!next) return 0;
+        // the producer may write before it grows
+        tail = ring->tail.load(std::memory_order_acquire);
+        if(head != tail) break;
+        delete std::exchange(_consumer, next);
+        ring = next;
+        head = ring->head.load(std::memory_order_relaxed);
+        tail = ring->tail.load(std::memory_order_acquire);
+    }
+    size_t mask = ring->capacity - 1;
+    char *base = ring->data.get();
+    size_t offset = head & mask;
+    size_t readable = tail - head;
+    size_t first = std::min(readable, ring->capacity - offset);
+    iov.push_back({base + offset, first});
+    if(first != readable) iov.push_back({base, readable - first});
+    return readable;
+}
+
+inline void ThreadBuffer::consume(size_t n) {
+    if(!n) return;
+    auto &head = _consumer->head;
+    head.store(head.load(std::memory_order_relaxed) + n, std::memory_order_release);
+}
+
+inline bool ThreadBuffer::finished() {
+    if(!_retired.load(std::memory_order_acquire)) return false;
+    std::vector<iovec> iov;
+    return peek(iov) == 0;
+}
+
+inline ThreadBuffer& Tid::buffer() const {
+    if(!_buffer) {
+        _buffer = std::make_shared<ThreadBuffer>(staticConfig.threadBufferSize);
+        auto &s = Shared::singleton();
+        std::lock_guard<std::mutex> _{s.smtx};
+        s.tbufs.emplace_back(_buffer);
     }
+    return *_buffer;
+}
+
+inline std::string Wthread::temporaryFileName() {
+    return std::string(staticConfig.log_dir) + "/."
+          + staticConfig.log_filename
+          + '.' + std::to_string(::getpid())
+          + ".next";
+}
+
+inline bool Wthread::positional() {
+#ifdef DLOG_FLAG_IO_URING
+    return staticConfig.asyncWriter;
+#else
+    return false;
+#endif
 }
 
 inline std::string Wthread::generateFileName() {
@@ -1401,40 +2216,6 @@ static constexpr char levelFormat() noexcept {
 #define __DLOG_TAGS_H__
 #include <bits/stdc++.h>
 
-#ifndef __DLOG_TID_H__
-#define __DLOG_TID_H__
-#include <unistd.h>
-#include <bits/stdc++.h>
-
-namespace dlog {
-
-class Tid {
-public:
-    static const Tid& get() {
-        static const thread_local Tid instance;
-        return instance;
-    }
-
-    static IoVector format() {
-        auto &instance = get();
-        return { .base = instance.buf, .len = instance.len };
-    }
-
-    pid_t getTid() const { return tid; }
-
-private:
-    Tid(): tid(::gettid()), len(Stream::parseLength(tid)) {
-        Stream::parse(buf, tid, len);
-    }
-
-    pid_t tid;
-    size_t len;
-    char buf[33]{};
-};
-
-} // dlog
-#endif
-
 namespace dlog {
 
 struct DateTimeTag {
@@ -1474,6 +2255,136 @@ struct Elem<ThreadIdTag>: Key<ThreadIdTag>, Value<3> {};
 } // dlog
 #endif
 
+#ifndef __DLOG_CODEC_H__
+#define __DLOG_CODEC_H__
+#include <bits/stdc++.h>
+
+namespace dlog {
+
+// staticConfig.deferredFormat
+// encode: copy raw bytes on the caller thread
+// decode: on wthread, return a value resolved to the same text as the argument
+template <typename T, typename = void>
+struct Codec {
+    // fallback: formatted on the caller thread, e.g. strings
+    static size_t size(const T &msg) { return sizeof(size_t) + Stream::parseLength(msg); }
+    static void encode(char *&buf, const T &msg);
+    static IoVector decode(const char *&buf);
+};
+
+template <typename T>
+struct Codec<T, std::enable_if_t<std::is_arithmetic<T>::value>> {
+    static constexpr size_t size(T) { return sizeof(T); }
+    static void encode(char *&buf, T msg) { std::memcpy(buf, &msg, sizeof(T)); buf += sizeof(T); }
+    static T decode(const char *&buf) { T msg; std::memcpy(&msg, buf, sizeof(T)); buf += sizeof(T); return msg; }
+};
+
+// string literal, without '\0'
+template <size_t N>
+struct Codec<char[N]> {
+    static constexpr size_t size(const char (&)[N]) { return N-1; }
+    static void encode(char *&buf, const char (&msg)[N]) { std::memcpy(buf, msg, N-1); buf += N-1; }
+    static IoVector decode(const char *&buf) { IoVector msg {buf, N-1}; buf += N-1; return msg; }
+};
+
+template <>
+struct Codec<IoVector> {
+    static size_t size(IoVector iov) { return sizeof(size_t) + iov.len; }
+    static void encode(char *&buf, IoVector iov);
+    static IoVector decode(const char *&buf);
+};
+
+template <size_t N>
+struct Codec<std::array<IoVector, N>> {
+    static size_t size(const std::array<IoVector, N> &ioves);
+    static void encode(char *&buf, const std::array<IoVector, N> &ioves);
+    static std::array<IoVector, N> decode(const char *&buf);
+};
+
+// tags
+
+template <>
+struct Codec<DateTimeTag> {
+    using Rep = std::chrono::system_clock::rep;
+    static constexpr size_t size(DateTimeTag) { return sizeof(Rep); }
+    static void encode(char *&buf, DateTimeTag) {
+        Codec<Rep>::encode(buf, Chrono::now().time_since_epoch().count());
+    }
+    static std::array<IoVector, 2> decode(const char *&buf) {
+        using namespace std::chrono;
+        return Chrono::format(system_clock::time_point{system_clock::duration{Codec<Rep>::decode(buf)}});
+    }
+};
+
+template <>
+struct Codec<ThreadIdTag> {
+    static constexpr size_t size(ThreadIdTag) { return sizeof(pid_t); }
+    static void encode(char *&buf, ThreadIdTag) { Codec<pid_t>::encode(buf, Tid::get().getTid()); }
+    static pid_t decode(const char *&buf) { return Codec<pid_t>::decode(buf); }
+};
+
+// level is known by the descriptor
+template <LogLevel LEVEL>
+struct Codec<LogLevelTag<LEVEL>> {
+    static constexpr size_t size(LogLevelTag<LEVEL>) { return 0; }
+    static void encode(char *&, LogLevelTag<LEVEL>) {}
+    static char decode(const char *&) { return LogLevelTag<LEVEL>::format(); }
+};
+
+/// impl
+
+template <typename T, typename V>
+inline void Codec<T, V>::encode(char *&buf, const T &msg) {
+    size_t len = Stream::parseLength(msg);
+    std::memcpy(buf, &len, sizeof len);
+    buf += sizeof len;
+    Stream::parse(buf, msg, len);
+    buf += len;
+}
+
+template <typename T, typename V>
+inline IoVector Codec<T, V>::decode(const char *&buf) {
+    return Codec<IoVector>::decode(buf);
+}
+
+inline void Codec<IoVector>::encode(char *&buf, IoVector iov) {
+    std::memcpy(buf, &iov.len, sizeof iov.len);
+    buf += sizeof iov.len;
+    std::memcpy(buf, iov.base, iov.len);
+    buf += iov.len;
+}
+
+inline IoVector Codec<IoVector>::decode(const char *&buf) {
+    IoVector iov;
+    std::memcpy(&iov.len, buf, sizeof iov.len);
+    buf += sizeof iov.len;
+    iov.base = buf;
+    buf += iov.len;
+    return iov;
+}
+
+template <size_t N>
+inline size_t Codec<std::array<IoVector, N>>::size(const std::array<IoVector, N> &ioves) {
+    size_t total = 0;
+    for(auto &iov : ioves) total += Codec<IoVector>::size(iov);
+    return total;
+}
+
+template <size_t N>
+inline void Codec<std::array<IoVector, N>>::encode(char *&buf, const std::array<IoVector, N> &ioves) {
+    for(auto &iov : ioves) Codec<IoVector>::encode(buf, iov);
+}
+
+template <size_t N>
+inline std::array<IoVector, N> Codec<std::array<IoVector, N>>::decode(const char *&buf) {
+    std::array<IoVector, N> ioves;
+    for(auto &iov : ioves) iov = Codec<IoVector>::decode(buf);
+    return ioves;
+}
+
+} // dlog
+#endif
+
 #ifndef __DLOG_MACRO_H__
 #define __DLOG_MACRO_H__
 
@@ -1547,6 +2458,10 @@ public:
     static void init() { worker(); }
     static void done() { worker().kill(); }
     static Wthread& worker();
+    // messages dropped by per-thread buffer overflow
+    static uint64_t dropped() { return Shared::singleton().dropped.load(std::memory_order_relaxed); }
+    // writer backend queue depth and latency
+    static const WriterStats& writerStats() { return Shared::singleton().stats; }
 
     template <typename ...Ts>
     static void debug(Ts &&...msg);
@@ -1581,6 +2496,21 @@ struct LogBaseFacade<std::tuple<Tags...>> {
 struct LogBaseImpl {
     template <typename ...Ts>
     static void log(Ts &&...msg);
+
+    // staticConfig.deferredFormat, formatted later by Deferred<...>::decode
+    template <typename ...Ts>
+    static void defer(Ts &&...msg);
+
+    // append the formatted line to text
+    template <typename ...Ts>
+    static void format(std::string &text, Ts &&...msg);
+};
+
+// static format descriptor of a log call site, by its tags and argument types
+template <typename ...Ts>
+struct Deferred {
+    static const char* decode(const char *record, std::string &text);
+    constexpr static Decoder decoder = &decode;
 };
 
 /// impl
@@ -1650,7 +2580,11 @@ inline void LogBase<Tags...>::logFormat(Ts &&...msg) {
 template <typename ...Tags>
 template <typename ...Ts>
 inline void LogBaseFacade<std::tuple<Tags...>>::log(Ts &&...msg) {
-    LogBaseImpl::log(Tags::format()..., std::forward<Ts>(msg)...);
+    if(staticConfig.deferredFormat) {
+        LogBaseImpl::defer(Tags{}..., std::forward<Ts>(msg)...);
+    } else {
+        LogBaseImpl::log(Tags::format()..., std::forward<Ts>(msg)...);
+    }
 }
 
 template <typename ...Ts>
@@ -1669,6 +2603,46 @@ inline void LogBaseImpl::log(Ts &&...msg) {
     Scheduler::apply(args);
 }
 
+template <typename T>
+using CodecOf = Codec<std::remove_cv_t<std::remove_reference_t<T>>>;
+
+template <typename ...Ts>
+inline void LogBaseImpl::defer(Ts &&...msg) {
+    constexpr Decoder decoder = Deferred<std::remove_cv_t<std::remove_reference_t<Ts>>...>::decoder;
+    size_t n = sizeof(Decoder);
+    (void)std::initializer_list<int>{(n += CodecOf<Ts>::size(msg), 0)...};
+    Scheduler::apply(n, [&](char *buf) {
+        std::memcpy(buf, &decoder, sizeof(Decoder));
+        buf += sizeof(Decoder);
+        (void)std::initializer_list<int>{(CodecOf<Ts>::encode(buf, msg), 0)...};
+    });
+}
+
+template <typename ...Ts>
+inline void LogBaseImpl::format(std::string &text, Ts &&...msg) {
+    char tmp[bufcnt(msg...)];
+    IoVector ioves[iovcnt(msg...)];
+    ResolveContext args {
+        .local = tmp,
+        .cur = 0,
+        .ioves = ioves,
+        .count = 0,
+        .total = 0
+    };
+    Resolver::resolve(args, std::forward<Ts>(msg)...);
+    size_t offset = text.size();
+    text.resize(offset + Resolver::calspace(args));
+    Resolver::put(args, &text[offset]);
+}
+
+template <typename ...Ts>
+inline const char* Deferred<Ts...>::decode(const char *record, std::string &text) {
+    // braced initialization, decoded from left to right
+    std::tuple<decltype(Codec<Ts>::decode(record))...> msg {Codec<Ts>::decode(record)...};
+    std::apply([&text](auto &...msg) { LogBaseImpl::format(text, msg...); }, msg);
+    return record;
+}
+
 } // dlog
 #endif
 #endif
\ No newline at end of file
@@ -1,6 +1,9 @@
 #ifndef __FLUENT_LOG_H__
 #define __FLUENT_LOG_H__
 #ifdef FLUENT_FLAG_DLOG_ENABLE
+    #ifdef FLUENT_FLAG_IO_URING
+        #define DLOG_FLAG_IO_URING
+    #endif
     #include "Log.hpp"
     #define LOG_DEBUG(...) DLOG_DEBUG_ALIGN(__VA_ARGS__)
     #define LOG_INFO(...)  DLOG_INFO_ALIGN(__VA_ARGS__)
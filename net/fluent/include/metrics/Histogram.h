@@ -0,0 +1,119 @@
+#ifndef __FLUENT_METRICS_HISTOGRAM_H__
+#define __FLUENT_METRICS_HISTOGRAM_H__
+#include <bits/stdc++.h>
+namespace fluent {
+
+// HDR-style log-linear histogram of nanoseconds
+// each power of two is split into SUB_BUCKETS linear buckets (relative error < 1/SUB_BUCKETS)
+// values in [0, 2^MAX_EXPONENT), larger values are clamped
+//
+// single writer (the loop thread), relaxed atomics
+// so a snapshot can be taken from any thread without stopping the writer
+class Histogram {
+public:
+    constexpr static size_t SUB_BITS = 4;
+    constexpr static size_t SUB_BUCKETS = 1 << SUB_BITS;
+    // ~18 minutes
+    constexpr static size_t MAX_EXPONENT = 40;
+    constexpr static size_t BUCKETS = (MAX_EXPONENT - SUB_BITS + 1) * SUB_BUCKETS;
+
+    struct Snapshot {
+        std::array<uint64_t, BUCKETS> counts {};
+        uint64_t count {0};
+        uint64_t sum {0};
+        uint64_t max {0};
+
+        // q in [0, 1], return: upper bound of the bucket
+        uint64_t percentile(double q) const;
+        double mean() const { return count ? double(sum) / count : 0; }
+        // aggregate loops
+        Snapshot& operator+=(const Snapshot &rhs);
+    };
+
+public:
+    void record(uint64_t value);
+    void record(std::chrono::nanoseconds duration) { record(uint64_t(std::max<int64_t>(duration.count(), 0))); }
+
+    Snapshot snapshot() const;
+
+    static size_t indexOf(uint64_t value);
+    // [lowerBound(index), lowerBound(index + 1))
+    static uint64_t lowerBound(size_t index);
+
+private:
+    static void increase(std::atomic<uint64_t> &counter, uint64_t n) {
+        // single writer, no lock prefix
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> _counts {};
+    std::atomic<uint64_t> _count {0};
+    std::atomic<uint64_t> _sum {0};
+    std::atomic<uint64_t> _max {0};
+};
+
+inline void Histogram::record(uint64_t value) {
+    increase(_counts[indexOf(value)], 1);
+    increase(_count, 1);
+    increase(_sum, value);
+    if(value > _max.load(std::memory_order_relaxed)) {
+        _max.store(value, std::memory_order_relaxed);
+    }
+}
+
+inline Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot snapshot;
+    for(size_t i = 0; i < BUCKETS; ++i) {
+        snapshot.counts[i] = _counts[i].load(std::memory_order_relaxed);
+    }
+    // may be a little behind the buckets, it is fine for monitoring
+    snapshot.count = _count.load(std::memory_order_relaxed);
+    snapshot.sum = _sum.load(std::memory_order_relaxed);
+    snapshot.max = _max.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+inline size_t Histogram::indexOf(uint64_t value) {
+    if(value < SUB_BUCKETS) return value;
+    size_t exponent = 63 - __builtin_clzll(value);
+    if(exponent >= MAX_EXPONENT) return BUCKETS - 1;
+    size_t sub = (value >> (exponent - SUB_BITS)) - SUB_BUCKETS;
+    return (exponent - SUB_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+inline uint64_t Histogram::lowerBound(size_t index) {
+    if(index < SUB_BUCKETS) return index;
+    size_t exponent = index / SUB_BUCKETS + SUB_BITS - 1;
+    size_t sub = index % SUB_BUCKETS;
+    return uint64_t(SUB_BUCKETS + sub) << (exponent - SUB_BITS);
+}
+
+inline uint64_t Histogram::Snapshot::percentile(double q) const {
+    // counts may be ahead of count
+    uint64_t total = std::accumulate(counts.begin(), counts.end(), uint64_t(0));
+    if(total == 0) return 0;
+    auto rank = uint64_t(std::ceil(std::clamp(q, 0.0, 1.0) * total));
+    uint64_t seen = 0;
+    for(size_t i = 0; i < BUCKETS; ++i) {
+        seen += counts[i];
+        if(seen >= std::max<uint64_t>(rank, 1)) {
+            uint64_t upper = i + 1 < BUCKETS ? lowerBound(i + 1) - 1 : max;
+            return std::min(upper, max);
+        }
+    }
+    return max;
+}
+
+inline Histogram::Snapshot& Histogram::Snapshot::operator+=(const Snapshot &rhs) {
+    for(size_t i = 0; i < BUCKETS; ++i) {
+        counts[i] += rhs.counts[i];
+    }
+    count += rhs.count;
+    sum += rhs.sum;
+    max = std::max(max, rhs.max);
+    return *this;
+}
+
+} // fluent
+#endif
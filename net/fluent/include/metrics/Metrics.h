@@ -0,0 +1,163 @@
+#ifndef __FLUENT_METRICS_METRICS_H__
+#define __FLUENT_METRICS_METRICS_H__
+#include <bits/stdc++.h>
+#include "Histogram.h"
+namespace fluent {
+
+// per-loop metrics, owned by looper (see Looper::metrics())
+// written by the loop thread only, cache-line isolated from other loops
+// snapshot() / aggregate() can be called from any thread without stopping the loops
+class alignas(64) Metrics {
+public:
+    enum Counter {
+        ACCEPTS,
+        READS,
+        READ_BYTES,
+        WRITES,
+        WRITE_BYTES,
+        // read / write would block
+        EAGAINS,
+        // epoll_ctl (io_uring: update requests)
+        EPOLL_CTLS,
+        // caught by handler
+        EXCEPTIONS,
+        // loop turns
+        TURNS,
+        // handling events and tasks
+        BUSY_NS,
+        // blocked in multiplexer
+        IDLE_NS,
+        COUNTERS
+    };
+
+    struct Snapshot {
+        std::array<uint64_t, COUNTERS> counters {};
+        // busy time per turn
+        Histogram::Snapshot turn;
+        // message callback
+        Histogram::Snapshot callback;
+        size_t loops {0};
+
+        uint64_t operator[](Counter counter) const { return counters[counter]; }
+        // busy / (busy + idle), 1.0: saturated
+        double utilization() const;
+        Snapshot& operator+=(const Snapshot &rhs);
+        std::string toString() const;
+    };
+
+public:
+    void add(Counter counter, uint64_t n = 1) {
+        auto &c = _counters[counter];
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    // begin -> ready: blocked in multiplexer, ready -> end: busy
+    template <typename TimePoint>
+    void recordTurn(TimePoint begin, TimePoint ready, TimePoint end);
+    Histogram& callbackTime() { return _callback; }
+
+    Snapshot snapshot() const;
+    // all living loops
+    static Snapshot aggregate();
+
+    Metrics();
+    ~Metrics();
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+private:
+    struct Registry {
+        std::mutex mutex;
+        std::vector<const Metrics*> loops;
+    };
+
+    static Registry& registry() { static Registry registry; return registry; }
+
+private:
+    std::array<std::atomic<uint64_t>, COUNTERS> _counters {};
+    alignas(64) Histogram _turn;
+    alignas(64) Histogram _callback;
+};
+
+template <typename TimePoint>
+inline void Metrics::recordTurn(TimePoint begin, TimePoint ready, TimePoint end) {
+    auto busy = std::chrono::duration_cast<std::chrono::nanoseconds>(end - ready);
+    auto idle = std::chrono::duration_cast<std::chrono::nanoseconds>(ready - begin);
+    add(TURNS);
+    add(BUSY_NS, busy.count());
+    add(IDLE_NS, idle.count());
+    _turn.record(busy);
+}
+
+inline Metrics::Snapshot Metrics::snapshot() const {
+    Snapshot snapshot;
+    for(size_t i = 0; i < COUNTERS; ++i) {
+        snapshot.counters[i] = _counters[i].load(std::memory_order_relaxed);
+    }
+    snapshot.turn = _turn.snapshot();
+    snapshot.callback = _callback.snapshot();
+    snapshot.loops = 1;
+    return snapshot;
+}
+
+inline Metrics::Snapshot Metrics::aggregate() {
+    Snapshot total;
+    auto &r = registry();
+    std::lock_guard<std::mutex> _{r.mutex};
+    for(auto loop : r.loops) {
+        total += loop->snapshot();
+    }
+    return total;
+}
+
+inline Metrics::Metrics() {
+    auto &r = registry();
+    std::lock_guard<std::mutex> _{r.mutex};
+    r.loops.emplace_back(this);
+}
+
+inline Metrics::~Metrics() {
+    auto &r = registry();
+    std::lock_guard<std::mutex> _{r.mutex};
+    r.loops.erase(std::find(r.loops.begin(), r.loops.end(), this));
+}
+
+inline double Metrics::Snapshot::utilization() const {
+    uint64_t busy = counters[BUSY_NS];
+    uint64_t total = busy + counters[IDLE_NS];
+    return total ? double(busy) / total : 0;
+}
+
+inline Metrics::Snapshot& Metrics::Snapshot::operator+=(const Snapshot &rhs) {
+    for(size_t i = 0; i < COUNTERS; ++i) {
+        counters[i] += rhs.counters[i];
+    }
+    turn += rhs.turn;
+    callback += rhs.callback;
+    loops += rhs.loops;
+    return *this;
+}
+
+inline std::string Metrics::Snapshot::toString() const {
+    constexpr static const char *NAMES[COUNTERS] = {
+        "accepts", "reads", "read_bytes", "writes", "write_bytes",
+        "eagains", "epoll_ctls", "exceptions", "turns", "busy_ns", "idle_ns"
+    };
+    std::string result = "loops=" + std::to_string(loops);
+    for(size_t i = 0; i < COUNTERS; ++i) {
+        result += ' ';
+        result += NAMES[i];
+        result += '=';
+        result += std::to_string(counters[i]);
+    }
+    char buffer[256];
+    std::snprintf(buffer, sizeof buffer,
+        " utilization=%.3f turn_ns(p50/p99/max)=%" PRIu64 "/%" PRIu64 "/%" PRIu64
+        " callback_ns(p50/p99/max)=%" PRIu64 "/%" PRIu64 "/%" PRIu64,
+        utilization(), turn.percentile(0.5), turn.percentile(0.99), turn.max,
+        callback.percentile(0.5), callback.percentile(0.99), callback.max);
+    return result + buffer;
+}
+
+} // fluent
+#endif
@@ -1,33 +1,87 @@
 #ifndef __FLUENT_NETWORK_ACCEPTOR_H__
 #define __FLUENT_NETWORK_ACCEPTOR_H__
+#include <sys/resource.h>
+#include <netinet/tcp.h>
+#include <linux/sock_diag.h>
 #include <bits/stdc++.h>
 #include "../future/Futures.h"
 #include "../logger/Logger.h"
 #include "InetAddress.h"
 #include "Socket.h"
+#include "Multiplexer.h"
 namespace fluent {
 
 class Acceptor /*: public std::enable_shared_from_this<Acceptor>*/ {
+public:
+    // accept4 per turn
+    constexpr static size_t ACCEPT_BATCH = 64;
+    // fds kept free below RLIMIT_NOFILE (logs, files, outgoing connections)
+    constexpr static size_t FD_RESERVE = 32;
+    // pause after fds are nearly exhausted
+    constexpr static std::chrono::milliseconds FD_COOLDOWN {100};
+
+    struct Stats {
+        uint64_t accepted;
+        // accepted per second, updated every second
+        double rate;
+        // connections dropped by kernel at this listen socket, e.g. the accept queue overflowed
+        // sk_drops (SO_MEMINFO), read every second and under pressure
+        uint64_t listenDrops;
+        // kernel accept queue length, probed under pressure
+        uint64_t queued;
+        // accept4 failed by EMFILE / ENFILE
+        uint64_t fdExhausted;
+        // paused by backpressure
+        uint64_t pauses;
+    };
+
 public:
     Future<Acceptor*> makeFuture() { return fluent::makeFuture(_looper, this); }
 
     void start() { _listenDescriptor.listen(); }
+    // epoll: listen fd wakes up the multiplexer
+    // io_uring: accepted by the accepts in flight in multiplexer
+    void start(Multiplexer *multiplexer, Multiplexer::Token token);
 
     // TODO use optional
     // std::shared_ptr<Context> accept();
 
+    // accept() count allowed in this turn
+    // 0 if paused by backpressure, the listen fd is removed from multiplexer until resumed
+    // live: connections in pool
+    size_t budget(size_t live);
+
     bool accept();
 
     // ensure: accept
     // can only get once per request
     std::pair<InetAddress, Socket> aceeptResult();
 
+    // backpressure
+    void setBatch(size_t batch) { _batch = std::max<size_t>(batch, 1); }
+    // pause if live connections >= watermark, 0: unlimited
+    void setMaxConnections(size_t watermark) { _maxConnections = watermark; }
+    void setFdReserve(size_t reserve) { _fdReserve = reserve; }
+
+    bool paused() const { return _paused; }
+    const Stats& stats() const { return _stats; }
+
     Acceptor(Looper *looper, InetAddress address);
     Acceptor(const Acceptor&) = delete;
     Acceptor(Acceptor&&) = default;
     Acceptor& operator=(const Acceptor&) = delete;
     Acceptor& operator=(Acceptor&&) = default;
 
+private:
+    void pause();
+    void resume();
+    // fd is accepted
+    void admitted(int fd);
+    void fdExhausted();
+    // kernel accept queue (TCP_INFO) and drops (SO_MEMINFO) of the listen socket
+    void probeQueue();
+    void updateRate();
+
 private:
     Looper *_looper; // TODO remove looper
     InetAddress _address;
@@ -38,19 +92,146 @@ private:
     // TODO use single union idiom to avoid construct
     // union { Socket buffered }
     Socket _lastBufferedSocket {Socket::INVALID_FD};
+
+    Multiplexer *_multiplexer {nullptr};
+    Multiplexer::Token _token {};
+
+    size_t _batch {ACCEPT_BATCH};
+    size_t _maxConnections {0};
+    size_t _fdReserve {FD_RESERVE};
+    // RLIMIT_NOFILE
+    size_t _fdLimit;
+    bool _paused {false};
+    TimerPoint _fdCooldown {};
+
+    // this turn
+    size_t _budget {0};
+    size_t _turnAccepted {0};
+    // rate window
+    TimerPoint _windowStart {};
+    uint64_t _windowAccepted {0};
+    Stats _stats {};
+
+#ifdef FLUENT_FLAG_IO_URING
+    // completed by multiplexer, [_acceptedCursor, size) are pending
+    std::vector<Multiplexer::Accepted> _accepted;
+    size_t _acceptedCursor {0};
+#endif
 };
 
+inline void Acceptor::start(Multiplexer *multiplexer, Multiplexer::Token token) {
+    start();
+    _multiplexer = multiplexer;
+    _token = token;
+    _multiplexer->listen(token, _listenDescriptor.fd());
+}
+
+inline size_t Acceptor::budget(size_t live) {
+    updateRate();
+    // the last turn used up the budget (a storm), or still paused
+    if(_paused || (_budget && _turnAccepted == _budget)) probeQueue();
+    _turnAccepted = 0;
+    bool full = _maxConnections && live >= _maxConnections;
+    bool cooling = _looper->now() < _fdCooldown;
+    if(full || cooling) {
+        pause();
+        return _budget = 0;
+    }
+    resume();
+    _budget = _batch;
+    if(_maxConnections) _budget = std::min(_budget, _maxConnections - live);
+    return _budget;
+}
+
+#ifdef FLUENT_FLAG_IO_URING
+inline bool Acceptor::accept() {
+    if(_acceptedCursor == _accepted.size()) {
+        _accepted.clear();
+        _acceptedCursor = 0;
+        if(_multiplexer) _multiplexer->exchangeAccepted(_token, _accepted);
+        if(_accepted.empty()) return false;
+    }
+    auto &accepted = _accepted[_acceptedCursor++];
+    int fd = accepted.first;
+    _lastBufferedAddress = accepted.second;
+    _lastBufferedSocket = Socket(fd);
+    admitted(fd);
+    return true;
+}
+#else
 inline bool Acceptor::accept() {
     socklen_t len = sizeof(_lastBufferedAddress);
     int maybeFd = ::accept4(_listenDescriptor.fd(), (sockaddr*)(&_lastBufferedAddress), &len,
                         SOCK_NONBLOCK | SOCK_CLOEXEC);
     if(maybeFd >= 0) {
         _lastBufferedSocket = Socket(maybeFd);
+        admitted(maybeFd);
         return true;
     }
-    // LOG...
+    if(errno == EMFILE || errno == ENFILE) fdExhausted();
     return false;
 }
+#endif
+
+inline void Acceptor::pause() {
+    if(_paused) return;
+    _paused = true;
+    _stats.pauses++;
+    if(_multiplexer) _multiplexer->setListening(_token, _listenDescriptor.fd(), false);
+    FLUENT_LOG_WARN(_address.toStringPretty(), "accept paused");
+}
+
+inline void Acceptor::resume() {
+    if(!_paused) return;
+    _paused = false;
+    if(_multiplexer) _multiplexer->setListening(_token, _listenDescriptor.fd(), true);
+    FLUENT_LOG_INFO(_address.toStringPretty(), "accept resumed");
+}
+
+inline void Acceptor::admitted(int fd) {
+    _turnAccepted++;
+    _windowAccepted++;
+    _stats.accepted++;
+    // fds are allocated lowest-first, a high fd means the table is nearly full
+    if(size_t(fd) + _fdReserve >= _fdLimit) {
+        _fdCooldown = _looper->now() + FD_COOLDOWN;
+    }
+}
+
+inline void Acceptor::fdExhausted() {
+    _stats.fdExhausted++;
+    _fdCooldown = _looper->now() + FD_COOLDOWN;
+    FLUENT_LOG_WARN(_address.toStringPretty(), "accept failed:", ::strerror(errno));
+}
+
+inline void Acceptor::probeQueue() {
+    int fd = _listenDescriptor.fd();
+    tcp_info info;
+    socklen_t len = sizeof(info);
+    // listen socket: unacked = accept queue length, sacked = backlog
+    if(!::getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len)) {
+        _stats.queued = info.tcpi_unacked;
+    }
+    // counted by kernel since listen(), e.g. ListenOverflows of this socket
+    uint32_t meminfo[SK_MEMINFO_VARS];
+    len = sizeof(meminfo);
+    if(!::getsockopt(fd, SOL_SOCKET, SO_MEMINFO, meminfo, &len) && len > SK_MEMINFO_DROPS * sizeof(uint32_t)) {
+        _stats.listenDrops = meminfo[SK_MEMINFO_DROPS];
+    }
+}
+
+inline void Acceptor::updateRate() {
+    auto now = _looper->now();
+    auto elapsed = now - _windowStart;
+    if(elapsed < std::chrono::seconds(1)) return;
+    probeQueue();
+    // the first window starts from the first turn
+    if(_windowStart != TimerPoint{}) {
+        _stats.rate = _windowAccepted / std::chrono::duration<double>(elapsed).count();
+    }
+    _windowStart = now;
+    _windowAccepted = 0;
+}
 
 // ensure: accept
 // can only get once per request
@@ -61,6 +242,9 @@ inline std::pair<InetAddress, Socket> Acceptor::aceeptResult() {
 inline Acceptor::Acceptor(Looper *looper, InetAddress address)
     : _looper(looper),
       _address(address) {
+    rlimit limit;
+    _fdLimit = ::getrlimit(RLIMIT_NOFILE, &limit) || limit.rlim_cur == RLIM_INFINITY
+        ? std::numeric_limits<int>::max() : limit.rlim_cur;
     _listenDescriptor.setReusePort();
     _listenDescriptor.setReuseAddr();
     _listenDescriptor.bind(address);
@@ -7,18 +7,28 @@
 #include "../utils/Algorithms.h"
 namespace fluent {
 
-// TODO use small_vector
+// contiguous buffer of a single vector
+// a context can use ChainBuffer instead (FLUENT_FLAG_CHAIN_BUFFER)
 class Buffer {
 public:
+    // readFrom() reads at most unwrite() + READ_EXTRA bytes, the extra part is on stack
+    constexpr static ssize_t READ_EXTRA = 1 << 16;
+    // a drained buffer larger than this goes back to its initial size
+    // idle connections should not keep the memory of their largest burst
+    constexpr static ssize_t SHRINK_THRESHOLD = 1 << 16;
+
     Buffer(ssize_t size = 128);
 
     ssize_t size() const { return _capacity; }
     ssize_t unread() const { return _w - _r; }
     ssize_t unwrite() const { return _capacity - _w; }
     ssize_t available() const { return _capacity - unread(); }
+    // readFrom() reads at most readLimit() bytes
+    ssize_t readLimit() const { return unwrite() + READ_EXTRA; }
 
     void clear() { _r = _w = 0; }
     void reuseIfPossible();
+    void shrink();
     void gc();
     void gc(ssize_t hint);
     void expand() { _buf.resize(_capacity <<= 1); }
@@ -39,6 +49,10 @@ public:
     template <typename T, size_t N>
     void append(const T (&data)[N]) { append(data, sizeof(T) * N); }
 
+    // view of unread bytes [offset, offset + length), the same as ChainBuffer::peek()
+    // return: count of iovecs filled
+    size_t peek(iovec *vec, size_t count, size_t offset = 0, size_t length = SIZE_MAX) const;
+
     ssize_t readFrom(const Socket &socket) { return readFrom(socket.fd()); }
     ssize_t readFrom(int fd);
     ssize_t writeTo(int fd);
@@ -46,17 +60,20 @@ public:
 private:
     std::vector<char> _buf;
     ssize_t _capacity;
+    ssize_t _initial;
     ssize_t _r, _w; // _r <= _w
 };
 
 inline Buffer::Buffer(ssize_t size)
-    : _capacity(size),
-      _buf(size),
+    : _buf(size),
+      _capacity(size),
+      _initial(size),
       _r(0), _w(0) {}
 
 inline void Buffer::reuseIfPossible() {
     if(_r == _w) {
         clear();
+        if(_capacity > SHRINK_THRESHOLD) shrink();
         return;
     }
     ssize_t bufferRest = unread();
@@ -65,6 +82,14 @@ inline void Buffer::reuseIfPossible() {
     }
 }
 
+inline void Buffer::shrink() {
+    if(unread() || _capacity <= _initial) return;
+    // resize() never releases the memory
+    std::vector<char>(_initial).swap(_buf);
+    _capacity = _initial;
+    clear();
+}
+
 inline void Buffer::gc() {
     if(_r > 0) {
         // move [_r, _w) to front
@@ -90,8 +115,14 @@ inline void Buffer::append(const char *data, ssize_t size) {
     hasWritten(size);
 }
 
+inline size_t Buffer::peek(iovec *vec, size_t count, size_t offset, size_t length) const {
+    if(!count || !length || offset >= size_t(unread())) return 0;
+    vec[0] = {const_cast<char*>(readBuffer()) + offset, std::min(length, unread() - offset)};
+    return 1;
+}
+
 inline ssize_t Buffer::readFrom(int fd) {
-    char localBuffer[1<<16];
+    char localBuffer[READ_EXTRA];
     iovec vec[2];
     ssize_t bufferLimit = unwrite();
     vec[0].iov_base = writeBuffer();
@@ -0,0 +1,251 @@
+#ifndef __FLUENT_NETWORK_CHAIN_BUFFER_H__
+#define __FLUENT_NETWORK_CHAIN_BUFFER_H__
+#include <sys/uio.h>
+#include <unistd.h>
+#include <bits/stdc++.h>
+#include "Socket.h"
+#include "Slab.h"
+#include "../utils/Algorithms.h"
+namespace fluent {
+
+// segmented buffer, a linked list of slabs from the pool of a looper
+// the same interface as Buffer where the context uses it (FLUENT_FLAG_CHAIN_BUFFER)
+// compared to Buffer:
+// - no memmove / zero-filled resize, readv directly into the free slabs
+// - consumed slabs go back to the pool, an idle buffer holds no memory
+// - readBuffer() pulls up the unread bytes only if they span slabs,
+//   peek() gives the views without copying
+//
+// ensure: used and destroyed in the looper thread, before the looper
+class ChainBuffer {
+public:
+    // slabs prepared by readFrom()
+    constexpr static size_t READ_SLABS = 16;
+    // iovecs of writeTo()
+    constexpr static size_t WRITE_SLABS = 64;
+
+    ssize_t unread() const { return _unread; }
+    bool empty() const { return _unread == 0; }
+    size_t slabs() const { return _slabs; }
+    // readFrom() reads at most readLimit() bytes
+    ssize_t readLimit() const { return (_tail ? _tail->unwrite() : 0) + READ_SLABS * Slab::CAPACITY; }
+
+    void clear();
+    // n unread bytes are consumed, drained slabs go back to the pool
+    void hasRead(ssize_t n);
+
+    // all unread bytes, contiguous
+    // note: invalidated by any non-const call
+    const char* readBuffer() { return pullup(); }
+
+    void append(const char *data, ssize_t size);
+    void append(const std::string &str) { append(str.data(), str.size()); }
+    template <typename T, typename = std::enable_if_t<!std::is_pointer<T>::value>>
+    void append(const T &data) { append((const char *)(&data), sizeof(T)); }
+    template <typename T, size_t N>
+    void append(const T (&data)[N]) { append(data, sizeof(T) * N); }
+
+    // zero-copy views of unread bytes [offset, offset + length)
+    // return: count of iovecs filled
+    size_t peek(iovec *vec, size_t count, size_t offset = 0, size_t length = SIZE_MAX) const;
+
+    ssize_t readFrom(const Socket &socket) { return readFrom(socket.fd()); }
+    ssize_t readFrom(int fd);
+    ssize_t writeTo(int fd);
+
+    explicit ChainBuffer(SlabPool *pool): _pool(pool) {}
+    ~ChainBuffer() { clear(); }
+    ChainBuffer(const ChainBuffer&) = delete;
+    ChainBuffer(ChainBuffer &&rhs);
+    ChainBuffer& operator=(const ChainBuffer&) = delete;
+    ChainBuffer& operator=(ChainBuffer &&rhs);
+
+private:
+    // make the unread bytes contiguous in a single slab
+    char* pullup();
+    void link(Slab *slab);
+    void unlinkFront();
+
+private:
+    SlabPool *_pool;
+    Slab *_head {nullptr};
+    Slab *_tail {nullptr};
+    size_t _unread {0};
+    size_t _slabs {0};
+};
+
+inline void ChainBuffer::clear() {
+    while(_head) unlinkFront();
+    _unread = 0;
+}
+
+inline void ChainBuffer::hasRead(ssize_t n) {
+    size_t rest = std::min(size_t(n), _unread);
+    _unread -= rest;
+    while(rest) {
+        size_t length = std::min(rest, _head->unread());
+        _head->r += length;
+        rest -= length;
+        // keep the tail slab if it can be written
+        if(!_head->unread() && (_head != _tail || !_head->unwrite())) {
+            unlinkFront();
+        }
+    }
+    if(_unread == 0 && _head) {
+        // idle buffer holds no memory
+        clear();
+    }
+}
+
+inline void ChainBuffer::append(const char *data, ssize_t size) {
+    while(size > 0) {
+        if(!_tail || !_tail->unwrite()) {
+            link(_pool->allocate());
+        }
+        size_t n = std::min(size_t(size), _tail->unwrite());
+        memcpy(_tail->data() + _tail->w, data, n);
+        _tail->w += n;
+        _unread += n;
+        data += n;
+        size -= n;
+    }
+}
+
+inline size_t ChainBuffer::peek(iovec *vec, size_t count, size_t offset, size_t length) const {
+    size_t filled = 0;
+    for(const Slab *slab = _head; slab && filled < count && length; slab = slab->next) {
+        size_t unread = slab->unread();
+        if(offset >= unread) {
+            offset -= unread;
+            continue;
+        }
+        size_t n = std::min(unread - offset, length);
+        vec[filled++] = {const_cast<char*>(slab->data()) + slab->r + offset, n};
+        length -= n;
+        offset = 0;
+    }
+    return filled;
+}
+
+inline ssize_t ChainBuffer::readFrom(int fd) {
+    Slab *prepared[READ_SLABS];
+    iovec vec[READ_SLABS + 1];
+    size_t count = 0;
+    size_t tailLimit = _tail ? _tail->unwrite() : 0;
+    if(tailLimit) {
+        vec[count++] = {_tail->data() + _tail->w, tailLimit};
+    }
+    for(size_t i = 0; i < READ_SLABS; ++i) {
+        prepared[i] = _pool->allocate();
+        vec[count++] = {prepared[i]->data(), Slab::CAPACITY};
+    }
+    ssize_t n = ::readv(fd, vec, count);
+    size_t rest = n > 0 ? n : 0;
+    _unread += rest;
+    if(tailLimit) {
+        size_t length = std::min(rest, tailLimit);
+        _tail->w += length;
+        rest -= length;
+    }
+    // most recently used first, they are hot
+    for(size_t i = READ_SLABS; i--;) {
+        if(rest <= i * Slab::CAPACITY) _pool->deallocate(prepared[i]);
+    }
+    for(size_t i = 0; rest; ++i) {
+        size_t length = std::min(rest, Slab::CAPACITY);
+        prepared[i]->w = length;
+        rest -= length;
+        link(prepared[i]);
+    }
+    // n < 0 error
+    return n;
+}
+
+inline ssize_t ChainBuffer::writeTo(int fd) {
+    iovec vec[WRITE_SLABS];
+    size_t count = peek(vec, WRITE_SLABS);
+    if(count == 0) return 0;
+    ssize_t n = ::writev(fd, vec, count);
+    if(n < 0) {
+        switch(errno) {
+            case EAGAIN:
+            case EINTR:
+                n = 0;
+            break;
+            default:
+                throw WriteException(errno);
+            break;
+        }
+    }
+    hasRead(n);
+    return n;
+}
+
+inline char* ChainBuffer::pullup() {
+    if(!_head) return nullptr;
+    if(_head->unread() == _unread) return _head->data() + _head->r;
+    // a message spans slabs, copy it once
+    // the spare room takes the rest of the message without another pullup
+    Slab *slab = _pool->allocate(_unread <= Slab::CAPACITY ? Slab::CAPACITY : roundToPowerOfTwo(_unread));
+    for(Slab *s = _head; s; s = s->next) {
+        memcpy(slab->data() + slab->w, s->data() + s->r, s->unread());
+        slab->w += s->unread();
+    }
+    size_t unread = _unread;
+    clear();
+    link(slab);
+    _unread = unread;
+    return slab->data();
+}
+
+inline ChainBuffer::ChainBuffer(ChainBuffer &&rhs)
+    : _pool(rhs._pool),
+      _head(std::exchange(rhs._head, nullptr)),
+      _tail(std::exchange(rhs._tail, nullptr)),
+      _unread(std::exchange(rhs._unread, 0)),
+      _slabs(std::exchange(rhs._slabs, 0)) {}
+
+inline ChainBuffer& ChainBuffer::operator=(ChainBuffer &&rhs) {
+    if(this != &rhs) {
+        clear();
+        _pool = rhs._pool;
+        _head = std::exchange(rhs._head, nullptr);
+        _tail = std::exchange(rhs._tail, nullptr);
+        _unread = std::exchange(rhs._unread, 0);
+        _slabs = std::exchange(rhs._slabs, 0);
+    }
+    return *this;
+}
+
+inline void ChainBuffer::link(Slab *slab) {
+    if(_tail) {
+        _tail->next = slab;
+    } else {
+        _head = slab;
+    }
+    _tail = slab;
+    ++_slabs;
+}
+
+inline void ChainBuffer::unlinkFront() {
+    Slab *slab = _head;
+    _head = slab->next;
+    if(!_head) _tail = nullptr;
+    --_slabs;
+    _pool->deallocate(slab);
+}
+
+inline std::ostream& operator << (std::ostream &os, const ChainBuffer &buf) {
+    iovec vec[ChainBuffer::WRITE_SLABS];
+    size_t offset = 0;
+    while(size_t count = buf.peek(vec, ChainBuffer::WRITE_SLABS, offset)) {
+        for(size_t i = 0; i < count; ++i) {
+            os.write(static_cast<const char*>(vec[i].iov_base), vec[i].iov_len);
+            offset += vec[i].iov_len;
+        }
+    }
+    return os;
+}
+
+} // fluent
+#endif
@@ -1,113 +1,139 @@
 #ifndef __FLUENT_NETWORK_CONNECTOR_H__
 #define __FLUENT_NETWORK_CONNECTOR_H__
 #include <unistd.h>
-#include <sys/select.h>
 #include <netinet/in.h>
 #include <bits/stdc++.h>
 #include "../future/Futures.h"
 #include "InetAddress.h"
 #include "Socket.h"
-// #include "Multiplexer.h"
+#include "Multiplexer.h"
 namespace fluent {
 
+// readiness-driven connect
+// the context stays CONNECTING in the pool until handler sees a write event (see Handler::handleConnect())
+// no polling in looper, a failed attempt is retried after RETRY_DELAY until connected (or timed out)
 class Connector {
 public:
-    Future<Connector*> makeFuture() { return fluent::makeFuture(_looper, this); }
+    constexpr static std::chrono::milliseconds RETRY_DELAY {100};
 
-    Future<std::pair<InetAddress, Socket>> connect(const InetAddress /*server*/&address);
+public:
+    // future: in looper, resolved after the connect callback
+    //         nullptr if it is not connected within timeout, the context is DISCONNECTED (see abandoned())
+    // timeout: 0, retry until connected
+    // ensure: bundle is a new context of address, in the pool
+    Future<Context*> connect(Multiplexer *multiplexer, Multiplexer::Bundle bundle,
+                             std::chrono::milliseconds timeout = {});
+
+    // contexts of the timed out attempts, should be retired by the pool owner
+    std::vector<Multiplexer::Bundle>& abandoned() { return *_abandoned; }
 
-    Connector(Looper *looper) : _looper(looper) {}
-    ~Connector() = default;
+    Connector(Looper *looper)
+        : _looper(looper),
+          _connecting(std::make_unique<std::list<Connecting>>()),
+          _abandoned(std::make_unique<std::vector<Multiplexer::Bundle>>()) {}
+    // unfinished attempts are given up, their futures are cancelled
+    ~Connector();
     Connector(const Connector&) = delete;
     Connector(Connector&&) = default;
     Connector& operator=(const Connector&) = delete;
     Connector& operator=(Connector&&) = default;
 
 private:
-    static int testFailed(const Socket &socket);
+    struct Connecting {
+        Promise<Context*> promise;
+        Multiplexer *multiplexer;
+        Multiplexer::Bundle bundle;
+        Looper *looper;
+        // the next attempt, if retrying
+        TimerId retry;
+        bool retrying;
+        // give up, if timeout is set
+        TimerId deadline;
+        bool limited;
+        // erased from the owner when connected
+        std::list<Connecting> *owner;
+        std::list<Connecting>::iterator self;
+        std::vector<Multiplexer::Bundle> *abandoned;
+    };
+
+    // an attempt
+    static void start(Connecting *connecting);
+    // Resumer::fn
+    static void resume(void *arg, bool connected);
+    // timed out
+    static void giveUp(Connecting *connecting);
 
 private:
     Looper *_looper;
+    // owned attempts, address stable if the connector is moved
+    std::unique_ptr<std::list<Connecting>> _connecting;
+    std::unique_ptr<std::vector<Multiplexer::Bundle>> _abandoned;
 };
 
-inline Future<std::pair<InetAddress, Socket>> Connector::connect(const InetAddress /*server*/&address) {
-    Socket socket;
-    // try to connect immediately, then test in async-task
-    int ret = socket.connect(address);
-    int err = ret ? errno : 0;
-    bool reconnect = false;
-    bool nextInstance = false;
-    auto arguments = std::make_tuple(address, std::move(socket), err, reconnect, nextInstance);
-    // safe lifecycle
-    auto constructor = std::make_shared<decltype(arguments)>(std::move(arguments));
-    return this->makeFuture()
-        .poll([constructor](Connector*) {
-            auto &arguments = *constructor;
-            Socket &socket = std::get<1>(arguments);
-            int &err = std::get<2>(arguments);
-            bool &reconnect = std::get<3>(arguments);
-            bool &nextInstance = std::get<4>(arguments);
-            // unlikely
-            if(reconnect) {
-                InetAddress &address = std::get<0>(arguments);
-                if(nextInstance) {
-                    Socket().swap(socket);
-                    nextInstance = false;
-                }
-                int ret = socket.connect(address);
-                err = ret ? errno : 0;
-                reconnect = false;
-                return !err;
-            }
-            switch(err) {
-                case 0:
-                    return true;
-                case EINTR:
-                case ENETUNREACH:
-                case ETIMEDOUT:
-                    nextInstance = true;
-                    reconnect = true;
-                    return false;
-                case EINPROGRESS:
-                case EISCONN:
-                case EALREADY:
-                case ECONNREFUSED:
-                    // example:
-                    // EINPROGRESS -> EALREADY -> ECONNREFUSED -> connected
-                    if(err = Connector::testFailed(socket)) {
-                        reconnect = true;
-                        return false;
-                    }
-                    // err == 0
-                    return true;
-                default:
-                    // err != 0
-                    return true;
-            }
-        })
-        .cancelIf([constructor](Connector*) {
-            auto &args = *constructor;
-            int err = std::get<2>(args);
-            // TODO LOG_WARN reason: strerror(err)
-            // TODO cancel and then execute next user-defined callback
-            return !!err;
-        })
-        .then([constructor](Connector*) {
-            auto &arguments = *constructor;
-            InetAddress &address = std::get<0>(arguments);
-            Socket &socket = std::get<1>(arguments);
-            return std::make_pair(address, std::move(socket));
-        });
+inline Future<Context*> Connector::connect(Multiplexer *multiplexer, Multiplexer::Bundle bundle,
+                                           std::chrono::milliseconds timeout) {
+    auto context = &bundle->second;
+    context->_multiplexer = multiplexer;
+    context->_bundle = bundle;
+    // owned by the connector, released when connected or given up
+    auto &connecting = _connecting->emplace_back(
+        Connecting {Promise<Context*>{_looper}, multiplexer, bundle, _looper, {}, false, {}, false,
+                    _connecting.get(), {}, _abandoned.get()});
+    connecting.self = std::prev(_connecting->end());
+    auto future = connecting.promise.get();
+    if(timeout.count() > 0) {
+        auto pointer = &connecting;
+        connecting.deadline = _looper->runAfter(timeout, [pointer] { giveUp(pointer); });
+        connecting.limited = true;
+    }
+    start(&connecting);
+    return future;
 }
 
-inline int Connector::testFailed(const Socket &socket) {
-    sockaddr jojo;
-    socklen_t len = sizeof(jojo);
-    if(::getpeername(socket.fd(), &jojo, &len)) {
-        return errno;
+inline Connector::~Connector() {
+    // moved
+    if(!_connecting) return;
+    for(auto &connecting : *_connecting) {
+        if(connecting.retrying) _looper->cancel(connecting.retry);
+        if(connecting.limited) _looper->cancel(connecting.deadline);
+        // the contexts are not touched, the pool may be destroyed before the connector
+        connecting.promise.cancel();
     }
-    return 0;
+}
+
+inline void Connector::start(Connecting *connecting) {
+    connecting->retrying = false;
+    auto context = &connecting->bundle->second;
+    FLUENT_LOG_DEBUG(context->simpleInfo(), "connecting to", context->address.toString());
+    context->_connector = Resumer {&Connector::resume, connecting};
+    connecting->multiplexer->connect(connecting->bundle);
+}
+
+inline void Connector::resume(void *arg, bool connected) {
+    auto connecting = static_cast<Connecting*>(arg);
+    auto context = &connecting->bundle->second;
+    if(connected) {
+        if(connecting->limited) connecting->looper->cancel(connecting->deadline);
+        connecting->promise.setValue(context);
+        connecting->owner->erase(connecting->self);
+        return;
+    }
+    connecting->retry = connecting->looper->runAfter(RETRY_DELAY, [connecting] { start(connecting); });
+    connecting->retrying = true;
+}
+
+inline void Connector::giveUp(Connecting *connecting) {
+    auto context = &connecting->bundle->second;
+    FLUENT_LOG_WARN(context->simpleInfo(), "connect timed out");
+    if(connecting->retrying) connecting->looper->cancel(connecting->retry);
+    // in flight, or the fresh socket of the next attempt
+    connecting->multiplexer->cancelConnect(connecting->bundle);
+    context->_connector = {};
+    context->_nState = Context::NetworkState::DISCONNECTED;
+    connecting->abandoned->emplace_back(connecting->bundle);
+    connecting->promise.setValue(nullptr);
+    connecting->owner->erase(connecting->self);
 }
 
 } // fluent
-#endif
\ No newline at end of file
+#endif
@@ -3,6 +3,9 @@
 #include <unistd.h>
 #include <poll.h>
 #include <sys/epoll.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
 #include <bits/stdc++.h>
 #include "../future/Futures.h"
 #include "../utils/Object.h"
@@ -11,13 +14,28 @@
 #include "../policy/LifecyclePolicy.h"
 #include "../policy/SendPolicy.h"
 #include "../policy/MultiplexerPolicy.h"
+#include "../policy/TimeoutPolicy.h"
+#include "../policy/AwaitPolicy.h"
 #include "InetAddress.h"
 #include "Socket.h"
 #include "Buffer.h"
+#include "ChainBuffer.h"
 #include "Lifecycle.h"
 namespace fluent {
 
 class Multiplexer;
+class Connector;
+
+#if defined(FLUENT_FLAG_CHAIN_BUFFER) && !defined(FLUENT_FLAG_IO_URING)
+// slabs from the looper, idle connections hold no buffer memory
+// note: io_uring backend swaps the output to its own Buffer, so it is not supported
+using ContextBuffer = ChainBuffer;
+#else
+using ContextBuffer = Buffer;
+#endif
+
+class ReadAwaiter;
+class WriteAwaiter;
 
 // policy base can make context interface clean (hide private/protected implementation details)
 // protected inheritance: avoid the implicit casting
@@ -25,14 +43,22 @@ class Multiplexer;
 class Context: protected NetworksPolicy,
                protected LifecyclePolicy,
                protected SendPolicy,
-               protected MultiplexerPolicy {
+               protected MultiplexerPolicy,
+               protected TimeoutPolicy,
+               protected AwaitPolicy {
 // friends
 public:
-    template <typename, typename, typename> friend class Handler;
+    template <typename, typename, typename, typename> friend class Handler;
+    friend class Multiplexer;
+    friend class Pool;
+    friend class Connector;
+    friend class ReadAwaiter;
+    friend class WriteAwaiter;
 
 // type alias
 public:
     using Completion = SendPolicy::Completion;
+    using Waiter = SendPolicy::Waiter;
     using EpollOperationHint = MultiplexerPolicy::EpollOperationHint;
     using EventBitmap = MultiplexerPolicy::EventBitmap;
 
@@ -41,13 +67,17 @@ public:
     Context(Looper *looper, const InetAddress &address, Socket &&socket)
         : looper(looper),
           address(address),
-          socket(std::move(socket)) {}
+          socket(std::move(socket)),
+          input(makeBuffer(looper)),
+          output(makeBuffer(looper)) {}
 
     Context(Looper *looper, const InetAddress &address, Socket &&socket, EnableLifecycle)
-        : looper(looper),
+        : LifecyclePolicy(EnableLifecycle{}),
+          looper(looper),
           address(address),
           socket(std::move(socket)),
-          LifecyclePolicy(EnableLifecycle{}) {}
+          input(makeBuffer(looper)),
+          output(makeBuffer(looper)) {}
 
     ~Context() = default;
     Context(const Context&) = delete;
@@ -64,8 +94,8 @@ public:
     Looper *looper;
     InetAddress address;
     Socket socket;
-    Buffer input;
-    Buffer output;
+    ContextBuffer input;
+    ContextBuffer output;
     // captured exception
     std::exception_ptr exception;
     // user context, anything is ok
@@ -102,16 +132,61 @@ public:
     Completion send(const char (&buf)[N]) {  return send(buf, N-1); /*'\0'*/ }
     Completion send(const std::string &str) { return send(str.c_str(), str.size()); }
 
+    // zero-copy, gather write
+    // borrowed: ensure buffers are alive until completion
+    Completion sendv(const iovec *vec, size_t count) { return sendv(vec, count, nullptr); }
+    // owned: buffers are held by owner until completion
+    Completion sendv(const iovec *vec, size_t count, std::shared_ptr<const void> owner);
+    Completion send(std::shared_ptr<const std::string> str);
+    // n bytes have been appended to output by user (e.g. a response builder)
+    // many messages can be appended and sent by one call
+    Completion sendAppended(size_t n);
+
+    // MSG_ZEROCOPY for large referenced bytes (sendv)
+    // note: only for epoll backend, io_uring backend copies referenced bytes to output
+    void setZeroCopy(bool on = true);
+
 // multiplexer
 public:
     using MultiplexerPolicy::updateEventState;
     using MultiplexerPolicy::events;
     using MultiplexerPolicy::readEventEnabled;
     using MultiplexerPolicy::writeEventEnabled;
-    using MultiplexerPolicy::enableRead;
+    // edge-triggered: bytes that arrived while paused raise no new edge,
+    // so a read is deferred to looper when it is enabled again
+    bool enableRead();
     using MultiplexerPolicy::enableWrite;
     using MultiplexerPolicy::disableRead;
     using MultiplexerPolicy::disableWrite;
+    using MultiplexerPolicy::ioPending;
+
+// timeout
+public:
+    // close if there is no read or write in timeout
+    // 0: disable
+    void setIdleTimeout(std::chrono::milliseconds timeout);
+    // close if nothing is read in timeout from now (oneshot)
+    void setReadDeadline(std::chrono::milliseconds timeout);
+    // close if the send queue is not flushed in timeout from now (oneshot)
+    void setWriteDeadline(std::chrono::milliseconds timeout);
+
+    // shutdown both directions, handler will see EOF and close it as usual
+    void forceClose();
+
+    using TimeoutPolicy::lastRead;
+    using TimeoutPolicy::lastWrite;
+    using TimeoutPolicy::lastActive;
+
+#ifdef __cpp_impl_coroutine
+// coroutine (C++20), see coroutine/Awaiters.h
+public:
+    // co_await: readable bytes in input, less than n if the connection is closed
+    // resumed by handler when the bytes arrive, a single reader per context
+    ReadAwaiter read(size_t n = 1);
+    // co_await: the same as send(args...).future(), without allocation
+    template <typename ...Args>
+    WriteAwaiter write(Args &&...args);
+#endif
 
 // log helper
 public:
@@ -123,10 +198,47 @@ public:
     using MultiplexerPolicy::eventStateInfo;
     using MultiplexerPolicy::eventsInfo;
 
+// send(private)
+private:
+    void enqueueCopy(const char *buf, size_t n);
+    Completion enqueueCompletion(size_t pending);
+
+    // write the send queue
+    // return: released bytes (written and not pinned by MSG_ZEROCOPY)
+    ssize_t flush();
+    // a single writev/sendmsg
+    // more: the whole batch is written and the send queue is not empty
+    ssize_t flushBatch(bool &more);
+    // MSG_ZEROCOPY notification from error queue
+    // return: released bytes, or -1 if nothing notified
+    ssize_t reapZeroCopy();
+    size_t release(uint32_t sequence, size_t length);
+
 // multiplexer(private)
 private:
     void updateMultiplexer(EpollOperationHint hint);
 
+    // edge-triggered: Handler::deferRead() of the owner, set by handler
+    void (*_deferRead)(void *handler, std::pair<size_t, Context> *bundle) {nullptr};
+    void *_handler {nullptr};
+
+// timeout(private)
+private:
+    void setTimeout(TimeoutKind kind, std::chrono::milliseconds timeout);
+    void armTimeout(TimeoutKind kind, TimerPoint when);
+    void handleTimeout(TimeoutKind kind);
+
+// buffer(private)
+private:
+    static ContextBuffer makeBuffer(Looper *looper);
+
+// pool(private)
+private:
+    // a retired context is reused for a new connection in place
+    // the same as a new one, but the buffers keep their memory
+    void reset(Looper *looper, const InetAddress &address, Socket &&socket);
+    void reset(Looper *looper, const InetAddress &address, Socket &&socket, EnableLifecycle);
+
 // log helper(private)
 private:
     mutable uint64_t _hashcode {};
@@ -175,30 +287,403 @@ inline auto Context::makeWeakFuture() -> Future<std::tuple<Context*, WeakLifecyc
     return fluent::makeTupleFuture(looper, this, WeakLifecycle(_lifecycle));
 }
 
+inline bool Context::enableRead() {
+    if(!MultiplexerPolicy::enableRead()) return false;
+    if(EDGE_TRIGGERED && _deferRead && (isConnected() || isDisConnecting())) {
+        _deferRead(_handler, _bundle);
+    }
+    return true;
+}
+
 inline Context::Completion Context::send(const void *buf, size_t n) {
     if(_nState != NetworkState::DISCONNECTING && _nState != NetworkState::DISCONNECTED) {
         FLUENT_LOG_DEBUG(simpleInfo(), "tries to write", n, "bytes");
-        ssize_t ret = socket.write(buf, n);
+        ssize_t ret = 0;
+#ifndef FLUENT_FLAG_IO_URING
+        // io_uring: always submitted as a send sqe in the next poll
+        // epoll: keep the order of pending bytes
+        if(_sendQueue.empty()) {
+            ret = socket.write(buf, n);
+            // 0: EAGAIN / EINTR
+            looper->metrics().add(ret > 0 ? Metrics::WRITES : Metrics::EAGAINS);
+        }
+#endif
         FLUENT_LOG_DEBUG(simpleInfo(), "-->", "(stream length)", ret);
+        if(ret > 0) {
+            _lastWrite = looper->now();
+            looper->metrics().add(Metrics::WRITE_BYTES, ret);
+        }
         if(ret == n) {
             // fast return
-            return Completion{Completion::FAST_COMPLETE, this};
+            return Completion{Completion::FAST_COMPLETE, this, looper};
         }
-        // TODO submit request to buffer with readyFlag and vector
-        output.append(static_cast<const char *>(buf) + ret, n - ret);
+        enqueueCopy(static_cast<const char *>(buf) + ret, n - ret);
         FLUENT_LOG_DEBUG(simpleInfo(), "-->", "(buffer length)", n - ret);
-        _sendProvider.emplace(n - ret);
-        size_t sendToken = _sendCurrentIndex++;
-        if(!(_events & EVENT_WRITE)) {
-            _events |= EVENT_WRITE;
-            // TODO remove this ugly code, use handler when any callback
-            auto hint = updateEventState();
-            updateMultiplexer(hint);
-            // will disable write when buf.unread == 0 (handleWrite)
+        return enqueueCompletion(n - ret);
+    }
+    return Completion{Completion::INVALID, this, looper};
+}
+
+// io_uring: owner is not needed, referenced bytes are copied
+inline Context::Completion Context::sendv(const iovec *vec, size_t count, [[maybe_unused]] std::shared_ptr<const void> owner) {
+    if(_nState == NetworkState::DISCONNECTING || _nState == NetworkState::DISCONNECTED) {
+        return Completion{Completion::INVALID, this, looper};
+    }
+    size_t total = 0;
+#ifdef FLUENT_FLAG_IO_URING
+    // the send sqe owns a swapped output buffer, so just copy
+    for(size_t i = 0; i < count; ++i) {
+        enqueueCopy(static_cast<const char *>(vec[i].iov_base), vec[i].iov_len);
+        total += vec[i].iov_len;
+    }
+    if(total == 0) {
+        return Completion{Completion::FAST_COMPLETE, this, looper};
+    }
+    return enqueueCompletion(total);
+#else
+    bool idle = _sendQueue.empty();
+    for(size_t i = 0; i < count; ++i) {
+        if(vec[i].iov_len == 0) continue;
+        _sendQueue.push_back({static_cast<const char *>(vec[i].iov_base), vec[i].iov_len, owner});
+        total += vec[i].iov_len;
+    }
+    FLUENT_LOG_DEBUG(simpleInfo(), "tries to writev", total, "bytes");
+    ssize_t released = 0;
+    if(idle && total) {
+        // fast path: one writev/sendmsg
+        released = flush();
+        FLUENT_LOG_DEBUG(simpleInfo(), "-->", "(stream length)", released);
+    }
+    if(released == ssize_t(total)) {
+        return Completion{Completion::FAST_COMPLETE, this, looper};
+    }
+    return enqueueCompletion(total - released);
+#endif
+}
+
+inline Context::Completion Context::send(std::shared_ptr<const std::string> str) {
+    iovec vec {const_cast<char*>(str->data()), str->size()};
+    return sendv(&vec, 1, std::move(str));
+}
+
+inline void Context::setZeroCopy(bool on) {
+    if(!on && !_zeroCopy) return;
+    socket.setZeroCopy(on);
+    if(!_zeroCopy) _zeroCopy = std::make_unique<ZeroCopy>();
+    _zeroCopy->enabled = on;
+}
+
+inline Context::Completion Context::sendAppended(size_t n) {
+    if(_nState == NetworkState::DISCONNECTING || _nState == NetworkState::DISCONNECTED) {
+        return Completion{Completion::INVALID, this, looper};
+    }
+    if(n == 0) {
+        return Completion{Completion::FAST_COMPLETE, this, looper};
+    }
+#ifdef FLUENT_FLAG_IO_URING
+    return enqueueCompletion(n);
+#else
+    bool idle = _sendQueue.empty();
+    _sendQueueCopied += n;
+    if(!idle && !_sendQueue.back().base) {
+        _sendQueue.back().length += n;
+    } else {
+        _sendQueue.push_back({nullptr, n, nullptr});
+    }
+    ssize_t released = idle ? flush() : 0;
+    if(released == ssize_t(n)) {
+        return Completion{Completion::FAST_COMPLETE, this, looper};
+    }
+    return enqueueCompletion(n - released);
+#endif
+}
+
+inline void Context::enqueueCopy(const char *buf, size_t n) {
+    output.append(buf, n);
+#ifndef FLUENT_FLAG_IO_URING
+    _sendQueueCopied += n;
+    if(!_sendQueue.empty() && !_sendQueue.back().base) {
+        _sendQueue.back().length += n;
+    } else {
+        _sendQueue.push_back({nullptr, n, nullptr});
+    }
+#endif
+}
+
+inline Context::Completion Context::enqueueCompletion(size_t pending) {
+    size_t sendToken = _sendCompletions.push(pending, _sendCurrentIndex, _sendCompletedIndex);
+    if(sendToken == _sendCurrentIndex) _sendCurrentIndex++;
+    // pinned only (MSG_ZEROCOPY) does not require write event
+#ifndef FLUENT_FLAG_IO_URING
+    if(_sendQueue.empty()) {
+        return Completion{sendToken, this, looper};
+    }
+#endif
+    if(!(_events & EVENT_WRITE)) {
+        _events |= EVENT_WRITE;
+        // TODO remove this ugly code, use handler when any callback
+        auto hint = updateEventState();
+        // edge-triggered: always armed
+        if(hint != EPOLL_CTL_NONE) updateMultiplexer(hint);
+        // will disable write when send queue is empty (handleWrite)
+    }
+    return Completion{sendToken, this, looper};
+}
+
+inline ssize_t Context::flush() {
+    bool more;
+    ssize_t released = flushBatch(more);
+    // edge-triggered: a batch cut by BATCH (or a MSG_ZEROCOPY boundary) leaves the socket writable,
+    // no edge would come for the rest
+    while(EDGE_TRIGGERED && more) released += flushBatch(more);
+    return released;
+}
+
+inline ssize_t Context::flushBatch(bool &more) {
+    more = false;
+    // appended to output directly by user
+    if(output.unread() > ssize_t(_sendQueueCopied)) {
+        size_t extra = output.unread() - _sendQueueCopied;
+        _sendQueueCopied += extra;
+        if(!_sendQueue.empty() && !_sendQueue.back().base) {
+            _sendQueue.back().length += extra;
+        } else {
+            _sendQueue.push_back({nullptr, extra, nullptr});
+        }
+    }
+    if(_sendQueue.empty()) return 0;
+
+    constexpr size_t BATCH = 64;
+    iovec vec[BATCH];
+    size_t count = 0;
+    size_t bytes = 0;
+    // copied bytes in output are reusable after write, never send them by MSG_ZEROCOPY
+    bool referenced = _sendQueue.front().base != nullptr;
+    bool zeroCopyEnabled = this->zeroCopyEnabled();
+    // output bytes of the previous copied segments
+    size_t copied = 0;
+    for(size_t i = 0; i < _sendQueue.size() && count < BATCH; ++i) {
+        auto &segment = _sendQueue[i];
+        if(zeroCopyEnabled && (segment.base != nullptr) != referenced) break;
+        if(segment.base) {
+            vec[count++] = {const_cast<char*>(segment.base), segment.length};
+            bytes += segment.length;
+        } else {
+            // one view per slab if output is a ChainBuffer, may be cut by BATCH
+            size_t filled = output.peek(vec + count, BATCH - count, copied, segment.length);
+            for(size_t k = count; k < count + filled; ++k) bytes += vec[k].iov_len;
+            count += filled;
+            copied += segment.length;
+        }
+    }
+    bool zeroCopy = zeroCopyEnabled && referenced && bytes >= ZERO_COPY_THRESHOLD;
+
+    msghdr message {};
+    message.msg_iov = vec;
+    message.msg_iovlen = count;
+    ssize_t n = ::sendmsg(socket.fd(), &message, MSG_NOSIGNAL | (zeroCopy ? MSG_ZEROCOPY : 0));
+    if(n < 0) {
+        switch(errno) {
+            case EAGAIN:
+            case EINTR:
+            // MSG_ZEROCOPY: optmem limit
+            case ENOBUFS:
+                looper->metrics().add(Metrics::EAGAINS);
+                return 0;
+            default:
+                throw WriteException(errno);
+        }
+    }
+
+    if(n > 0) {
+        _lastWrite = looper->now();
+        looper->metrics().add(Metrics::WRITES);
+        looper->metrics().add(Metrics::WRITE_BYTES, n);
+    }
+    uint32_t sequence = zeroCopy ? _zeroCopy->sequence++ : SEQUENCE_NONE;
+    for(size_t remain = n; remain;) {
+        auto &segment = _sendQueue.front();
+        size_t length = std::min(remain, segment.length);
+        remain -= length;
+        if(segment.base) {
+            segment.base += length;
+        } else {
+            output.hasRead(length);
+            _sendQueueCopied -= length;
+        }
+        segment.length -= length;
+        if(zeroCopy && segment.owner) {
+            _zeroCopy->owners.emplace_back(sequence, segment.owner);
+        }
+        if(segment.length == 0) {
+            _sendQueue.pop_front();
+        }
+    }
+    more = size_t(n) == bytes && !_sendQueue.empty();
+    return release(sequence, n);
+}
+
+inline ssize_t Context::reapZeroCopy() {
+    bool notified = false;
+    char control[128];
+    for(;;) {
+        msghdr message {};
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        if(::recvmsg(socket.fd(), &message, MSG_ERRQUEUE) < 0) {
+            break;
+        }
+        for(cmsghdr *cm = CMSG_FIRSTHDR(&message); cm; cm = CMSG_NXTHDR(&message, cm)) {
+            if(cm->cmsg_level != SOL_IP || cm->cmsg_type != IP_RECVERR) continue;
+            auto error = reinterpret_cast<sock_extended_err*>(CMSG_DATA(cm));
+            if(error->ee_origin != SO_EE_ORIGIN_ZEROCOPY || error->ee_errno != 0) continue;
+            notified = true;
+            // [lo, hi]
+            uint32_t lo = error->ee_info, hi = error->ee_data;
+            for(auto &pinned : _zeroCopy->pinned) {
+                if(pinned.sequence != SEQUENCE_NONE && pinned.sequence - lo <= hi - lo) {
+                    pinned.sequence = SEQUENCE_NONE;
+                }
+            }
+            auto &owners = _zeroCopy->owners;
+            while(!owners.empty() && owners.front().first - lo <= hi - lo) {
+                owners.pop_front();
+            }
         }
-        return Completion{sendToken, this};
     }
-    return Completion{Completion::INVALID, this};
+    if(!notified) return -1;
+    return release(SEQUENCE_NONE, 0);
+}
+
+inline size_t Context::release(uint32_t sequence, size_t length) {
+    // fast path: nothing pinned
+    if(sequence == SEQUENCE_NONE && (!_zeroCopy || _zeroCopy->pinned.empty())) {
+        return length;
+    }
+    auto &pinned = _zeroCopy->pinned;
+    if(length) {
+        pinned.push_back({sequence, length});
+    }
+    size_t released = 0;
+    while(!pinned.empty() && pinned.front().sequence == SEQUENCE_NONE) {
+        released += pinned.front().length;
+        pinned.pop_front();
+    }
+    return released;
+}
+
+inline ContextBuffer Context::makeBuffer([[maybe_unused]] Looper *looper) {
+#if defined(FLUENT_FLAG_CHAIN_BUFFER) && !defined(FLUENT_FLAG_IO_URING)
+    return ContextBuffer{&looper->slabs()};
+#else
+    return ContextBuffer{};
+#endif
+}
+
+inline void Context::reset(Looper *looper, const InetAddress &address, Socket &&socket) {
+    // stale timers are ignored by generation, but they are still in the wheel
+    for(auto &t : _timeouts) {
+        if(t.armed) this->looper->cancel(t.timer);
+    }
+    this->looper = looper;
+    this->address = address;
+    // the previous fd is closed here, as ~Context() did
+    this->socket = std::move(socket);
+    // drop the rest, a large Buffer shrinks (see Buffer::reuseIfPossible())
+    input.hasRead(input.unread());
+    output.hasRead(output.unread());
+    exception = nullptr;
+    Object().swap(any);
+    static_cast<NetworksPolicy&>(*this) = NetworksPolicy{};
+    static_cast<LifecyclePolicy&>(*this) = LifecyclePolicy{};
+    static_cast<SendPolicy&>(*this) = SendPolicy{};
+    MultiplexerPolicy::reset();
+    static_cast<TimeoutPolicy&>(*this) = TimeoutPolicy{};
+    static_cast<AwaitPolicy&>(*this) = AwaitPolicy{};
+    _deferRead = nullptr;
+    _handler = nullptr;
+    _hashcode = 0;
+    _cachedInfo.clear();
+}
+
+inline void Context::reset(Looper *looper, const InetAddress &address, Socket &&socket, EnableLifecycle) {
+    reset(looper, address, std::move(socket));
+    ensureLifecycle();
+}
+
+inline void Context::setIdleTimeout(std::chrono::milliseconds timeout) {
+    setTimeout(TIMEOUT_IDLE, timeout);
+}
+
+inline void Context::setReadDeadline(std::chrono::milliseconds timeout) {
+    setTimeout(TIMEOUT_READ, timeout);
+}
+
+inline void Context::setWriteDeadline(std::chrono::milliseconds timeout) {
+    setTimeout(TIMEOUT_WRITE, timeout);
+}
+
+inline void Context::forceClose() {
+    if(_nState == NetworkState::CONNECTED || _nState == NetworkState::DISCONNECTING) {
+        FLUENT_LOG_INFO(simpleInfo(), "force close");
+        ::shutdown(socket.fd(), SHUT_RDWR);
+    }
+}
+
+inline void Context::setTimeout(TimeoutKind kind, std::chrono::milliseconds timeout) {
+    auto &t = _timeouts[kind];
+    if(t.armed) {
+        looper->cancel(t.timer);
+        t.armed = false;
+    }
+    t.duration = timeout;
+    if(timeout.count() <= 0) return;
+    // the reference point, lastActive() may be older
+    auto current = TimerClock::now();
+    t.deadline = current + timeout;
+    armTimeout(kind, t.deadline);
+}
+
+inline void Context::armTimeout(TimeoutKind kind, TimerPoint when) {
+    auto &t = _timeouts[kind];
+    // pool slot is stable, generation tells if it is still this connection
+    t.timer = looper->runAt(when, [this, generation = _generation, kind] {
+        if(_generation != generation) return;
+        _timeouts[kind].armed = false;
+        handleTimeout(kind);
+    });
+    t.armed = true;
+}
+
+inline void Context::handleTimeout(TimeoutKind kind) {
+    if(_nState != NetworkState::CONNECTED && _nState != NetworkState::DISCONNECTING) return;
+    auto &t = _timeouts[kind];
+    auto since = t.deadline - t.duration;
+    switch(kind) {
+        case TIMEOUT_IDLE: {
+            // lazy re-arm, no timer update for each read / write
+            auto expire = std::max(lastActive(), since) + t.duration;
+            if(looper->now() < expire) {
+                t.deadline = expire;
+                armTimeout(kind, expire);
+                return;
+            }
+            FLUENT_LOG_INFO(simpleInfo(), "idle timeout");
+        }
+        break;
+        case TIMEOUT_READ:
+            if(_lastRead > since) return;
+            FLUENT_LOG_INFO(simpleInfo(), "read timeout");
+        break;
+        case TIMEOUT_WRITE:
+            // write event is disabled when the send queue is flushed
+            if(!(_events & EVENT_WRITE)) return;
+            FLUENT_LOG_INFO(simpleInfo(), "write timeout");
+        break;
+        default:
+            return;
+    }
+    forceClose();
 }
 
 inline uint64_t Context::hashcode() const {
@@ -215,4 +700,9 @@ inline const std::string& Context::simpleInfo() const {
 }
 
 } // fluent
-#endif
\ No newline at end of file
+
+#ifdef __cpp_impl_coroutine
+// awaiters need the complete context
+#include "../coroutine/Awaiters.h"
+#endif
+#endif
@@ -8,11 +8,23 @@
 #include "Context.h"
 namespace fluent {
 
+// tag class
+// the multiplexer is owned by a single reactor (poll and handle in the same thread)
+class Exclusive {};
+
+} // fluent
+
+#ifdef FLUENT_FLAG_IO_URING
+// completion backend, chosen at compile time
+#include "UringMultiplexer.h"
+#else
+namespace fluent {
+
 // no any looper?
 class Multiplexer {
 public:
     using Token = size_t;
-    // must be pointer (epoll_event.data.ptr)
+    // must be pointer (epoll_event.data, see makeEvent())
     using Bundle = std::pair<Token, Context>*;
 public:
     void poll(std::chrono::milliseconds timeout);
@@ -21,22 +33,73 @@ public:
 
     void update(int operation, Bundle bundle);
 
+    // non-blocking connect of a CONNECTING context
+    // the result is a write event (POLLOUT, or with POLLERR / POLLHUP if failed)
+    void connect(Bundle bundle);
+    // give up the connect of a CONNECTING context, no event is reported after that
+    void cancelConnect(Bundle bundle);
+
     Token token();
 
     std::vector<epoll_event>& visit(Token token);
 
+    // swap out the events of token
+    // lock-free if exclusive
+    void exchange(Token token, std::vector<epoll_event> &events);
+
+    bool exclusive() const { return _exclusive; }
+
+    // listen fd only wakes up the blocking poll, accept is done by acceptor
+    // FLUENT_FLAG_EPOLL_EXCLUSIVE: EPOLLEXCLUSIVE, a listen fd shared by many multiplexers
+    // wakes up one of them instead of all (thundering herd)
+    void listen(Token, int listenFd) { watch(listenFd, LISTEN_EVENTS); }
+    // backpressure, stop waking up on the listen fd
+    void setListening(Token token, int listenFd, bool on);
+    // readable fd wakes up the blocking poll, no event is dispatched
+    // e.g. looper inbox doorbell
+    // edge-triggered: nobody reads it here, a level-triggered fd left readable
+    // (doorbell rung after the inbox was drained) would make poll() spin
+    void watch(int fd) { watch(fd, EPOLLIN | EPOLLET); }
+
+    // I/O of a ready context
+    // readiness model: do the syscall here
+    ssize_t readFrom(Bundle bundle);
+    ssize_t writeTo(Bundle bundle);
+    // send queue has been written to the socket
+    bool flushed(Bundle bundle) const;
+
+    // registered events of a context
+    // edge-triggered: read and write are always armed, see MultiplexerPolicy::EDGE_TRIGGERED
+    static uint32_t interestOf(uint32_t events);
+    // epoll_event.data = generation(16) | pointer(48)
+    static epoll_event makeEvent(uint32_t events, Bundle bundle);
+    // return: nullptr if the slot has been reused
+    static Bundle bundleOf(const epoll_event &event);
+
     Multiplexer();
+    explicit Multiplexer(Exclusive);
     ~Multiplexer() { ::close(_epollFd); }
     Multiplexer(const Multiplexer&) = delete;
     Multiplexer(Multiplexer&&) = default;
     Multiplexer& operator=(const Multiplexer&) = delete;
     Multiplexer& operator=(Multiplexer&&) = default;
 
+private:
+    constexpr static uint64_t WAKEUP_DATA = 0;
+#ifdef FLUENT_FLAG_EPOLL_EXCLUSIVE
+    constexpr static uint32_t LISTEN_EVENTS = EPOLLIN | EPOLLEXCLUSIVE;
+#else
+    constexpr static uint32_t LISTEN_EVENTS = EPOLLIN;
+#endif
+
+    void watch(int fd, uint32_t events);
+
 private:
     int _epollFd;
     std::vector<epoll_event> _events;
     std::vector<std::vector<epoll_event>> _evnetVectors;
     Token _token {0};
+    bool _exclusive {false};
 public:
     std::mutex _mutex;
 };
@@ -47,31 +110,126 @@ inline void Multiplexer::poll(std::chrono::milliseconds timeout) {
         if(errno == EINTR) return;
         throw EpollWaitException(errno);
     }
-    std::lock_guard<std::mutex> _{_mutex};
-    dispatchActiveContext(count);
+    if(_exclusive) {
+        dispatchActiveContext(count);
+    } else {
+        std::lock_guard<std::mutex> _{_mutex};
+        dispatchActiveContext(count);
+    }
     if(_events.size() == count) {
-        _events.reserve(_events.size() << 1);
+        _events.resize(_events.size() << 1);
     }
 }
 
 inline void Multiplexer::dispatchActiveContext(int count) {
     for(int i = 0; i < count; ++i) {
-        size_t index = static_cast<std::pair<Token, Context>*>(_events[i].data.ptr)->first;
-        _evnetVectors[index].emplace_back(_events[i]);
+        // watched fd
+        if(_events[i].data.u64 == WAKEUP_DATA) continue;
+        Bundle bundle = bundleOf(_events[i]);
+        if(bundle) {
+            _evnetVectors[bundle->first].emplace_back(_events[i]);
+        }
     }
 }
 
 inline void Multiplexer::update(int operation, Bundle bundle) {
     auto context = &bundle->second;
     int fd = context->fd();
-    uint32_t events = context->events();
-    epoll_event event {events, bundle};
+    uint32_t events = interestOf(context->events());
+    context->looper->metrics().add(Metrics::EPOLL_CTLS);
+    epoll_event event = makeEvent(events, bundle);
     if(::epoll_ctl(_epollFd, operation, fd, &event)) {
         // caught by handler
         throw EpollControlException(errno);
     }
 }
 
+inline void Multiplexer::connect(Bundle bundle) {
+    auto context = &bundle->second;
+    // EINPROGRESS, an unconnected socket is reported as POLLHUP anyway
+    context->socket.connect(context->address);
+    epoll_event event = makeEvent(interestOf(EPOLLOUT), bundle);
+    context->looper->metrics().add(Metrics::EPOLL_CTLS);
+    if(::epoll_ctl(_epollFd, EPOLL_CTL_ADD, context->fd(), &event)) {
+        throw EpollControlException(errno);
+    }
+    // handler modifies it to the read event when connected (edge-triggered: unchanged)
+    context->_eState = MultiplexerPolicy::EventState::ADDED;
+}
+
+inline void Multiplexer::cancelConnect(Bundle bundle) {
+    auto context = &bundle->second;
+    // closing fd also removes it from epoll
+    Socket(Socket::INVALID_FD).swap(context->socket);
+    context->_eState = MultiplexerPolicy::EventState::NEW;
+}
+
+inline ssize_t Multiplexer::readFrom(Bundle bundle) {
+    auto context = &bundle->second;
+    ssize_t n = context->input.readFrom(context->socket.fd());
+    auto &metrics = context->looper->metrics();
+    if(n > 0) {
+        metrics.add(Metrics::READS);
+        metrics.add(Metrics::READ_BYTES, n);
+    } else if(n < 0 && errno == EAGAIN) {
+        metrics.add(Metrics::EAGAINS);
+    }
+    return n;
+}
+
+inline ssize_t Multiplexer::writeTo(Bundle bundle) {
+    return bundle->second.flush();
+}
+
+inline bool Multiplexer::flushed(Bundle bundle) const {
+    auto context = &bundle->second;
+    return context->_sendQueue.empty() && context->output.unread() == 0;
+}
+
+inline uint32_t Multiplexer::interestOf(uint32_t events) {
+    if(!MultiplexerPolicy::EDGE_TRIGGERED) return events;
+    return MultiplexerPolicy::EVENT_READ | MultiplexerPolicy::EVENT_WRITE | EPOLLET;
+}
+
+inline epoll_event Multiplexer::makeEvent(uint32_t events, Bundle bundle) {
+    epoll_event event;
+    event.events = events;
+    event.data.u64 = reinterpret_cast<uint64_t>(bundle)
+        | (static_cast<uint64_t>(bundle->second._generation) << 48);
+    return event;
+}
+
+inline Multiplexer::Bundle Multiplexer::bundleOf(const epoll_event &event) {
+    auto bundle = reinterpret_cast<Bundle>(event.data.u64 & ((uint64_t(1) << 48) - 1));
+    uint16_t generation = event.data.u64 >> 48;
+    return bundle->second._generation == generation ? bundle : nullptr;
+}
+
+inline void Multiplexer::watch(int fd, uint32_t events) {
+    epoll_event event;
+    event.events = events;
+    event.data.u64 = WAKEUP_DATA;
+    if(::epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &event)) {
+        throw EpollControlException(errno);
+    }
+}
+
+inline void Multiplexer::setListening(Token, int listenFd, bool on) {
+    epoll_event event;
+    event.data.u64 = WAKEUP_DATA;
+#ifdef FLUENT_FLAG_EPOLL_EXCLUSIVE
+    // EPOLLEXCLUSIVE cannot be modified, remove and add it again
+    event.events = LISTEN_EVENTS;
+    int operation = on ? EPOLL_CTL_ADD : EPOLL_CTL_DEL;
+#else
+    event.events = on ? uint32_t(EPOLLIN) : 0;
+    int operation = EPOLL_CTL_MOD;
+#endif
+    if(::epoll_ctl(_epollFd, operation, listenFd, &event)) {
+        throw EpollControlException(errno);
+    }
+}
+
 inline Multiplexer::Token Multiplexer::token() {
     std::lock_guard<std::mutex> _{_mutex};
     _evnetVectors.emplace_back();
@@ -82,6 +240,15 @@ inline std::vector<epoll_event>& Multiplexer::visit(Token token) {
     return _evnetVectors[token];
 }
 
+inline void Multiplexer::exchange(Token token, std::vector<epoll_event> &events) {
+    if(_exclusive) {
+        std::swap(_evnetVectors[token], events);
+        return;
+    }
+    std::lock_guard<std::mutex> _{_mutex};
+    std::swap(_evnetVectors[token], events);
+}
+
 inline Multiplexer::Multiplexer()
     : _epollFd(::epoll_create1(EPOLL_CLOEXEC)),
       _events(16) {
@@ -90,9 +257,15 @@ inline Multiplexer::Multiplexer()
     }
 }
 
+inline Multiplexer::Multiplexer(Exclusive)
+    : Multiplexer() {
+    _exclusive = true;
+}
+
 inline void Context::updateMultiplexer(Context::EpollOperationHint hint) {
     _multiplexer->update(hint, _bundle);
 }
 
-}
+} // fluent
+#endif // FLUENT_FLAG_IO_URING
 #endif
\ No newline at end of file
@@ -1,72 +1,153 @@
 #ifndef __FLUENT_NETWORK_POOL_H__
 #define __FLUENT_NETWORK_POOL_H__
 #include <bits/stdc++.h>
-#include "../utils/WeakReference.h"
 #include "Multiplexer.h"
 #include "Context.h"
 namespace fluent {
 
-class Pool: private WeakReference<Pool> {
+// connection slab
+// contexts live in cache-aligned slots of fixed-size chunks, never moved or freed until ~Pool
+// so bundle pointer is safe in epoll_event / user_data / futures
+// closed contexts are retired by handler, and reused in O(1) when reusable
+// a reused context is reset in place, its buffers keep their memory
+// each reuse bumps the slot generation, multiplexer tags it to the event
+class Pool {
 public:
-    // unique_ptr makes Context pointer safe in vector rescale and std::swap
-    // token can be accessible in global(server group) multiplexer
     using BundleValueType = std::pair<Multiplexer::Token, Context>;
-    using Container = std::vector<std::unique_ptr<BundleValueType>>;
 
-    constexpr static size_t GC_THRESHOLD = 16;
-    constexpr static size_t PREFETCH = 16;
+    constexpr static size_t CHUNK_SIZE = 64;
+    // retired slots checked in a single emplace
+    constexpr static size_t RETIRED_STEP = 2;
+
+    struct Stats {
+        size_t live;
+        size_t free;
+        size_t highWater;
+        size_t capacity;
+        // closed but not yet reused, included in live
+        size_t retired;
+    };
 
 public:
     // return a bundle for two phase construction
     template <typename ...ContextArgs>
     Multiplexer::Bundle emplace(Multiplexer::Token token, ContextArgs &&...args);
 
+    // closed by handler, side effect: .clear()
+    void retire(std::vector<Multiplexer::Bundle> &bundles);
+
+    Stats stats() const;
+
+    Pool() = default;
+    ~Pool();
+    Pool(const Pool&) = delete;
+    Pool(Pool&&) = default;
+    Pool& operator=(const Pool&) = delete;
+    Pool& operator=(Pool&&) = default;
+
 private:
-    Container _container {PREFETCH};
+    struct alignas(64) Slot {
+        alignas(BundleValueType) unsigned char storage[sizeof(BundleValueType)];
+        Slot *next;
+        uint16_t generation;
+        bool constructed;
+
+        BundleValueType* value() { return reinterpret_cast<BundleValueType*>(storage); }
+    };
+
+    static Slot* slotOf(Multiplexer::Bundle bundle) { return reinterpret_cast<Slot*>(bundle); }
+
+    Slot* allocate();
+    bool isReusable(Slot *slot);
+    void destroy(Slot *slot);
 
-// CRTP interface
 private:
-    using GcBase = WeakReference<Pool>;
-    friend class WeakReference<Pool>;
-
-    // global
-    bool isReusable();
-    // connection
-    bool isReusable(size_t index);
-    // access
-    Container::reference get(size_t index);
+    std::vector<std::unique_ptr<Slot[]>> _chunks;
+    // never constructed or destroyed
+    Slot *_free {nullptr};
+    // closed, but may be held by lifecycle or in-flight io
+    std::deque<Slot*> _retired;
+    size_t _live {0};
+    size_t _highWater {0};
 };
 
 template <typename ...ContextArgs>
 inline Multiplexer::Bundle Pool::emplace(Multiplexer::Token token, ContextArgs &&...args) {
-    if(_container.size() > GC_THRESHOLD) GcBase::updateReusableIndex();
-    auto connection = std::make_unique<BundleValueType>(token, Context(std::forward<ContextArgs>(args)...));
-    if(isReusable() && isReusable(GcBase::_reusableIndex)) {
-        size_t pos = GcBase::_reusableIndex++;
-        _container[pos] = std::move(connection);
-        return _container[pos].get();
+    Slot *slot = allocate();
+    auto bundle = slot->value();
+    if(slot->constructed) {
+        bundle->first = token;
+        bundle->second.reset(std::forward<ContextArgs>(args)...);
+    } else {
+        new (slot->storage) BundleValueType(std::piecewise_construct,
+            std::forward_as_tuple(token), std::forward_as_tuple(std::forward<ContextArgs>(args)...));
+        slot->constructed = true;
     }
-    _container.emplace_back(std::move(connection));
-    return _container.back().get();
+    // events, timers and send completions of the previous connection are stale
+    bundle->second._generation = bundle->second._sendGeneration = ++slot->generation;
+    _highWater = std::max(_highWater, ++_live);
+    return bundle;
 }
 
-inline bool Pool::isReusable() {
-    return GcBase::_reusableIndex != _container.size();
+inline void Pool::retire(std::vector<Multiplexer::Bundle> &bundles) {
+    for(auto bundle : bundles) {
+        _retired.emplace_back(slotOf(bundle));
+    }
+    bundles.clear();
+}
+
+inline Pool::Stats Pool::stats() const {
+    size_t capacity = _chunks.size() * CHUNK_SIZE;
+    return Stats {_live, capacity - _live, _highWater, capacity, _retired.size()};
+}
+
+inline Pool::~Pool() {
+    for(auto &chunk : _chunks) {
+        for(size_t i = 0; i < CHUNK_SIZE; ++i) {
+            if(chunk[i].constructed) destroy(&chunk[i]);
+        }
+    }
+}
+
+inline Pool::Slot* Pool::allocate() {
+    for(size_t step = 0; step < RETIRED_STEP && !_retired.empty(); ++step) {
+        Slot *slot = _retired.front();
+        _retired.pop_front();
+        if(isReusable(slot)) {
+            --_live;
+            return slot;
+        }
+        // still in use, check it later
+        _retired.emplace_back(slot);
+    }
+    if(!_free) {
+        auto chunk = std::make_unique<Slot[]>(CHUNK_SIZE);
+        for(size_t i = CHUNK_SIZE; i--;) {
+            chunk[i].next = _free;
+            chunk[i].generation = 0;
+            chunk[i].constructed = false;
+            _free = &chunk[i];
+        }
+        _chunks.emplace_back(std::move(chunk));
+    }
+    Slot *slot = _free;
+    _free = slot->next;
+    return slot;
 }
 
-inline bool Pool::isReusable(size_t index) {
-    auto &connection = _container[index];
-    if(connection == nullptr) return true;
-    auto &context = connection->second;
+inline bool Pool::isReusable(Slot *slot) {
+    auto &context = slot->value()->second;
     if(!context.isDisConnected()) return false;
+    if(context.ioPending()) return false;
     const StrongLifecycle& lifecycle = context.getLifecycle();
     // lifecycle disabled or no strong guard
     return lifecycle == nullptr || lifecycle.use_count() <= 1;
 }
 
-inline Pool::Container::reference Pool::get(size_t index) {
-    return _container[index];
+inline void Pool::destroy(Slot *slot) {
+    slot->value()->~BundleValueType();
+    slot->constructed = false;
 }
 
 } // fluent
-#endif
\ No newline at end of file
+#endif
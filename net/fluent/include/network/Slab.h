@@ -0,0 +1,93 @@
+#ifndef __FLUENT_NETWORK_SLAB_H__
+#define __FLUENT_NETWORK_SLAB_H__
+#include <bits/stdc++.h>
+namespace fluent {
+
+// memory block linked by ChainBuffer, the bytes follow the header
+// page-sized by default, a larger one is made only to pull up a long message
+struct Slab {
+    constexpr static size_t SIZE = 4096;
+    constexpr static size_t HEADER = sizeof(void*) + 4 * sizeof(uint32_t);
+    constexpr static size_t CAPACITY = SIZE - HEADER;
+
+    Slab *next;
+    uint32_t r, w; // r <= w <= capacity
+    uint32_t capacity;
+    uint32_t reserved;
+
+    char* data() { return reinterpret_cast<char*>(this) + HEADER; }
+    const char* data() const { return reinterpret_cast<const char*>(this) + HEADER; }
+    size_t unread() const { return w - r; }
+    size_t unwrite() const { return capacity - w; }
+};
+
+static_assert(sizeof(Slab) == Slab::HEADER, "bytes should follow the header");
+
+// free list of page-sized slabs
+// one pool per looper (see Looper::slabs()), not thread-safe
+class SlabPool {
+public:
+    // capacity > Slab::CAPACITY: a large slab from the global allocator, never cached
+    Slab* allocate(size_t capacity = Slab::CAPACITY);
+    void deallocate(Slab *slab);
+
+    // cached free slabs
+    size_t cached() const { return _cached; }
+    // slabs held by buffers
+    size_t used() const { return _used; }
+    // free slabs over limit are returned to the system
+    void setLimit(size_t limit) { _limit = limit; trim(limit); }
+    void trim(size_t keep = 0);
+
+    SlabPool(size_t limit = 1024): _limit(limit) {}
+    ~SlabPool() { trim(); }
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+private:
+    Slab *_free {nullptr};
+    size_t _cached {0};
+    size_t _used {0};
+    size_t _limit;
+};
+
+inline Slab* SlabPool::allocate(size_t capacity) {
+    Slab *slab;
+    capacity = std::max(capacity, Slab::CAPACITY);
+    if(capacity == Slab::CAPACITY && _free) {
+        slab = _free;
+        _free = slab->next;
+        --_cached;
+    } else {
+        // no value-initialization
+        slab = static_cast<Slab*>(::operator new(Slab::HEADER + capacity));
+    }
+    slab->next = nullptr;
+    slab->r = slab->w = 0;
+    slab->capacity = capacity;
+    ++_used;
+    return slab;
+}
+
+inline void SlabPool::deallocate(Slab *slab) {
+    --_used;
+    if(slab->capacity != Slab::CAPACITY || _cached >= _limit) {
+        ::operator delete(slab);
+        return;
+    }
+    slab->next = _free;
+    _free = slab;
+    ++_cached;
+}
+
+inline void SlabPool::trim(size_t keep) {
+    while(_cached > keep) {
+        Slab *slab = _free;
+        _free = slab->next;
+        --_cached;
+        ::operator delete(slab);
+    }
+}
+
+} // fluent
+#endif
@@ -27,6 +27,7 @@ public:
     void setReuseAddr(bool on = true);
     void setReusePort(bool on = true);
     void setKeepAlive(bool on = true);
+    void setZeroCopy(bool on = true);
     void setBlock();
     void setNonBlock();
 
@@ -118,6 +119,13 @@ inline void Socket::setKeepAlive(bool on) {
     }
 }
 
+inline void Socket::setZeroCopy(bool on) {
+    int optval = on;
+    if(::setsockopt(_socketFd, SOL_SOCKET, SO_ZEROCOPY, &optval,
+            static_cast<socklen_t>(sizeof optval))) {
+        throw SocketException(errno);
+    }
+}
 
 inline void Socket::setBlock() {
     int flags = ::fcntl(_socketFd, F_GETFL, 0);
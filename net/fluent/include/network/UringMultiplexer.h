@@ -0,0 +1,558 @@
+#ifndef __FLUENT_NETWORK_URING_MULTIPLEXER_H__
+#define __FLUENT_NETWORK_URING_MULTIPLEXER_H__
+#include <unistd.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <liburing.h>
+#include <bits/stdc++.h>
+#include "../throws/Exceptions.h"
+#include "../logger/Logger.h"
+#include "Context.h"
+namespace fluent {
+
+// io_uring (completion) backend
+// enabled by FLUENT_FLAG_IO_URING, the interface is the same as the epoll one
+//
+// - recv: multishot recv with a provided buffer ring (shared by all contexts)
+//         completed data is appended to context->input, then handler reports POLLIN
+// - send: output is swapped to _sendingBuffer and submitted as a send sqe
+//         handler reports POLLOUT when completed
+// - accept: a few single-shot accepts in flight per listener, each with its own address buffer
+//           results (fd and peer address) can be fetched by exchangeAccepted()
+// - connect: connect sqe, handler reports POLLOUT (or with POLLERR / POLLHUP) when completed
+//
+// readFrom()/writeTo() return the completed bytes instead of doing the syscall
+class Multiplexer {
+public:
+    using Token = size_t;
+    // must be pointer (user_data)
+    using Bundle = std::pair<Token, Context>*;
+
+    constexpr static unsigned ENTRIES = 1024;
+    // provided buffers, shared by all contexts
+    constexpr static unsigned BUFFER_RING_SIZE = 1024; // power of two
+    constexpr static unsigned BUFFER_SIZE = 4096;
+    constexpr static int BUFFER_GROUP = 0;
+    // single-shot accepts in flight per listener
+    // not multishot: it writes every peer address to the same buffer
+    constexpr static unsigned ACCEPT_DEPTH = 8;
+
+    // accepted fd and its peer address
+    using Accepted = std::pair<int, InetAddress>;
+
+public:
+    void poll(std::chrono::milliseconds timeout);
+
+    void dispatchActiveContext(io_uring_cqe *cqe);
+
+    void update(int operation, Bundle bundle);
+
+    // non-blocking connect of a CONNECTING context
+    // the result is a write event (POLLOUT, or with POLLERR / POLLHUP if failed)
+    void connect(Bundle bundle);
+    // give up the connect of a CONNECTING context, no event is reported after that
+    // an in-flight connect sqe is cancelled, the slot is reusable after it completes
+    void cancelConnect(Bundle bundle);
+
+    Token token();
+
+    std::vector<epoll_event>& visit(Token token);
+
+    // swap out the events of token
+    // lock-free if exclusive
+    void exchange(Token token, std::vector<epoll_event> &events);
+
+    bool exclusive() const { return _exclusive; }
+
+    // completion model: return completed bytes
+    // or -1 (errno = EAGAIN) if nothing completed
+    ssize_t readFrom(Bundle bundle);
+    ssize_t writeTo(Bundle bundle);
+    // output has been written to the socket
+    bool flushed(Bundle bundle) const;
+
+    // epoll_event.data = generation(16) | pointer(48)
+    static epoll_event makeEvent(uint32_t events, Bundle bundle);
+    // return: nullptr if the slot has been reused
+    static Bundle bundleOf(const epoll_event &event);
+
+    // submit accepts on listenFd
+    void listen(Token token, int listenFd);
+    // swap out the accepted fds of token
+    void exchangeAccepted(Token token, std::vector<Accepted> &accepted);
+    // backpressure, cancel / resubmit the accepts
+    void setListening(Token token, int listenFd, bool on);
+    // readable fd wakes up the blocking poll (multishot poll), no event is dispatched
+    // e.g. looper inbox doorbell
+    void watch(int fd);
+
+    Multiplexer();
+    explicit Multiplexer(Exclusive);
+    ~Multiplexer();
+    Multiplexer(const Multiplexer&) = delete;
+    Multiplexer(Multiplexer&&) = delete;
+    Multiplexer& operator=(const Multiplexer&) = delete;
+    Multiplexer& operator=(Multiplexer&&) = delete;
+
+private:
+    // user_data = pointer | operation
+    // pointers are aligned to 8 bytes
+    enum Operation: uint64_t {
+        OP_ACCEPT = 0,
+        OP_RECV   = 1,
+        OP_SEND   = 2,
+        OP_CANCEL = 3,
+        OP_WAKEUP = 4,
+        // no handling, e.g. cancel of accept
+        OP_NONE   = 5,
+        OP_CONNECT = 6,
+    };
+    constexpr static uint64_t OP_MASK = 7;
+
+    struct Listener;
+
+    // user_data of an accept, the kernel writes the peer address here
+    struct alignas(8) AcceptSlot {
+        Listener *listener;
+        InetAddress address;
+        socklen_t length;
+        // in-flight
+        bool armed;
+    };
+
+    struct Listener {
+        Token token;
+        int fd;
+        bool paused;
+        std::array<AcceptSlot, ACCEPT_DEPTH> slots;
+    };
+
+    struct alignas(8) Watcher {
+        int fd;
+    };
+
+    static uint64_t pack(void *pointer, Operation op) { return reinterpret_cast<uint64_t>(pointer) | op; }
+    static void* unpackPointer(uint64_t userData) { return reinterpret_cast<void*>(userData & ~OP_MASK); }
+    static Operation unpackOperation(uint64_t userData) { return static_cast<Operation>(userData & OP_MASK); }
+
+    io_uring_sqe* acquire();
+    void submitAccept(AcceptSlot *slot);
+    void submitRecv(Bundle bundle);
+    void submitSend(Bundle bundle);
+    void submitCancel(Bundle bundle);
+    void submitWakeup(Watcher *watcher);
+
+    void handleAccept(AcceptSlot *slot, io_uring_cqe *cqe);
+    void handleRecv(Bundle bundle, io_uring_cqe *cqe);
+    void handleSend(Bundle bundle, io_uring_cqe *cqe);
+    void handleConnect(Bundle bundle, io_uring_cqe *cqe);
+
+    void pushEvent(Bundle bundle, uint32_t events);
+    void recycle(unsigned short bid);
+
+private:
+    io_uring _uring;
+    io_uring_buf_ring *_bufferRing {nullptr};
+    std::vector<char> _bufferPool;
+    // recycled in this batch
+    int _recycled {0};
+
+    std::vector<std::vector<epoll_event>> _evnetVectors;
+    std::vector<std::vector<Accepted>> _acceptedVectors;
+    // address stable
+    std::deque<Listener> _listeners;
+    std::deque<Watcher> _watchers;
+    Token _token {0};
+    bool _exclusive {false};
+public:
+    std::mutex _mutex;
+};
+
+inline void Multiplexer::poll(std::chrono::milliseconds timeout) {
+    int ret;
+    if(timeout.count() > 0) {
+        io_uring_cqe *cqe;
+        __kernel_timespec ts;
+        ts.tv_sec = timeout.count() / 1000;
+        ts.tv_nsec = (timeout.count() % 1000) * 1000000;
+        ret = io_uring_submit_and_wait_timeout(&_uring, &cqe, 1, &ts, nullptr);
+    } else {
+        ret = io_uring_submit(&_uring);
+    }
+    if(ret < 0 && ret != -ETIME && ret != -EINTR && ret != -EBUSY) {
+        throw UringException(-ret);
+    }
+    io_uring_cqe *cqe;
+    unsigned head;
+    unsigned done = 0;
+    auto reap = [&] {
+        io_uring_for_each_cqe(&_uring, head, cqe) {
+            done++;
+            dispatchActiveContext(cqe);
+        }
+    };
+    if(_exclusive) {
+        reap();
+    } else {
+        std::lock_guard<std::mutex> _{_mutex};
+        reap();
+    }
+    if(done) {
+        io_uring_cq_advance(&_uring, done);
+    }
+    if(_recycled) {
+        io_uring_buf_ring_advance(_bufferRing, _recycled);
+        _recycled = 0;
+    }
+}
+
+inline void Multiplexer::dispatchActiveContext(io_uring_cqe *cqe) {
+    uint64_t userData = io_uring_cqe_get_data64(cqe);
+    void *pointer = unpackPointer(userData);
+    switch(unpackOperation(userData)) {
+        case OP_ACCEPT:
+            handleAccept(static_cast<AcceptSlot*>(pointer), cqe);
+        break;
+        case OP_RECV:
+            handleRecv(static_cast<Bundle>(pointer), cqe);
+        break;
+        case OP_SEND:
+            handleSend(static_cast<Bundle>(pointer), cqe);
+        break;
+        case OP_CONNECT:
+            handleConnect(static_cast<Bundle>(pointer), cqe);
+        break;
+        case OP_CANCEL:
+            static_cast<Bundle>(pointer)->second._inflight--;
+        break;
+        case OP_NONE:
+        break;
+        case OP_WAKEUP:
+            // woken up, the reader drains the fd
+            if(!(cqe->flags & IORING_CQE_F_MORE)) {
+                submitWakeup(static_cast<Watcher*>(pointer));
+            }
+        break;
+    }
+}
+
+// ADD/MOD: submit recv/send if required
+// DEL: cancel recv, in-flight send will be completed (or failed) by kernel
+inline void Multiplexer::update(int operation, Bundle bundle) {
+    auto context = &bundle->second;
+    context->looper->metrics().add(Metrics::EPOLL_CTLS);
+    if(operation == EPOLL_CTL_DEL) {
+        if(context->_receiving) submitCancel(bundle);
+        return;
+    }
+    if(context->readEventEnabled()) {
+        if(!context->_receiving) submitRecv(bundle);
+    } else if(context->_receiving) {
+        submitCancel(bundle);
+    }
+    if(context->writeEventEnabled() && !context->_sending && context->output.unread()) {
+        submitSend(bundle);
+    }
+}
+
+inline void Multiplexer::connect(Bundle bundle) {
+    auto context = &bundle->second;
+    io_uring_sqe *sqe = acquire();
+    io_uring_prep_connect(sqe, context->fd(), (const sockaddr *)(&context->address), sizeof(context->address));
+    io_uring_sqe_set_data64(sqe, pack(bundle, OP_CONNECT));
+    context->_inflight++;
+    context->_eState = MultiplexerPolicy::EventState::ADDED;
+}
+
+inline void Multiplexer::cancelConnect(Bundle bundle) {
+    auto context = &bundle->second;
+    if(context->_eState != MultiplexerPolicy::EventState::NEW) {
+        io_uring_sqe *sqe = acquire();
+        io_uring_prep_cancel64(sqe, pack(bundle, OP_CONNECT), 0);
+        io_uring_sqe_set_data64(sqe, pack(nullptr, OP_NONE));
+    }
+    Socket(Socket::INVALID_FD).swap(context->socket);
+    context->_eState = MultiplexerPolicy::EventState::NEW;
+}
+
+inline Multiplexer::Token Multiplexer::token() {
+    std::lock_guard<std::mutex> _{_mutex};
+    _evnetVectors.emplace_back();
+    _acceptedVectors.emplace_back();
+    return _token++;
+}
+
+inline std::vector<epoll_event>& Multiplexer::visit(Token token) {
+    return _evnetVectors[token];
+}
+
+inline void Multiplexer::exchange(Token token, std::vector<epoll_event> &events) {
+    if(_exclusive) {
+        std::swap(_evnetVectors[token], events);
+        return;
+    }
+    std::lock_guard<std::mutex> _{_mutex};
+    std::swap(_evnetVectors[token], events);
+}
+
+inline ssize_t Multiplexer::readFrom(Bundle bundle) {
+    auto context = &bundle->second;
+    if(ssize_t n = std::exchange(context->_received, 0)) {
+        return n;
+    }
+    // duplicate event in the same batch
+    errno = EAGAIN;
+    return -1;
+}
+
+inline ssize_t Multiplexer::writeTo(Bundle bundle) {
+    return std::exchange(bundle->second._sent, 0);
+}
+
+inline bool Multiplexer::flushed(Bundle bundle) const {
+    auto context = &bundle->second;
+    return !context->_sending && context->output.unread() == 0;
+}
+
+inline epoll_event Multiplexer::makeEvent(uint32_t events, Bundle bundle) {
+    epoll_event event;
+    event.events = events;
+    event.data.u64 = reinterpret_cast<uint64_t>(bundle)
+        | (static_cast<uint64_t>(bundle->second._generation) << 48);
+    return event;
+}
+
+inline Multiplexer::Bundle Multiplexer::bundleOf(const epoll_event &event) {
+    auto bundle = reinterpret_cast<Bundle>(event.data.u64 & ((uint64_t(1) << 48) - 1));
+    uint16_t generation = event.data.u64 >> 48;
+    return bundle->second._generation == generation ? bundle : nullptr;
+}
+
+inline void Multiplexer::watch(int fd) {
+    _watchers.push_back({fd});
+    submitWakeup(&_watchers.back());
+}
+
+inline void Multiplexer::listen(Token token, int listenFd) {
+    _listeners.push_back({token, listenFd, false, {}});
+    for(auto &slot : _listeners.back().slots) {
+        slot.listener = &_listeners.back();
+        submitAccept(&slot);
+    }
+}
+
+inline void Multiplexer::setListening(Token token, int listenFd, bool on) {
+    for(auto &listener : _listeners) {
+        if(listener.token != token || listener.fd != listenFd) continue;
+        listener.paused = !on;
+        for(auto &slot : listener.slots) {
+            if(on && !slot.armed) {
+                submitAccept(&slot);
+            } else if(!on && slot.armed) {
+                // the cancelled accept is not resubmitted (see handleAccept())
+                io_uring_sqe *sqe = acquire();
+                io_uring_prep_cancel64(sqe, pack(&slot, OP_ACCEPT), 0);
+                io_uring_sqe_set_data64(sqe, pack(nullptr, OP_NONE));
+            }
+        }
+    }
+}
+
+inline void Multiplexer::exchangeAccepted(Token token, std::vector<Accepted> &accepted) {
+    if(_exclusive) {
+        std::swap(_acceptedVectors[token], accepted);
+        return;
+    }
+    std::lock_guard<std::mutex> _{_mutex};
+    std::swap(_acceptedVectors[token], accepted);
+}
+
+inline io_uring_sqe* Multiplexer::acquire() {
+    io_uring_sqe *sqe = io_uring_get_sqe(&_uring);
+    if(!sqe) {
+        // SQ ring is full, flush and retry
+        io_uring_submit(&_uring);
+        sqe = io_uring_get_sqe(&_uring);
+    }
+    if(!sqe) {
+        throw UringException(EBUSY);
+    }
+    return sqe;
+}
+
+inline void Multiplexer::submitAccept(AcceptSlot *slot) {
+    io_uring_sqe *sqe = acquire();
+    slot->length = sizeof(slot->address);
+    io_uring_prep_accept(sqe, slot->listener->fd, (sockaddr*)(&slot->address), &slot->length,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+    io_uring_sqe_set_data64(sqe, pack(slot, OP_ACCEPT));
+    slot->armed = true;
+}
+
+inline void Multiplexer::submitRecv(Bundle bundle) {
+    auto context = &bundle->second;
+    io_uring_sqe *sqe = acquire();
+    io_uring_prep_recv_multishot(sqe, context->fd(), nullptr, 0, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    io_uring_sqe_set_data64(sqe, pack(bundle, OP_RECV));
+    context->_receiving = true;
+    context->_inflight++;
+}
+
+inline void Multiplexer::submitSend(Bundle bundle) {
+    auto context = &bundle->second;
+    auto &sending = context->_sendingBuffer;
+    // kernel owns _sendingBuffer until completion
+    // user can still append to output
+    if(!sending.unread()) {
+        std::swap(sending, context->output);
+    }
+    io_uring_sqe *sqe = acquire();
+    io_uring_prep_send(sqe, context->fd(), sending.readBuffer(), sending.unread(), MSG_NOSIGNAL);
+    io_uring_sqe_set_data64(sqe, pack(bundle, OP_SEND));
+    context->_sending = true;
+    context->_inflight++;
+}
+
+inline void Multiplexer::submitCancel(Bundle bundle) {
+    auto context = &bundle->second;
+    io_uring_sqe *sqe = acquire();
+    io_uring_prep_cancel64(sqe, pack(bundle, OP_RECV), 0);
+    io_uring_sqe_set_data64(sqe, pack(bundle, OP_CANCEL));
+    context->_receiving = false;
+    context->_inflight++;
+}
+
+inline void Multiplexer::submitWakeup(Watcher *watcher) {
+    io_uring_sqe *sqe = acquire();
+    io_uring_prep_poll_multishot(sqe, watcher->fd, POLLIN);
+    io_uring_sqe_set_data64(sqe, pack(watcher, OP_WAKEUP));
+}
+
+inline void Multiplexer::handleAccept(AcceptSlot *slot, io_uring_cqe *cqe) {
+    auto listener = slot->listener;
+    slot->armed = false;
+    if(cqe->res >= 0) {
+        _acceptedVectors[listener->token].emplace_back(cqe->res, slot->address);
+    } else if(cqe->res != -ECANCELED) {
+        FLUENT_LOG_WARN("accept failed:", ::strerror(-cqe->res));
+    }
+    if(!listener->paused && cqe->res != -EBADF && cqe->res != -EINVAL) {
+        submitAccept(slot);
+    }
+}
+
+inline void Multiplexer::handleRecv(Bundle bundle, io_uring_cqe *cqe) {
+    auto context = &bundle->second;
+    bool more = cqe->flags & IORING_CQE_F_MORE;
+    if(!more) {
+        context->_inflight--;
+    }
+    int res = cqe->res;
+    // requested by submitCancel(), _receiving has been reset
+    if(res == -ECANCELED) {
+        return;
+    }
+    if(res > 0) {
+        auto bid = static_cast<unsigned short>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        context->input.append(&_bufferPool[size_t(bid) * BUFFER_SIZE], res);
+        context->looper->metrics().add(Metrics::READS);
+        context->looper->metrics().add(Metrics::READ_BYTES, res);
+        recycle(bid);
+        context->_received += res;
+        pushEvent(bundle, POLLIN);
+    } else if(res == 0) {
+        // FIN
+        context->_receiving = false;
+        pushEvent(bundle, POLLHUP);
+        return;
+    } else if(res != -ENOBUFS) {
+        context->_receiving = false;
+        pushEvent(bundle, POLLHUP | POLLERR);
+        return;
+    }
+    // terminated by kernel (e.g. no provided buffer), rearm
+    if(!more && context->_receiving) {
+        context->_receiving = false;
+        if(context->readEventEnabled()) {
+            submitRecv(bundle);
+        }
+    }
+}
+
+inline void Multiplexer::handleSend(Bundle bundle, io_uring_cqe *cqe) {
+    auto context = &bundle->second;
+    auto &sending = context->_sendingBuffer;
+    context->_inflight--;
+    context->_sending = false;
+    int res = cqe->res;
+    if(res < 0) {
+        sending.clear();
+        if(res != -ECANCELED) {
+            pushEvent(bundle, POLLHUP | POLLERR);
+        }
+        return;
+    }
+    sending.hasRead(res);
+    context->_sent += res;
+    context->looper->metrics().add(Metrics::WRITES);
+    context->looper->metrics().add(Metrics::WRITE_BYTES, res);
+    // short write or appended during in-flight
+    if(sending.unread() || (context->writeEventEnabled() && context->output.unread())) {
+        submitSend(bundle);
+    }
+    pushEvent(bundle, POLLOUT);
+}
+
+inline void Multiplexer::handleConnect(Bundle bundle, io_uring_cqe *cqe) {
+    bundle->second._inflight--;
+    // given up, see cancelConnect()
+    if(!bundle->second.isConnecting()) return;
+    pushEvent(bundle, cqe->res < 0 ? POLLOUT | POLLERR | POLLHUP : POLLOUT);
+}
+
+inline void Multiplexer::pushEvent(Bundle bundle, uint32_t events) {
+    _evnetVectors[bundle->first].emplace_back(makeEvent(events, bundle));
+}
+
+inline void Multiplexer::recycle(unsigned short bid) {
+    io_uring_buf_ring_add(_bufferRing, &_bufferPool[size_t(bid) * BUFFER_SIZE], BUFFER_SIZE, bid,
+        io_uring_buf_ring_mask(BUFFER_RING_SIZE), _recycled++);
+}
+
+inline Multiplexer::Multiplexer()
+    : _bufferPool(size_t(BUFFER_RING_SIZE) * BUFFER_SIZE) {
+    if(int err = io_uring_queue_init(ENTRIES, &_uring, 0)) {
+        throw UringException(-err);
+    }
+    int err;
+    _bufferRing = io_uring_setup_buf_ring(&_uring, BUFFER_RING_SIZE, BUFFER_GROUP, 0, &err);
+    if(!_bufferRing) {
+        io_uring_queue_exit(&_uring);
+        throw UringException(-err);
+    }
+    for(unsigned bid = 0; bid < BUFFER_RING_SIZE; ++bid) {
+        recycle(bid);
+    }
+    io_uring_buf_ring_advance(_bufferRing, _recycled);
+    _recycled = 0;
+}
+
+inline Multiplexer::Multiplexer(Exclusive)
+    : Multiplexer() {
+    _exclusive = true;
+}
+
+inline Multiplexer::~Multiplexer() {
+    io_uring_free_buf_ring(&_uring, _bufferRing, BUFFER_RING_SIZE, BUFFER_GROUP);
+    io_uring_queue_exit(&_uring);
+}
+
+inline void Context::updateMultiplexer(Context::EpollOperationHint hint) {
+    _multiplexer->update(hint, _bundle);
+}
+
+} // fluent
+#endif
@@ -0,0 +1,43 @@
+#ifndef __FLUENT_POLICY_AWAIT_POLICY_H__
+#define __FLUENT_POLICY_AWAIT_POLICY_H__
+#include <bits/stdc++.h>
+namespace fluent {
+
+// type-erased waiter, e.g. a suspended coroutine (see coroutine/Awaiters.h)
+// C++17 code only resumes it, ok: false if the connection is closed (or failed)
+struct Resumer {
+    void (*fn)(void *arg, bool ok) {nullptr};
+    void *arg {nullptr};
+
+    explicit operator bool() const { return fn != nullptr; }
+    void operator()(bool ok) const { fn(arg, ok); }
+};
+
+// waiters of a context, resumed by handler directly (no polling)
+class AwaitPolicy {
+protected:
+    // input has _readWant bytes at least, or the connection is closed
+    void wakeReader(size_t readable, bool closed);
+    // CONNECTING context is connected or failed, see Handler::handleConnect()
+    void wakeConnector(bool connected);
+
+protected:
+    // single reader
+    Resumer _reader;
+    size_t _readWant {0};
+    Resumer _connector;
+};
+
+inline void AwaitPolicy::wakeReader(size_t readable, bool closed) {
+    if(!_reader || (!closed && readable < _readWant)) return;
+    // the reader may await again
+    std::exchange(_reader, {})(!closed);
+}
+
+inline void AwaitPolicy::wakeConnector(bool connected) {
+    if(!_connector) return;
+    std::exchange(_connector, {})(connected);
+}
+
+} // fluent
+#endif
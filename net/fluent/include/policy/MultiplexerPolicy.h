@@ -1,6 +1,10 @@
 #ifndef __FLUENT_POLICY_MULTIPLEXER_POLICY_H__
 #define __FLUENT_POLICY_MULTIPLEXER_POLICY_H__
+#include <poll.h>
 #include <bits/stdc++.h>
+#ifdef FLUENT_FLAG_IO_URING
+#include "../network/Buffer.h"
+#endif
 namespace fluent {
 
 class Multiplexer;
@@ -10,8 +14,9 @@ class MultiplexerPolicy {
 public:
     using EventBitmap = uint32_t;
     constexpr static EventBitmap EVENT_NONE = 0;
-    constexpr static EventBitmap EVENT_READ = POLL_IN | POLL_PRI;
-    constexpr static EventBitmap EVENT_WRITE = POLL_OUT;
+    // note: not POLL_IN / POLL_OUT (siginfo codes, POLL_PRI contains EPOLLOUT)
+    constexpr static EventBitmap EVENT_READ = POLLIN | POLLPRI;
+    constexpr static EventBitmap EVENT_WRITE = POLLOUT;
 
     enum class EventState {
         NEW,
@@ -22,7 +27,16 @@ public:
     using EpollOperationHint = uint;
     constexpr static EpollOperationHint EPOLL_CTL_NONE = 0;
 
+#if defined(FLUENT_FLAG_EPOLL_ET) && !defined(FLUENT_FLAG_IO_URING)
+    // edge-triggered: registered once with read | write (see Multiplexer::interestOf())
+    // _events is the interest of handler only, toggling it does not need epoll_ctl
+    constexpr static bool EDGE_TRIGGERED = true;
+#else
+    constexpr static bool EDGE_TRIGGERED = false;
+#endif
+
     // update the event state and return next operation hint for epoll
+    // EPOLL_CTL_NONE if the registration is unchanged
     EpollOperationHint updateEventState();
 
     EventBitmap events() const { return _events; }
@@ -35,6 +49,14 @@ public:
     bool disableRead();
     bool disableWrite();
 
+    // the multiplexer still holds this context (e.g. in-flight sqes)
+    // context cannot be reused by pool
+    bool ioPending() const;
+
+    // a new connection in the same pool slot
+    // ensure: !ioPending()
+    void reset();
+
 protected:
     EventBitmap _events {EVENT_NONE};
     EventState _eState {EventState::NEW};
@@ -44,6 +66,21 @@ protected:
     // ugly...
     Multiplexer *_multiplexer;
     std::pair<size_t, Context> *_bundle;
+    // slot generation, tagged to the multiplexer event
+    uint16_t _generation {0};
+
+#ifdef FLUENT_FLAG_IO_URING
+    // completion states, maintained by io_uring multiplexer
+    bool _receiving {false};
+    bool _sending {false};
+    // in-flight sqes (including cancel request)
+    size_t _inflight {0};
+    // completed but not yet handled
+    ssize_t _received {0};
+    ssize_t _sent {0};
+    // owned by kernel while _sending
+    Buffer _sendingBuffer;
+#endif
 
 // log helper
 public:
@@ -63,7 +100,7 @@ inline MultiplexerPolicy::EpollOperationHint MultiplexerPolicy::updateEventState
         _eState = EventState::DELETED;
         return EPOLL_CTL_DEL;
     } else {
-        return EPOLL_CTL_MOD;
+        return EDGE_TRIGGERED ? EPOLL_CTL_NONE : EPOLL_CTL_MOD;
     }
 }
 
@@ -99,6 +136,25 @@ inline bool MultiplexerPolicy::disableWrite() {
     return false;
 }
 
+inline bool MultiplexerPolicy::ioPending() const {
+#ifdef FLUENT_FLAG_IO_URING
+    return _inflight != 0;
+#else
+    return false;
+#endif
+}
+
+inline void MultiplexerPolicy::reset() {
+    _events = EVENT_NONE;
+    _eState = EventState::NEW;
+#ifdef FLUENT_FLAG_IO_URING
+    _receiving = _sending = false;
+    _received = _sent = 0;
+    // the memory is kept
+    _sendingBuffer.clear();
+#endif
+}
+
 inline constexpr void MultiplexerPolicy::checkHardCode() {
     static_assert(EPOLL_CTL_NONE != EPOLL_CTL_ADD
                     && EPOLL_CTL_NONE != EPOLL_CTL_DEL
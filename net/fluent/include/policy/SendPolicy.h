@@ -1,10 +1,23 @@
 #ifndef __FLUENT_POLICY_SEND_POLICY_H__
 #define __FLUENT_POLICY_SEND_POLICY_H__
 #include <bits/stdc++.h>
+#include "../future/Future.h"
+#include "../future/Promise.h"
+#include "../utils/SmallRing.h"
+#include "AwaitPolicy.h"
 namespace fluent {
 
 class SendPolicy {
 public:
+    // intrusive waiter of a pending send, linked by the ring entry until resumed
+    // empty resumer: the promise of a future(), owned by the ring
+    struct Waiter {
+        Resumer resumer;
+        Waiter *next {nullptr};
+    };
+
+    // the full sequence of the pending bytes and the generation of the connection
+    // a completion held after the slot is reused (see Pool) never observes the next connection
     class Completion {
     public:
         // index flag: never
@@ -14,17 +27,248 @@ public:
     private:
         size_t _token;
         SendPolicy *_master;
+        Looper *_looper;
+        uint16_t _generation;
     public:
-        bool poll() const { return _master->_sendCompletedIndex > _token; }
-        Completion(size_t token, SendPolicy *master)
-            : _token(token), _master(master) {}
+        // false if the context has been reused by another connection
+        bool poll() const;
+        // resolved in looper, true: the bytes are released, false: connection is closed before
+        // note: call it in looper thread, before the context is closed
+        Future<bool> future() const;
+        // resumed in looper with the same result as future(), no allocation
+        // ensure: waiter is alive until resumed
+        // return: false if it is resolved already (see poll())
+        bool await(Waiter &waiter) const;
+        Completion(size_t token, SendPolicy *master, Looper *looper)
+            : _token(token), _master(master), _looper(looper), _generation(master->_sendGeneration) {}
+    private:
+        // the same connection, and the token is still in the ring
+        bool pending() const;
+    };
+
+    // pending send completions in order, fixed capacity
+    // if it is full, the new bytes are merged to the last one (it completes later, never earlier)
+    class CompletionRing {
+    public:
+        constexpr static size_t CAPACITY = 16;
+
+        // return: token of the pending bytes
+        size_t push(size_t pending, size_t current, size_t completed);
+        // n bytes are released, resolve waiters in looper
+        // return: completed count
+        size_t complete(size_t n, size_t completed, size_t current, Looper *looper);
+        // connection is closed, resolve all waiters with false
+        void abort(size_t completed, size_t current, Looper *looper);
+        // ensure: token is pending
+        // many waiters per token, e.g. future() twice, or tokens merged by a full ring
+        void await(size_t token, Waiter *waiter);
+        void await(size_t token, SharedPtr<ControlBlock<bool>> promise);
+
+        CompletionRing() = default;
+        // unresolved futures are dropped, as an abandoned promise
+        ~CompletionRing() { drop(); }
+        CompletionRing(const CompletionRing&) = delete;
+        CompletionRing(CompletionRing &&rhs) noexcept: _entries(rhs._entries) { rhs.release(); }
+        CompletionRing& operator=(const CompletionRing&) = delete;
+        CompletionRing& operator=(CompletionRing &&rhs) noexcept;
+
+    private:
+        struct PromiseWaiter: Waiter {
+            SharedPtr<ControlBlock<bool>> promise;
+        };
+
+        // pending tokens are in [completed, current), at most CAPACITY
+        // so a full sequence maps to a single entry
+        struct Entry {
+            size_t remaining;
+            // in await() order, nullptr: no one is waiting
+            Waiter *head;
+            Waiter *tail;
+        };
+
+        Entry& entry(size_t token) { return _entries[token & (CAPACITY - 1)]; }
+        static void resolve(Entry &entry, bool flushed, Looper *looper);
+        void drop();
+        void release() { for(auto &e : _entries) e.head = e.tail = nullptr; }
+
+    private:
+        std::array<Entry, CAPACITY> _entries {};
     };
 
+    // a reference to the pending bytes
+    // base == nullptr: copied to output buffer
+    // owner == nullptr: borrowed from user, should be alive until completion
+    struct Segment {
+        const char *base;
+        size_t length;
+        std::shared_ptr<const void> owner;
+    };
+
+    // MSG_ZEROCOPY is used only for large referenced bytes
+    constexpr static size_t ZERO_COPY_THRESHOLD = 16 * 1024;
+
+protected:
+    // n bytes are released
+    void completeSend(size_t n, Looper *looper) {
+        _sendCompletedIndex += _sendCompletions.complete(n, _sendCompletedIndex, _sendCurrentIndex, looper);
+    }
+    // unsent bytes are not completed, poll() keeps false for them
+    void abortSend(Looper *looper) {
+        _sendCompletions.abort(_sendCompletedIndex, _sendCurrentIndex, looper);
+        _sendAborted = true;
+    }
+
 protected:
-    std::queue<size_t> _sendProvider;
+    CompletionRing _sendCompletions;
+    // tokens in [_sendCompletedIndex, _sendCurrentIndex) are pending
     size_t _sendCurrentIndex {Completion::FAST_COMPLETE + 1};
     size_t _sendCompletedIndex {Completion::FAST_COMPLETE + 1};
+    // connection is closed, pending tokens are resolved with false
+    bool _sendAborted {false};
+    // MultiplexerPolicy::_generation of this connection, set by Pool
+    uint16_t _sendGeneration {0};
+
+    // pending bytes in order, flushed by writev/sendmsg
+    // a few inline segments, copied bytes are merged into one
+    SmallRing<Segment, 4> _sendQueue;
+    // output bytes covered by _sendQueue
+    size_t _sendQueueCopied {0};
+
+    // MSG_ZEROCOPY
+    // written bytes are still pinned by kernel until notified (error queue)
+    struct Pinned {
+        // SEQUENCE_NONE: written without MSG_ZEROCOPY, but released after the previous one
+        uint32_t sequence;
+        size_t length;
+    };
+    constexpr static uint32_t SEQUENCE_NONE = std::numeric_limits<uint32_t>::max();
+    struct ZeroCopy {
+        bool enabled {false};
+        // kernel counter of MSG_ZEROCOPY sendmsg
+        uint32_t sequence {0};
+        std::deque<Pinned> pinned;
+        std::deque<std::pair<uint32_t, std::shared_ptr<const void>>> owners;
+    };
+    // created by the first setZeroCopy(), most connections never pay for it
+    // kept if it is turned off, some bytes may be still pinned
+    std::unique_ptr<ZeroCopy> _zeroCopy;
+
+    bool zeroCopyEnabled() const { return _zeroCopy && _zeroCopy->enabled; }
 };
 
+inline bool SendPolicy::Completion::pending() const {
+    return _master->_sendGeneration == _generation
+        && !_master->_sendAborted
+        && _master->_sendCompletedIndex <= _token && _token < _master->_sendCurrentIndex;
+}
+
+inline bool SendPolicy::Completion::poll() const {
+    if(_token == INVALID) return false;
+    if(_token == FAST_COMPLETE) return true;
+    return _master->_sendGeneration == _generation && _master->_sendCompletedIndex > _token;
+}
+
+inline Future<bool> SendPolicy::Completion::future() const {
+    Promise<bool> promise {_looper};
+    auto future = promise.get();
+    if(pending()) {
+        _master->_sendCompletions.await(_token, future.getControlBlock());
+    } else {
+        // resolved, or the context is closed / reused by another connection
+        promise.setValue(poll());
+    }
+    return future;
+}
+
+inline bool SendPolicy::Completion::await(Waiter &waiter) const {
+    if(!pending()) return false;
+    _master->_sendCompletions.await(_token, &waiter);
+    return true;
+}
+
+inline size_t SendPolicy::CompletionRing::push(size_t pending, size_t current, size_t completed) {
+    if(current - completed == CAPACITY) {
+        entry(current - 1).remaining += pending;
+        return current - 1;
+    }
+    // resolved entry, no waiters
+    entry(current).remaining = pending;
+    return current;
+}
+
+inline void SendPolicy::CompletionRing::await(size_t token, Waiter *waiter) {
+    auto &e = entry(token);
+    waiter->next = nullptr;
+    if(e.tail) {
+        e.tail->next = waiter;
+    } else {
+        e.head = waiter;
+    }
+    e.tail = waiter;
+}
+
+inline void SendPolicy::CompletionRing::await(size_t token, SharedPtr<ControlBlock<bool>> promise) {
+    auto waiter = new PromiseWaiter;
+    waiter->promise = std::move(promise);
+    await(token, waiter);
+}
+
+inline size_t SendPolicy::CompletionRing::complete(size_t n, size_t completed, size_t current, Looper *looper) {
+    size_t count = 0;
+    for(size_t token = completed; n > 0 && token != current; ++token, ++count) {
+        auto &e = entry(token);
+        if(e.remaining > n) {
+            e.remaining -= n;
+            break;
+        }
+        n -= e.remaining;
+        resolve(e, true, looper);
+    }
+    return count;
+}
+
+inline void SendPolicy::CompletionRing::abort(size_t completed, size_t current, Looper *looper) {
+    for(size_t token = completed; token != current; ++token) {
+        resolve(entry(token), false, looper);
+    }
+}
+
+inline void SendPolicy::CompletionRing::resolve(Entry &entry, bool flushed, Looper *looper) {
+    Waiter *waiter = std::exchange(entry.head, nullptr);
+    entry.tail = nullptr;
+    while(waiter) {
+        // the resumed one may be gone
+        Waiter *next = waiter->next;
+        if(auto resumer = waiter->resumer) {
+            looper->post([resumer, flushed] { resumer(flushed); });
+        } else {
+            auto owned = static_cast<PromiseWaiter*>(waiter);
+            Promise<bool> {looper, std::move(owned->promise)}.setValue(flushed);
+            delete owned;
+        }
+        waiter = next;
+    }
+}
+
+inline SendPolicy::CompletionRing& SendPolicy::CompletionRing::operator=(CompletionRing &&rhs) noexcept {
+    if(this != &rhs) {
+        drop();
+        _entries = rhs._entries;
+        rhs.release();
+    }
+    return *this;
+}
+
+inline void SendPolicy::CompletionRing::drop() {
+    for(auto &e : _entries) {
+        for(Waiter *waiter = e.head; waiter;) {
+            Waiter *next = waiter->next;
+            if(!waiter->resumer) delete static_cast<PromiseWaiter*>(waiter);
+            waiter = next;
+        }
+    }
+    release();
+}
+
 } // fluent
 #endif
\ No newline at end of file
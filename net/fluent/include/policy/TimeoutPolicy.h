@@ -0,0 +1,38 @@
+#ifndef __FLUENT_POLICY_TIMEOUT_POLICY_H__
+#define __FLUENT_POLICY_TIMEOUT_POLICY_H__
+#include <bits/stdc++.h>
+#include "../future/Timer.h"
+namespace fluent {
+
+class TimeoutPolicy {
+public:
+    // last read / write, maintained by handler (cached looper clock)
+    TimerPoint lastRead() const { return _lastRead; }
+    TimerPoint lastWrite() const { return _lastWrite; }
+    TimerPoint lastActive() const { return std::max(_lastRead, _lastWrite); }
+
+protected:
+    enum TimeoutKind {
+        TIMEOUT_IDLE,
+        TIMEOUT_READ,
+        TIMEOUT_WRITE,
+        TIMEOUT_KINDS
+    };
+
+    struct Timeout {
+        // 0: disabled
+        std::chrono::milliseconds duration {0};
+        // armed in looper
+        bool armed {false};
+        TimerId timer {};
+        // read / write deadline
+        TimerPoint deadline {};
+    };
+
+    Timeout _timeouts[TIMEOUT_KINDS];
+    TimerPoint _lastRead {};
+    TimerPoint _lastWrite {};
+};
+
+} // fluent
+#endif
@@ -16,5 +16,6 @@
             #include "EpollCreateException.h"
             #include "EpollWaitException.h"
             #include "EpollControlException.h"
+        #include "UringException.h"
 
 #endif
\ No newline at end of file
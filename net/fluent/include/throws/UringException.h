@@ -0,0 +1,14 @@
+#ifndef __FLUENT_THROWS_URING_EXCEPTION_H__
+#define __FLUENT_THROWS_URING_EXCEPTION_H__
+#include "ErrnoException.h"
+namespace fluent {
+
+class UringException: public ErrnoException {
+public:
+    static constexpr const char *TAG = "io_uring exception";
+    using ErrnoException::ErrnoException;
+    UringException(int err): ErrnoException(TAG, err) {}
+};
+
+} // fluent
+#endif
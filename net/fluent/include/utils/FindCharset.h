@@ -0,0 +1,99 @@
+#ifndef __FLUENT_UTILS_FIND_CHARSET_H__
+#define __FLUENT_UTILS_FIND_CHARSET_H__
+#include <x86intrin.h>
+#include <bits/stdc++.h>
+namespace fluent {
+
+// u8[32] as a bitmap of char field
+// even / odd: bitmap split by byte parity, the shuffle tables of findCharsetAvx2()
+struct Charset {
+    uint8_t bitmap[32] {};
+    uint8_t even[16] {};
+    uint8_t odd[16] {};
+
+    Charset() = default;
+    constexpr Charset(const char *chars) {
+        for(; *chars; ++chars) add(*chars);
+    }
+
+    constexpr void add(char c) {
+        auto v = static_cast<unsigned char>(c);
+        bitmap[v / 8] |= 1 << (v % 8);
+        (v / 8 % 2 ? odd : even)[v / 16] |= 1 << (v % 8);
+    }
+
+    constexpr void remove(char c) {
+        auto v = static_cast<unsigned char>(c);
+        bitmap[v / 8] &= ~(1 << (v % 8));
+        (v / 8 % 2 ? odd : even)[v / 16] &= ~(1 << (v % 8));
+    }
+
+    constexpr void addRange(unsigned char lo, unsigned char hi) {
+        for(unsigned v = lo; v <= hi; ++v) add(v);
+    }
+
+    constexpr bool contains(char c) const {
+        auto v = static_cast<unsigned char>(c);
+        return (bitmap[v / 8] >> (v % 8)) & 1;
+    }
+};
+
+// return: index of the first char in charset, or -1
+ssize_t findCharset(const char *data, size_t length, const Charset &charset);
+
+inline ssize_t findCharsetScalar(const char *data, size_t length, const Charset &charset) {
+    for(size_t i = 0; i < length; ++i) {
+        if(charset.contains(data[i])) return i;
+    }
+    return -1;
+}
+
+// C++17 port of find_charset_avx2() in simd/find_charset.hpp
+// u8[32] -> 16 x 8 (table-even) + 16 x 8 (table-odd)
+// b4-b7: row, b3: table parity, b0-b2: col
+__attribute__((target("avx2")))
+inline ssize_t findCharsetAvx2(const char *data, size_t length, const Charset &charset) {
+    constexpr size_t lane = sizeof(__m256i);
+
+    // packed by Charset, no packus here
+    const auto filterEven128 = _mm_loadu_si128((const __m128i *)(charset.even));
+    const auto filterOdd128 = _mm_loadu_si128((const __m128i *)(charset.odd));
+    const auto filterEven = _mm256_set_m128i(filterEven128, filterEven128);
+    const auto filterOdd = _mm256_set_m128i(filterOdd128, filterOdd128);
+
+    // 1 << (b3b2b1b0 % 8)
+    const auto shiftMod = _mm256_setr_epi8(
+        1, 2, 4, 8, 16, 32, 64, -128,
+        1, 2, 4, 8, 16, 32, 64, -128,
+        1, 2, 4, 8, 16, 32, 64, -128,
+        1, 2, 4, 8, 16, 32, 64, -128
+    );
+    const auto lowNibble = _mm256_set1_epi8(0x0f);
+
+    size_t i = 0;
+    for(; i + lane <= length; i += lane) {
+        auto chars = _mm256_loadu_si256((const __m256i *)(data + i));
+        auto bitIndex = _mm256_and_si256(chars, lowNibble);
+        auto byteIndex = _mm256_and_si256(_mm256_srli_epi16(chars, 4), lowNibble);
+        auto col = _mm256_shuffle_epi8(shiftMod, bitIndex);
+        auto rowEven = _mm256_shuffle_epi8(filterEven, byteIndex);
+        auto rowOdd = _mm256_shuffle_epi8(filterOdd, byteIndex);
+        // bit 7 (original b3) selects the table
+        auto row = _mm256_blendv_epi8(rowEven, rowOdd, _mm256_slli_epi16(chars, 4));
+        unsigned mask = _mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_andnot_si256(row, col), _mm256_setzero_si256()));
+        if(mask) return i + __builtin_ctz(mask);
+    }
+    ssize_t tail = findCharsetScalar(data + i, length - i, charset);
+    return tail < 0 ? -1 : ssize_t(i) + tail;
+}
+
+inline ssize_t findCharset(const char *data, size_t length, const Charset &charset) {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    // short strings are not worth the table setup
+    if(avx2 && length >= 32) return findCharsetAvx2(data, length, charset);
+    return findCharsetScalar(data, length, charset);
+}
+
+} // fluent
+#endif
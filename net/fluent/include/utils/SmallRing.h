@@ -0,0 +1,123 @@
+#ifndef __FLUENT_UTILS_SMALL_RING_H__
+#define __FLUENT_UTILS_SMALL_RING_H__
+#include <bits/stdc++.h>
+namespace fluent {
+
+// FIFO ring with N inline elements
+// no allocation until it holds more than N elements,
+// the heap ring grows by doubling and is freed once the ring is drained
+// note: unlike std::deque, neither construction nor move allocates
+template <typename T, size_t N>
+class SmallRing {
+    static_assert(N && !(N & (N - 1)), "N must be a power of two");
+
+public:
+    bool empty() const { return _size == 0; }
+    size_t size() const { return _size; }
+
+    // i-th element from front
+    T& operator[](size_t i) { return _data[(_head + i) & (_capacity - 1)]; }
+    const T& operator[](size_t i) const { return _data[(_head + i) & (_capacity - 1)]; }
+    T& front() { return (*this)[0]; }
+    T& back() { return (*this)[_size - 1]; }
+
+    template <typename ...Args>
+    T& emplace_back(Args &&...args);
+    void push_back(T &&value) { emplace_back(std::move(value)); }
+    void pop_front();
+    void clear() { while(!empty()) pop_front(); }
+
+    SmallRing() = default;
+    ~SmallRing();
+    SmallRing(const SmallRing&) = delete;
+    SmallRing(SmallRing &&rhs) noexcept;
+    SmallRing& operator=(const SmallRing&) = delete;
+    SmallRing& operator=(SmallRing &&rhs) noexcept;
+
+private:
+    T* inlined() { return reinterpret_cast<T*>(_inline); }
+    bool isInline() const { return _data == reinterpret_cast<const T*>(_inline); }
+    void grow();
+    // ensure: empty
+    void release();
+
+private:
+    alignas(T) unsigned char _inline[N * sizeof(T)];
+    T *_data {inlined()};
+    size_t _capacity {N};
+    size_t _head {0};
+    size_t _size {0};
+};
+
+template <typename T, size_t N>
+template <typename ...Args>
+inline T& SmallRing<T, N>::emplace_back(Args &&...args) {
+    if(_size == _capacity) grow();
+    T *slot = &_data[(_head + _size) & (_capacity - 1)];
+    new (slot) T(std::forward<Args>(args)...);
+    ++_size;
+    return *slot;
+}
+
+template <typename T, size_t N>
+inline void SmallRing<T, N>::pop_front() {
+    front().~T();
+    _head = (_head + 1) & (_capacity - 1);
+    if(--_size == 0) release();
+}
+
+template <typename T, size_t N>
+inline SmallRing<T, N>::~SmallRing() {
+    clear();
+}
+
+template <typename T, size_t N>
+inline SmallRing<T, N>::SmallRing(SmallRing &&rhs) noexcept {
+    if(!rhs.isInline()) {
+        _data = std::exchange(rhs._data, rhs.inlined());
+        _capacity = std::exchange(rhs._capacity, N);
+        _head = std::exchange(rhs._head, 0);
+        _size = std::exchange(rhs._size, 0);
+        return;
+    }
+    for(size_t i = 0; i < rhs._size; ++i) {
+        new (&_data[i]) T(std::move(rhs[i]));
+    }
+    _size = rhs._size;
+    rhs.clear();
+}
+
+template <typename T, size_t N>
+inline SmallRing<T, N>& SmallRing<T, N>::operator=(SmallRing &&rhs) noexcept {
+    if(this != &rhs) {
+        this->~SmallRing();
+        new (this) SmallRing(std::move(rhs));
+    }
+    return *this;
+}
+
+template <typename T, size_t N>
+inline void SmallRing<T, N>::grow() {
+    size_t capacity = _capacity << 1;
+    T *data = static_cast<T*>(::operator new(capacity * sizeof(T), std::align_val_t(alignof(T))));
+    for(size_t i = 0; i < _size; ++i) {
+        new (&data[i]) T(std::move((*this)[i]));
+        (*this)[i].~T();
+    }
+    if(!isInline()) ::operator delete(_data, std::align_val_t(alignof(T)));
+    _data = data;
+    _capacity = capacity;
+    _head = 0;
+}
+
+template <typename T, size_t N>
+inline void SmallRing<T, N>::release() {
+    _head = 0;
+    if(isInline()) return;
+    ::operator delete(_data, std::align_val_t(alignof(T)));
+    _data = inlined();
+    _capacity = N;
+}
+
+} // fluent
+#endif
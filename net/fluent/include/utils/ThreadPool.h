@@ -1,68 +1,352 @@
 #ifndef __FLUENT_UTILS_THREAD_POOL_H__
 #define __FLUENT_UTILS_THREAD_POOL_H__
 #include <bits/stdc++.h>
+#include "../future/TaskQueue.h"
+#include "WorkStealingDeque.h"
 namespace fluent {
 
+// work-stealing pool for CPU-heavy work
+//
+// - each worker owns a Chase-Lev deque, tasks spawned by a worker are pushed to its own deque (no lock)
+// - tasks from other threads go to a global injection queue, fetched by workers in batches
+// - an idle worker steals from random victims, spins for SPIN_ROUNDS and then parks
+// - parallelFor() / forkJoin() are blocking, the waiting thread runs tasks as well
+//
+// workers are detached and keep the shared state alive, queued tasks still run after destruction
 class ThreadPool {
 public:
-    explicit ThreadPool(int size) { while(size--) run(); }
-    ~ThreadPool();
+    // find attempts before parking
+    constexpr static size_t SPIN_ROUNDS = 64;
+    // tasks moved from the injection queue per fetch
+    constexpr static size_t INJECT_BATCH = 32;
+    // parallelFor() auto grain: chunks per worker
+    constexpr static size_t CHUNKS_PER_WORKER = 8;
+
+    struct Stats {
+        uint64_t executed;
+        // taken from other workers
+        uint64_t stolen;
+        // submitted by non-worker threads
+        uint64_t injected;
+        uint64_t parks;
+    };
 
+public:
+    // worker thread: pushed to its own deque, or the injection queue
+    // functor and args are moved (or copied) into the task
     template <typename Func, typename ...Args>
     void execute(Func &&functor, Args &&...args);
 
+    // functor(i) for i in [begin, end), split down to grain (0: auto) and stolen by idle workers
+    // the first exception is rethrown, the rest of chunks are skipped
+    template <typename Func>
+    void parallelFor(size_t begin, size_t end, Func &&functor, size_t grain = 0);
+
+    // run all functors in parallel, return when all of them return
+    template <typename ...Funcs>
+    void forkJoin(Funcs &&...functors);
+
+    size_t size() const { return _shared->workers.size(); }
+    Stats stats() const;
+
+    explicit ThreadPool(int size);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
 private:
-    void run();
+    struct alignas(64) Worker {
+        WorkStealingDeque<Task*> deque;
+        uint64_t random;
+        // single writer
+        std::atomic<uint64_t> executed {0};
+        std::atomic<uint64_t> stolen {0};
+        std::atomic<uint64_t> parks {0};
+    };
 
-    struct Data {
-        std::mutex _mutex;
-        std::condition_variable _condition;
-        bool _stop {false};
-        std::queue<std::function<void()>> _tasks;
+    struct Shared {
+        std::vector<std::unique_ptr<Worker>> workers;
+        // injection queue
+        std::mutex injectMutex;
+        std::deque<Task*> injected;
+        std::atomic<size_t> injectedSize {0};
+        uint64_t injections {0};
+        // parking
+        std::mutex parkMutex;
+        std::condition_variable condition;
+        std::atomic<size_t> sleeping {0};
+        uint64_t epoch {0};
+        std::atomic<bool> stop {false};
     };
-    std::shared_ptr<Data> _data {std::make_shared<Data>()};
+
+    // parallelFor() / forkJoin() state, on the stack of the waiting thread
+    struct Join {
+        std::atomic<size_t> pending {0};
+        std::atomic<bool> failed {false};
+        std::exception_ptr exception;
+
+        template <typename Func>
+        void run(Func &&functor);
+        // the last access of a task
+        void done() { pending.fetch_sub(1, std::memory_order_release); }
+    };
+
+    // the pool and worker of this thread
+    struct Local {
+        Shared *shared;
+        Worker *worker;
+    };
+    inline static thread_local Local _local {nullptr, nullptr};
+
+    Worker* localWorker() const { return _local.shared == _shared.get() ? _local.worker : nullptr; }
+
+    template <typename Func>
+    void spawn(Func &&functor);
+    template <typename Func>
+    void split(size_t begin, size_t end, size_t grain, Func &functor, Join &join);
+    // run tasks until the join is done
+    void wait(Join &join);
+
+    static void run(std::shared_ptr<Shared> shared, size_t index);
+    // worker == nullptr: a non-worker thread is helping
+    static Task* find(Shared *shared, Worker *worker);
+    static Task* fetchInjected(Shared *shared, Worker *worker);
+    static Task* steal(Shared *shared, Worker *worker);
+    static void invoke(Worker *worker, Task *task);
+    // return: false if stopped and no more work
+    static bool park(Shared *shared, Worker *worker);
+    static void notify(Shared *shared);
+    static bool hasWork(Shared *shared);
+    static uint64_t nextRandom(uint64_t &state);
+
+private:
+    std::shared_ptr<Shared> _shared {std::make_shared<Shared>()};
 };
 
+template <typename Func, typename ...Args>
+inline void ThreadPool::execute(Func &&functor, Args &&...args) {
+    if constexpr (sizeof...(Args) == 0) {
+        spawn(std::forward<Func>(functor));
+    } else {
+        spawn([functor = std::forward<Func>(functor),
+               args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+            std::apply(functor, std::move(args));
+        });
+    }
+}
+
+template <typename Func>
+inline void ThreadPool::parallelFor(size_t begin, size_t end, Func &&functor, size_t grain) {
+    if(begin >= end) return;
+    if(grain == 0) grain = std::max<size_t>(1, (end - begin) / (size() * CHUNKS_PER_WORKER));
+    Join join;
+    split(begin, end, grain, functor, join);
+    wait(join);
+}
+
+template <typename ...Funcs>
+inline void ThreadPool::forkJoin(Funcs &&...functors) {
+    Join join;
+    join.pending.store(sizeof...(Funcs), std::memory_order_relaxed);
+    (spawn([&join, &functors] { join.run(functors); join.done(); }), ...);
+    wait(join);
+}
+
+template <typename Func>
+inline void ThreadPool::spawn(Func &&functor) {
+    Task *task = new Task;
+    task->emplace(std::forward<Func>(functor), nullptr);
+    if(Worker *worker = localWorker()) {
+        worker->deque.push(task);
+    } else {
+        Shared *shared = _shared.get();
+        std::lock_guard<std::mutex> _ {shared->injectMutex};
+        shared->injected.emplace_back(task);
+        shared->injectedSize.fetch_add(1, std::memory_order_relaxed);
+        shared->injections++;
+    }
+    notify(_shared.get());
+}
+
+template <typename Func>
+inline void ThreadPool::split(size_t begin, size_t end, size_t grain, Func &functor, Join &join) {
+    // binary split, the right halves are left for thieves
+    while(end - begin > grain) {
+        size_t middle = begin + (end - begin) / 2;
+        join.pending.fetch_add(1, std::memory_order_relaxed);
+        spawn([this, middle, end, grain, &functor, &join] {
+            split(middle, end, grain, functor, join);
+            join.done();
+        });
+        end = middle;
+    }
+    join.run([&] { for(size_t i = begin; i < end; ++i) functor(i); });
+}
+
+template <typename Func>
+inline void ThreadPool::Join::run(Func &&functor) {
+    if(failed.load(std::memory_order_relaxed)) return;
+    try {
+        functor();
+    } catch(...) {
+        if(!failed.exchange(true, std::memory_order_acq_rel)) {
+            exception = std::current_exception();
+        }
+    }
+}
+
+inline void ThreadPool::wait(Join &join) {
+    Worker *worker = localWorker();
+    for(size_t idle = 0; join.pending.load(std::memory_order_acquire); ) {
+        if(Task *task = find(_shared.get(), worker)) {
+            invoke(worker, task);
+            idle = 0;
+        } else if(++idle > SPIN_ROUNDS) {
+            std::this_thread::yield();
+        }
+    }
+    if(join.exception) std::rethrow_exception(join.exception);
+}
+
+inline ThreadPool::Stats ThreadPool::stats() const {
+    Stats stats {};
+    for(auto &worker : _shared->workers) {
+        stats.executed += worker->executed.load(std::memory_order_relaxed);
+        stats.stolen += worker->stolen.load(std::memory_order_relaxed);
+        stats.parks += worker->parks.load(std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex> _ {_shared->injectMutex};
+    stats.injected = _shared->injections;
+    return stats;
+}
+
+inline ThreadPool::ThreadPool(int size) {
+    size = std::max(size, 1);
+    for(int i = 0; i < size; ++i) {
+        auto &worker = _shared->workers.emplace_back(std::make_unique<Worker>());
+        worker->random = 0x9e3779b97f4a7c15ull * (i + 1);
+    }
+    for(int i = 0; i < size; ++i) {
+        std::thread {[shared = _shared, i] { run(shared, i); }}.detach();
+    }
+}
+
 inline ThreadPool::~ThreadPool() {
-    if(auto data = _data) {
+    if(auto shared = _shared) {
+        shared->stop.store(true);
         {
-            std::lock_guard<std::mutex> _ { data->_mutex};
-            data->_stop = true;
+            std::lock_guard<std::mutex> _ {shared->parkMutex};
+            shared->epoch++;
         }
-        data->_condition.notify_all();
+        shared->condition.notify_all();
     }
 }
 
-template <typename Func, typename ...Args>
-inline void ThreadPool::execute(Func &&functor, Args &&...args) {
-    {
-        std::lock_guard<std::mutex> _ { _data->_mutex};
-        // _data->_tasks.emplace(Callable::make(
-        //     std::forward<Func>(functor), std::forward<Args>(args)...));
-        _data->_tasks.emplace([=] {functor(std::move(args)...);});
-    }
-    _data->_condition.notify_one();
-}
-
-inline void ThreadPool::run() {
-    std::thread { [this] {
-        auto data = _data; // lifecycle
-        std::unique_lock<std::mutex> lock {data->_mutex};
-        for(;;) {
-            if(!data->_tasks.empty()) {
-                auto task = std::move(data->_tasks.front());
-                data->_tasks.pop();
-                lock.unlock();
-                if(task) task();
-                lock.lock();
-            } else if(data->_stop) {
-                break;
-            } else {
-                data->_condition.wait(lock);
-            }
+inline void ThreadPool::run(std::shared_ptr<Shared> shared, size_t index) {
+    Worker *worker = shared->workers[index].get();
+    _local = {shared.get(), worker};
+    for(size_t idle = 0;;) {
+        if(Task *task = find(shared.get(), worker)) {
+            invoke(worker, task);
+            idle = 0;
+        } else if(++idle < SPIN_ROUNDS) {
+            std::this_thread::yield();
+        } else if(park(shared.get(), worker)) {
+            idle = 0;
+        } else {
+            break;
         }
-    }}.detach();
+    }
+    _local = {nullptr, nullptr};
+}
+
+inline Task* ThreadPool::find(Shared *shared, Worker *worker) {
+    if(worker) {
+        if(Task *task = worker->deque.pop()) return task;
+    }
+    if(Task *task = fetchInjected(shared, worker)) return task;
+    return steal(shared, worker);
+}
+
+inline Task* ThreadPool::fetchInjected(Shared *shared, Worker *worker) {
+    if(shared->injectedSize.load(std::memory_order_relaxed) == 0) return nullptr;
+    std::lock_guard<std::mutex> _ {shared->injectMutex};
+    if(shared->injected.empty()) return nullptr;
+    Task *task = shared->injected.front();
+    shared->injected.pop_front();
+    size_t fetched = 1;
+    // the rest of the batch can be stolen by others
+    for(; worker && fetched < INJECT_BATCH && !shared->injected.empty(); ++fetched) {
+        worker->deque.push(shared->injected.front());
+        shared->injected.pop_front();
+    }
+    shared->injectedSize.fetch_sub(fetched, std::memory_order_relaxed);
+    return task;
+}
+
+inline Task* ThreadPool::steal(Shared *shared, Worker *worker) {
+    static thread_local uint64_t helperRandom = std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+    auto &workers = shared->workers;
+    size_t n = workers.size();
+    size_t start = nextRandom(worker ? worker->random : helperRandom) % n;
+    for(size_t i = 0; i < n; ++i) {
+        Worker *victim = workers[(start + i) % n].get();
+        if(victim == worker) continue;
+        if(Task *task = victim->deque.steal()) {
+            if(worker) worker->stolen.store(worker->stolen.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+inline void ThreadPool::invoke(Worker *worker, Task *task) {
+    (*task)();
+    delete task;
+    if(worker) worker->executed.store(worker->executed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+inline bool ThreadPool::park(Shared *shared, Worker *worker) {
+    std::unique_lock<std::mutex> lock {shared->parkMutex};
+    shared->sleeping.fetch_add(1, std::memory_order_seq_cst);
+    // pairs with the fence in notify(): either the task is seen here, or the sleeper is seen there
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool working = hasWork(shared);
+    if(!working && !shared->stop.load()) {
+        uint64_t epoch = shared->epoch;
+        worker->parks.store(worker->parks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        shared->condition.wait(lock, [&] { return shared->epoch != epoch || shared->stop.load(); });
+        working = true;
+    }
+    shared->sleeping.fetch_sub(1, std::memory_order_relaxed);
+    return working;
+}
+
+inline void ThreadPool::notify(Shared *shared) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(shared->sleeping.load(std::memory_order_relaxed) == 0) return;
+    {
+        std::lock_guard<std::mutex> _ {shared->parkMutex};
+        shared->epoch++;
+    }
+    shared->condition.notify_one();
+}
+
+inline bool ThreadPool::hasWork(Shared *shared) {
+    if(shared->injectedSize.load(std::memory_order_relaxed)) return true;
+    for(auto &worker : shared->workers) {
+        if(!worker->deque.empty()) return true;
+    }
+    return false;
+}
+
+inline uint64_t ThreadPool::nextRandom(uint64_t &state) {
+    // xorshift64
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
 }
 
 } // fluent
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,135 @@
+#ifndef __FLUENT_UTILS_WORK_STEALING_DEQUE_H__
+#define __FLUENT_UTILS_WORK_STEALING_DEQUE_H__
+#include <bits/stdc++.h>
+namespace fluent {
+
+// Chase-Lev deque (Le, Pop, Cohen, Zappa Nardelli, PPoPP'13 C11 version)
+// the owner pushes and pops at the bottom (LIFO), thieves steal at the top (FIFO)
+// T: pointer, nullptr means empty
+//
+// the ring grows by the owner, old rings are kept until destruction
+// because a thief may still be reading them
+template <typename T>
+class WorkStealingDeque {
+    static_assert(std::is_pointer<T>::value, "element must be a pointer");
+
+public:
+    constexpr static size_t INIT_CAPACITY = 256;
+
+    // owner only
+    void push(T item);
+    // owner only, nullptr if empty
+    T pop();
+    // any thread, nullptr if empty or lost the race
+    T steal();
+
+    // approximate
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+
+    WorkStealingDeque();
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+private:
+    struct Ring {
+        int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+
+        explicit Ring(int64_t capacity)
+            : mask(capacity - 1), slots(new std::atomic<T>[capacity]) {}
+        int64_t capacity() const { return mask + 1; }
+        T load(int64_t index) const { return slots[index & mask].load(std::memory_order_relaxed); }
+        void store(int64_t index, T item) { slots[index & mask].store(item, std::memory_order_relaxed); }
+    };
+
+    Ring* grow(Ring *ring, int64_t top, int64_t bottom);
+
+private:
+    alignas(64) std::atomic<int64_t> _top {0};
+    alignas(64) std::atomic<int64_t> _bottom {0};
+    std::atomic<Ring*> _ring;
+    // owner only
+    std::vector<std::unique_ptr<Ring>> _rings;
+};
+
+template <typename T>
+inline void WorkStealingDeque<T>::push(T item) {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed);
+    int64_t top = _top.load(std::memory_order_acquire);
+    Ring *ring = _ring.load(std::memory_order_relaxed);
+    if(bottom - top > ring->capacity() - 1) {
+        ring = grow(ring, top, bottom);
+    }
+    ring->store(bottom, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    _bottom.store(bottom + 1, std::memory_order_relaxed);
+}
+
+template <typename T>
+inline T WorkStealingDeque<T>::pop() {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+    Ring *ring = _ring.load(std::memory_order_relaxed);
+    _bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = _top.load(std::memory_order_relaxed);
+    if(top > bottom) {
+        // empty
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    T item = ring->load(bottom);
+    if(top == bottom) {
+        // the last one, race with thieves
+        if(!_top.compare_exchange_strong(top, top + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            item = nullptr;
+        }
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return item;
+}
+
+template <typename T>
+inline T WorkStealingDeque<T>::steal() {
+    int64_t top = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = _bottom.load(std::memory_order_acquire);
+    if(top >= bottom) return nullptr;
+    // consume
+    Ring *ring = _ring.load(std::memory_order_acquire);
+    T item = ring->load(top);
+    if(!_top.compare_exchange_strong(top, top + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return item;
+}
+
+template <typename T>
+inline size_t WorkStealingDeque<T>::size() const {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed);
+    int64_t top = _top.load(std::memory_order_relaxed);
+    return bottom > top ? bottom - top : 0;
+}
+
+template <typename T>
+inline WorkStealingDeque<T>::WorkStealingDeque() {
+    _rings.emplace_back(std::make_unique<Ring>(INIT_CAPACITY));
+    _ring.store(_rings.back().get(), std::memory_order_relaxed);
+}
+
+template <typename T>
+inline typename WorkStealingDeque<T>::Ring* WorkStealingDeque<T>::grow(Ring *ring, int64_t top, int64_t bottom) {
+    auto bigger = std::make_unique<Ring>(ring->capacity() << 1);
+    for(int64_t i = top; i < bottom; ++i) {
+        bigger->store(i, ring->load(i));
+    }
+    ring = bigger.get();
+    _rings.emplace_back(std::move(bigger));
+    _ring.store(ring, std::memory_order_release);
+    return ring;
+}
+
+} // fluent
+#endif
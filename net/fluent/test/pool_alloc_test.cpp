@@ -0,0 +1,68 @@
+// allocations per accepted connection, steady state of connection churn
+// a closed context is reused by the pool in place, so an accept should not allocate
+//
+// g++ -std=c++17 -O2 -pthread pool_alloc_test.cpp -o pool_alloc_test && ./pool_alloc_test
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <bits/stdc++.h>
+#include "../fluent.hpp"
+
+using namespace fluent;
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    ++allocations;
+    if(void *p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+constexpr uint16_t PORT = 23520;
+constexpr size_t WARMUP = 256;
+constexpr size_t ROUNDS = 1024;
+// accept path, excluding the pool
+constexpr double BUDGET = 0.5;
+
+int main() {
+    Server server {InetAddress{INADDR_ANY, PORT}};
+    size_t connected = 0;
+    size_t closed = 0;
+    server.onConnect([&](Context*) { ++connected; });
+    server.onMessage([](Context *context) { context->input.hasRead(context->input.unread()); });
+    server.onClose([&](Context*) { ++closed; });
+    server.ready();
+
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(PORT);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    auto churn = [&](size_t rounds) {
+        for(size_t i = 0; i < rounds; ++i) {
+            int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            if(::connect(fd, (sockaddr*)&address, sizeof address)) {
+                perror("connect");
+                std::exit(1);
+            }
+            for(size_t expect = connected + 1; connected < expect;) server.batch();
+            ::close(fd);
+            for(size_t expect = closed + 1; closed < expect;) server.batch();
+        }
+    };
+
+    churn(WARMUP);
+    auto before = server.connectionStats();
+    size_t begin = allocations;
+    churn(ROUNDS);
+    double perAccept = double(allocations - begin) / ROUNDS;
+    auto after = server.connectionStats();
+
+    std::cout << "allocations per accept: " << perAccept << std::endl;
+    std::cout << "pool capacity: " << before.capacity << " -> " << after.capacity << std::endl;
+    assert(after.capacity == before.capacity);
+    assert(perAccept <= BUDGET);
+    return perAccept <= BUDGET ? 0 : 1;
+}
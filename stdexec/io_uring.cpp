@@ -1,13 +1,22 @@
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <cstring>
-#include <mutex>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <vector>
+#include <stop_token>
+#include <chrono>
+#include <optional>
 #include <iostream>
 #include <thread>
 #include <ranges>
 #include <liburing.h>
 #include <stdexec/execution.hpp>
 #include <exec/async_scope.hpp>
+#include <exec/when_any.hpp>
 
 // Operations in stdexec are required to be address-stable.
 struct immovable {
@@ -15,16 +24,31 @@ struct immovable {
     immovable(immovable &&) = delete;
 };
 
+// Multi-threaded io_uring execution context.
+//
+// - One ring per worker thread. Each concurrent `run()` claims its own ring,
+//   so N threads calling `run()` drive N rings (`rings` in the constructor).
+// - SQEs of a ring are prepared only by its worker. An operation started by
+//   any other thread is forwarded to a ring as a task.
+// - `push()` is a lock-free MPSC intrusive queue, one per ring.
+// - Idle workers block in `io_uring_enter(GETEVENTS)`. A sleeping ring is woken up
+//   by `IORING_OP_MSG_RING` from another ring, or by its eventfd from a non-worker thread.
 struct io_uring_exec: immovable {
-    io_uring_exec(size_t uring_entries, int uring_flags = 0) {
-        if(int err = io_uring_queue_init(uring_entries, &_underlying_uring, uring_flags)) {
-            throw std::runtime_error(::strerror(-err));
-        }
-    }
-
-    ~io_uring_exec() {
-        io_uring_queue_exit(&_underlying_uring);
-    }
+    // Tasks run per loop, then the ring gets a chance to submit and reap.
+    constexpr static size_t task_batch = 64;
+
+    // Reserved `user_data`. Operations are at least 8-byte aligned so they never collide.
+    enum : uint64_t {
+        // MSG_RING cqe of the target ring.
+        wakeup_tag = 1,
+        // Multishot poll on the eventfd.
+        eventfd_tag = 2,
+        // Failed MSG_RING cqe of the source ring, tagged to the target ring pointer.
+        msg_ring_tag = 3,
+        // Completions nobody waits for: cancel requests and linked timeouts.
+        ignore_tag = 4,
+        tag_mask = 7
+    };
 
     // (Receiver) Types erasure support.
     template <typename Result>
@@ -38,23 +62,153 @@ struct io_uring_exec: immovable {
     // NOTE: The io_uring-specified task is queued by an interal ring of io_uring.
     struct task: immovable, vtable<decltype(std::ignore)> {
         void complete(result_t) override {}
-        task *next{this};
+        std::atomic<task*> next {nullptr};
+    };
+
+    // Vyukov's intrusive MPSC queue.
+    // Producers (any thread) cost one xchg, the consumer is the worker of the ring.
+    struct task_queue: immovable {
+        void push(task *op) noexcept {
+            op->next.store(nullptr, std::memory_order_relaxed);
+            // seq_cst: ordered with `local_ring::sleeping`, see `io_uring_exec::push()`.
+            task *prev = _head.exchange(op, std::memory_order_seq_cst);
+            prev->next.store(op, std::memory_order_release);
+        }
+
+        // Consumer only.
+        task* pop() noexcept {
+            task *tail = _tail;
+            task *next = tail->next.load(std::memory_order_acquire);
+            if(tail == &_stub) {
+                if(!next) return nullptr;
+                _tail = tail = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+            if(next) {
+                _tail = next;
+                return tail;
+            }
+            // A producer has not linked its node yet.
+            if(tail != _head.load(std::memory_order_acquire)) return nullptr;
+            push(&_stub);
+            next = tail->next.load(std::memory_order_acquire);
+            if(next) {
+                _tail = next;
+                return tail;
+            }
+            return nullptr;
+        }
+
+        // Consumer only.
+        // A node being linked counts as non-empty, the worker must not sleep on it.
+        bool empty() const noexcept {
+            return _tail == &_stub && _head.load(std::memory_order_seq_cst) == &_stub;
+        }
+
+        task _stub;
+        alignas(64) std::atomic<task*> _head {&_stub};
+        alignas(64) task *_tail {&_stub};
+    };
+
+    // A ring with its task queue, driven by one `run()` thread at a time.
+    struct local_ring: immovable {
+        local_ring(io_uring_exec *owner, size_t uring_entries, int uring_flags): owner(owner) {
+            if(int err = io_uring_queue_init(uring_entries, &underlying_uring, uring_flags)) {
+                throw std::runtime_error(::strerror(-err));
+            }
+            if((event_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+                int err = errno;
+                io_uring_queue_exit(&underlying_uring);
+                throw std::system_error(err, std::generic_category());
+            }
+            arm_eventfd();
+            io_uring_submit(&underlying_uring);
+        }
+
+        ~local_ring() {
+            io_uring_queue_exit(&underlying_uring);
+            ::close(event_fd);
+        }
+
+        // The SQ ring may be full, flush it and try again.
+        io_uring_sqe* get_sqe() noexcept {
+            if(auto sqe = io_uring_get_sqe(&underlying_uring)) [[likely]] {
+                return sqe;
+            }
+            io_uring_submit(&underlying_uring);
+            return io_uring_get_sqe(&underlying_uring);
+        }
+
+        // Wake up the worker blocked in `io_uring_enter()`, from any thread.
+        void notify() noexcept {
+            ::eventfd_write(event_fd, 1);
+        }
+
+        // Wake up `target` from this ring, no eventfd syscall on the target side.
+        void msg_ring(local_ring &target) noexcept {
+            auto sqe = get_sqe();
+            if(!sqe) [[unlikely]] {
+                return target.notify();
+            }
+            io_uring_prep_msg_ring(sqe, target.underlying_uring.ring_fd, 0, wakeup_tag, 0);
+            io_uring_sqe_set_data64(sqe, std::bit_cast<uint64_t>(&target) | msg_ring_tag);
+            io_uring_sqe_set_flags(sqe, IOSQE_CQE_SKIP_SUCCESS);
+            // The pusher is in the middle of its turn, don't wait for the next submit.
+            io_uring_submit(&underlying_uring);
+        }
+
+        // Make room for a chain of `n` sqes, a link must not be split across submissions.
+        bool reserve(unsigned n) noexcept {
+            if(io_uring_sq_space_left(&underlying_uring) < n) {
+                io_uring_submit(&underlying_uring);
+            }
+            return io_uring_sq_space_left(&underlying_uring) >= n;
+        }
+
+        void arm_eventfd() noexcept {
+            if(auto sqe = get_sqe()) [[likely]] {
+                io_uring_prep_poll_multishot(sqe, event_fd, POLLIN);
+                io_uring_sqe_set_data64(sqe, eventfd_tag);
+            }
+        }
+
+        io_uring_exec *owner;
+        io_uring underlying_uring;
+        int event_fd;
+        task_queue tasks;
+        // The worker is going to block in `io_uring_enter()`.
+        alignas(64) std::atomic<bool> sleeping {false};
+        // Claimed by a `run()`.
+        std::atomic<bool> running {false};
     };
 
+    io_uring_exec(size_t uring_entries, int uring_flags = 0, size_t rings = 1) {
+        rings = std::max<size_t>(rings, 1);
+        for(size_t i = 0; i < rings; ++i) {
+            _rings.emplace_back(std::make_unique<local_ring>(this, uring_entries, uring_flags));
+        }
+        // Linux 5.18+, or fall back to eventfd.
+        if(auto probe = io_uring_get_probe_ring(&_rings[0]->underlying_uring)) {
+            _msg_ring = io_uring_opcode_supported(probe, IORING_OP_MSG_RING);
+            io_uring_free_probe(probe);
+        }
+    }
+
     // Required by stdexec.
     template <stdexec::receiver Receiver>
     struct operation: task {
         using operation_state_concept = stdexec::operation_state_t;
-        operation(Receiver receiver, io_uring_exec *uring) noexcept
-            : receiver(std::move(receiver)), uring(uring) {}
+        operation(Receiver receiver, io_uring_exec *uring, local_ring *target) noexcept
+            : receiver(std::move(receiver)), uring(uring), target(target) {}
         void start() noexcept {
-            uring->push(this);
+            uring->push(this, target);
         }
         void complete(result_t) override {
             stdexec::set_value(std::move(receiver));
         }
         Receiver receiver;
         io_uring_exec *uring;
+        local_ring *target;
     };
 
     // Required by stdexec.
@@ -66,128 +220,305 @@ struct io_uring_exec: immovable {
                                         stdexec::set_stopped_t()>;
         template <stdexec::receiver Receiver>
         operation<Receiver> connect(Receiver receiver) noexcept {
-            return {std::move(receiver), uring};
+            return {std::move(receiver), uring, target};
         }
         io_uring_exec *uring;
+        local_ring *target;
     };
 
     // Required by stdexec.
     struct scheduler {
         io_uring_exec *uring;
+        // nullptr: the ring of the current worker, or round-robin from other threads.
+        local_ring *target {nullptr};
         auto operator<=>(const scheduler &) const=default;
-        sender schedule() noexcept { return {uring}; }
+        sender schedule() noexcept { return {uring, target}; }
     };
 
     scheduler get_scheduler() noexcept { return {this}; }
 
+    // Pinned to a ring, e.g. to shard the work by key.
+    scheduler get_scheduler(size_t ring_index) noexcept {
+        return {this, _rings[ring_index % _rings.size()].get()};
+    }
+
+    size_t ring_count() const noexcept { return _rings.size(); }
+
     // External structured callbacks support.
     struct uring_operation {
         using result_t = decltype(std::declval<io_uring_cqe>().res);
         using base = vtable<result_t>;
     };
 
-    // TODO: Concurrent run().
-    void run() {
-        // TODO: stop_token.
-        for(task *first_task;;) {
-            for(task *op = first_task = pop(); op; op = pop()) {
+    // Drive a ring until `stop_token` is requested.
+    // Concurrent `run()`s drive different rings, throw if all rings are claimed.
+    void run(std::stop_token stop_token = {}) {
+        local_ring &self = claim();
+        auto previous = std::exchange(_current, &self);
+        // Runs in the requesting thread.
+        std::stop_callback on_stop {stop_token, [&self] { self.notify(); }};
+        while(!stop_token.stop_requested()) {
+            for(size_t n = 0; n < task_batch; ++n) {
+                task *op = self.tasks.pop();
+                if(!op) break;
                 op->complete({});
             }
 
-            {
-                std::lock_guard _{_mutex};
-                // We didn't know how many inflight operations here.
-                // See the comments on `coroutine.h`.
-                // TL;DR: submitted seqs != inflight cqes
-                /* int submitted_sqes = */ io_uring_submit(&_underlying_uring);
+            // Dekker-style with `push()`:
+            // either the new task is seen here, or the sleeping flag is seen there.
+            self.sleeping.store(true, std::memory_order_seq_cst);
+            bool idle = self.tasks.empty() && !stop_token.stop_requested();
+            // We didn't know how many inflight operations here.
+            // See the comments on `coroutine.h`.
+            // TL;DR: submitted seqs != inflight cqes
+            if(idle) {
+                // GETEVENTS: woken up by any cqe (I/O, MSG_RING or eventfd).
+                io_uring_submit_and_wait(&self.underlying_uring, 1);
+            } else {
+                io_uring_submit(&self.underlying_uring);
             }
+            self.sleeping.store(false, std::memory_order_relaxed);
 
-            io_uring_cqe *cqe;
-            unsigned head;
-            unsigned done = 0;
-            // Reap one operation / multiple operations.
-            // NOTE: One sqe can generate multiple cqes.
-            io_uring_for_each_cqe(&_underlying_uring, head, cqe) {
-                done++;
-                auto uring_op = std::bit_cast<uring_operation::base*>(cqe->user_data);
-                uring_op->complete(cqe->res);
-            }
-            if(done) {
-                io_uring_cq_advance(&_underlying_uring, done);
-            } else if(!first_task) {
-                std::this_thread::yield();
-            }
+            reap(self);
         }
+        _current = previous;
+        self.running.store(false, std::memory_order_release);
     }
 
-    task* pop() noexcept {
-        // Read only.
-        if(_head.next == &_head) {
-            return nullptr;
+    // Any thread, lock-free.
+    // target == nullptr: the current ring, or round-robin from non-worker threads.
+    void push(task *op, local_ring *target = nullptr) noexcept {
+        local_ring *self = local();
+        if(!target) {
+            target = self ? self : _rings[_round_robin.fetch_add(1, std::memory_order_relaxed) % _rings.size()].get();
+        }
+        target->tasks.push(op);
+        // It is running now.
+        if(target == self) return;
+        // Only the first pusher wakes it up.
+        if(!target->sleeping.exchange(false, std::memory_order_seq_cst)) return;
+        if(self && _msg_ring) {
+            self->msg_ring(*target);
+        } else {
+            target->notify();
+        }
+    }
+
+    // The ring of this thread, nullptr if not a worker of this context.
+    local_ring* local() const noexcept {
+        return _current && _current->owner == this ? _current : nullptr;
+    }
+
+private:
+    local_ring& claim() {
+        for(auto &ring : _rings) {
+            bool expected = false;
+            if(ring->running.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                return *ring;
+            }
         }
-        std::lock_guard _{_mutex};
-        auto popped = std::exchange(_head.next, _head.next -> next);
-        if(popped == _tail) _tail = &_head;
-        return popped;
+        throw std::logic_error("io_uring_exec: more concurrent run() than rings");
     }
 
-    void push(task *op) noexcept {
-        std::lock_guard _{_mutex};
-        op->next = &_head;
-        _tail = _tail->next = op;
+    void reap(local_ring &self) {
+        io_uring_cqe *cqe;
+        unsigned head;
+        unsigned done = 0;
+        // Reap one operation / multiple operations.
+        // NOTE: One sqe can generate multiple cqes.
+        io_uring_for_each_cqe(&self.underlying_uring, head, cqe) {
+            done++;
+            auto user_data = cqe->user_data;
+            if(user_data == wakeup_tag || user_data == ignore_tag) {
+                continue;
+            }
+            if(user_data == eventfd_tag) {
+                eventfd_t ignored;
+                ::eventfd_read(self.event_fd, &ignored);
+                if(!(cqe->flags & IORING_CQE_F_MORE)) self.arm_eventfd();
+                continue;
+            }
+            if((user_data & tag_mask) == msg_ring_tag) {
+                // MSG_RING failed (e.g. the target CQ overflowed).
+                std::bit_cast<local_ring*>(user_data & ~uint64_t(tag_mask))->notify();
+                continue;
+            }
+            auto uring_op = std::bit_cast<uring_operation::base*>(user_data);
+            uring_op->complete(cqe->res);
+        }
+        if(done) {
+            io_uring_cq_advance(&self.underlying_uring, done);
+        }
     }
 
-    task _head, *_tail{&_head};
-    std::mutex _mutex;
-    io_uring _underlying_uring;
+    // Read-only after construction.
+    std::vector<std::unique_ptr<local_ring>> _rings;
+    alignas(64) std::atomic<size_t> _round_robin {0};
+    bool _msg_ring {false};
+    static inline thread_local local_ring *_current {nullptr};
 };
 
+// -ETIME is the expected completion of a timer, not an error.
+template <auto F>
+inline constexpr bool uring_timer_v = false;
+
+inline __kernel_timespec to_kernel_timespec(std::chrono::nanoseconds duration) noexcept {
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(duration);
+    return {.tv_sec = seconds.count(), .tv_nsec = (duration - seconds).count()};
+}
+
 template <auto F, stdexec::receiver Receiver, typename ...Args>
-struct io_uring_exec_initiating_operation: immovable, io_uring_exec::uring_operation::base {
+struct io_uring_exec_initiating_operation: io_uring_exec::task, io_uring_exec::uring_operation::base {
     using operation_state_concept = stdexec::operation_state_t;
+    using operation_base = io_uring_exec::uring_operation::base;
+    using io_result_t = io_uring_exec::uring_operation::result_t;
+    using stop_token_t = stdexec::stop_token_of_t<stdexec::env_of_t<Receiver>>;
+
+    // Runs in the thread requesting stop.
+    struct on_stop {
+        void operator()() noexcept { self->request_cancel(); }
+        io_uring_exec_initiating_operation *self;
+    };
+    using stop_callback_t = stdexec::stop_callback_for_t<stop_token_t, on_stop>;
+
+    // Submits IORING_OP_ASYNC_CANCEL in the worker of the ring.
+    struct canceller: io_uring_exec::task {
+        explicit canceller(io_uring_exec_initiating_operation *self) noexcept: self(self) {}
+        void complete(result_t) override { self->cancel(); }
+        io_uring_exec_initiating_operation *self;
+    };
+
     io_uring_exec_initiating_operation(Receiver receiver,
                                        io_uring_exec *uring,
-                                       std::tuple<Args...> args) noexcept
+                                       io_uring_exec::local_ring *target,
+                                       std::tuple<Args...> args,
+                                       std::optional<__kernel_timespec> timeout) noexcept
         : receiver(std::move(receiver)),
           uring(uring),
-          args(std::move(args)) {}
+          target(target),
+          args(std::move(args)),
+          timeout(timeout) {}
 
+    // SQEs of a ring are prepared only by its worker.
     void start() noexcept {
-        if(auto sqe = io_uring_get_sqe(&uring->_underlying_uring)) [[likely]] {
-            using operation_base = io_uring_exec::uring_operation::base;
-            io_uring_sqe_set_data(sqe, static_cast<operation_base*>(this));
-            std::apply(F, std::tuple_cat(std::tuple(sqe), std::move(args)));
+        auto self = uring->local();
+        if(self && (!target || target == self)) [[likely]] {
+            prepare(*self);
         } else {
+            uring->push(this, target);
+        }
+    }
+
+    // Forwarded from another thread, now in the worker.
+    void complete(io_uring_exec::task::result_t) override {
+        prepare(*uring->local());
+    }
+
+    void prepare(io_uring_exec::local_ring &ring) noexcept {
+        auto stop_token = stdexec::get_stop_token(stdexec::get_env(receiver));
+        if(stop_token.stop_requested()) {
+            stdexec::set_stopped(std::move(receiver));
+            return;
+        }
+        auto sqe = ring.reserve(timeout ? 2 : 1) ? ring.get_sqe() : nullptr;
+        if(!sqe) [[unlikely]] {
             // RETURN VALUE
             // io_uring_get_sqe(3)  returns  a  pointer  to the next submission
             // queue event on success and NULL on failure. If NULL is returned,
             // the SQ ring is currently full and entries must be submitted  for
             // processing before new ones can get allocated.
-            try {
-                throw std::system_error(EBUSY, std::generic_category());
-            } catch(...) {
-                stdexec::set_error(std::move(receiver), std::current_exception());
-            }
+            return fail(EBUSY);
+        }
+        io_uring_sqe_set_data(sqe, static_cast<operation_base*>(this));
+        // By reference: pointers to the arguments (e.g. a timespec) must outlive the submission.
+        std::apply([sqe](auto &...args) { F(sqe, args...); }, args);
+        if(timeout) {
+            // The operation completes with -ECANCELED if the timeout fires first.
+            io_uring_sqe_set_flags(sqe, sqe->flags | IOSQE_IO_LINK);
+            auto timeout_sqe = ring.get_sqe();
+            io_uring_prep_link_timeout(timeout_sqe, &*timeout, 0);
+            io_uring_sqe_set_data64(timeout_sqe, io_uring_exec::ignore_tag);
+        }
+        this->ring = &ring;
+        if constexpr (!stdexec::unstoppable_token<stop_token_t>) {
+            stop_callback.emplace(std::move(stop_token), on_stop{this});
+        }
+    }
+
+    void complete(io_result_t cqe_res) override {
+        // Waits for a running `on_stop`, nothing can be cancelled after this.
+        stop_callback.reset();
+        result = cqe_res;
+        completed = true;
+        // The canceller is still queued and refers to this operation.
+        if(cancel_requested.load(std::memory_order_acquire) && !cancel_done) {
+            return;
+        }
+        deliver();
+    }
+
+    // Any thread, once.
+    void request_cancel() noexcept {
+        if(cancel_requested.exchange(true, std::memory_order_acq_rel)) return;
+        uring->push(&_canceller, ring);
+    }
+
+    // In the worker of `ring`.
+    void cancel() noexcept {
+        cancel_done = true;
+        // Lost the race with the cqe, its user_data may be reused already.
+        if(completed) {
+            return deliver();
+        }
+        // Best effort, a failed cancel (e.g. -EALREADY) still ends with the cqe.
+        if(auto sqe = ring->get_sqe()) [[likely]] {
+            io_uring_prep_cancel(sqe, static_cast<operation_base*>(this), 0);
+            io_uring_sqe_set_data64(sqe, io_uring_exec::ignore_tag);
+            io_uring_sqe_set_flags(sqe, IOSQE_CQE_SKIP_SUCCESS);
         }
     }
 
-    void complete(result_t cqe_res) override {
+    void deliver() noexcept {
+        auto cqe_res = result;
+        if constexpr (uring_timer_v<F>) {
+            if(cqe_res == -ETIME) cqe_res = 0;
+        }
         if(cqe_res == -ECANCELED) {
+            // Cancelled by the linked timeout, not by a stop request.
+            if(timeout && !cancel_requested.load(std::memory_order_relaxed)) {
+                return fail(ETIMEDOUT);
+            }
             stdexec::set_stopped(std::move(receiver));
         } else if(cqe_res < 0) {
-            try {
-                throw std::system_error(-cqe_res, std::generic_category());
-            } catch(...) {
-                stdexec::set_error(std::move(receiver), std::current_exception());
-            }
+            fail(-cqe_res);
         } else [[likely]] {
             stdexec::set_value(std::move(receiver), cqe_res);
         }
     }
 
+    void fail(int error) noexcept {
+        try {
+            throw std::system_error(error, std::generic_category());
+        } catch(...) {
+            stdexec::set_error(std::move(receiver), std::current_exception());
+        }
+    }
+
     Receiver receiver;
     io_uring_exec *uring;
+    io_uring_exec::local_ring *target;
     std::tuple<Args...> args;
+    // Linked timeout.
+    std::optional<__kernel_timespec> timeout;
+    // Where the sqe is in flight.
+    io_uring_exec::local_ring *ring {nullptr};
+    std::optional<stop_callback_t> stop_callback;
+    canceller _canceller {this};
+    std::atomic<bool> cancel_requested {false};
+    // Worker only.
+    bool cancel_done {false};
+    bool completed {false};
+    io_result_t result {};
 };
 
 template <auto F, typename ...Args>
@@ -201,11 +532,13 @@ struct io_uring_exec_sender {
     template <stdexec::receiver Receiver>
     io_uring_exec_initiating_operation<F, Receiver, Args...>
     connect(Receiver receiver) noexcept {
-        return {std::move(receiver), uring, std::move(args)};
+        return {std::move(receiver), uring, target, std::move(args), timeout};
     }
 
     io_uring_exec *uring;
+    io_uring_exec::local_ring *target;
     std::tuple<Args...> args;
+    std::optional<__kernel_timespec> timeout {};
 };
 
 
@@ -215,7 +548,7 @@ stdexec::sender_of<
     stdexec::set_value_t(io_uring_exec::uring_operation::result_t /* cqe->res */),
     stdexec::set_error_t(std::exception_ptr)>
 auto make_uring_sender(io_uring_exec::scheduler s, Args ...args) noexcept {
-    return io_uring_exec_sender<F, Args...>{s.uring, std::tuple(std::move(args)...)};
+    return io_uring_exec_sender<F, Args...>{s.uring, s.target, std::tuple(std::move(args)...)};
 }
 
 // On  files  that  support seeking, if the `offset` is set to -1, the read operation commences at the file offset,
@@ -233,6 +566,40 @@ auto async_write(io_uring_exec::scheduler s, int fd, const void *buf, size_t n,
     return make_uring_sender<io_uring_prep_write>(s, fd, buf, n, offset);
 }
 
+inline void uring_prep_timer(io_uring_sqe *sqe, __kernel_timespec &ts) noexcept {
+    io_uring_prep_timeout(sqe, &ts, 0, 0);
+}
+
+template <>
+inline constexpr bool uring_timer_v<uring_prep_timer> = true;
+
+// Completes with 0 after `duration`, or stopped if cancelled through the stop token.
+stdexec::sender
+auto async_timeout(io_uring_exec::scheduler s, std::chrono::nanoseconds duration) noexcept {
+    return make_uring_sender<uring_prep_timer>(s, to_kernel_timespec(duration));
+}
+
+// IOSQE_IO_LINK + IORING_OP_LINK_TIMEOUT, no extra sender or thread is involved.
+// The operation is cancelled by the kernel and completes with ETIMEDOUT.
+template <auto F, typename ...Args>
+auto with_timeout(io_uring_exec_sender<F, Args...> sender, std::chrono::nanoseconds duration) noexcept {
+    sender.timeout = to_kernel_timespec(duration);
+    return sender;
+}
+
+// Deadline for any sender, e.g. a chain of operations.
+// The loser of `when_any` is cancelled through its stop token (IORING_OP_ASYNC_CANCEL).
+template <stdexec::sender Sender>
+auto with_deadline(io_uring_exec::scheduler s, Sender &&sender, std::chrono::nanoseconds duration) {
+    return exec::when_any(
+        std::forward<Sender>(sender),
+        async_timeout(s, duration)
+          | stdexec::let_value([](auto...) {
+                return stdexec::just_error(
+                    std::make_exception_ptr(std::system_error(ETIMEDOUT, std::generic_category())));
+            }));
+}
+
 int main() {
     
     int fd = (::unlink("/tmp/jojo"), ::open("/tmp/jojo", O_RDWR|O_TRUNC|O_CREAT, 0666));
@@ -240,7 +607,8 @@ int main() {
         std::cerr << ::strerror(errno) , std::abort();
     }
 
-    io_uring_exec uring(512);
+    // 4 rings, one per `run()` thread.
+    io_uring_exec uring(512, 0, 4);
     auto scheduler = uring.get_scheduler();
     exec::async_scope scope;
     auto s1 =
@@ -269,13 +637,38 @@ int main() {
                 });
         });
 
-    std::jthread j {[&] { uring.run(); }};
+    // Hop from ring 0 to ring 3, the sleeping worker is woken up by MSG_RING.
+    auto s3 =
+        stdexec::schedule(uring.get_scheduler(0))
+      | stdexec::let_value([&] {
+            return stdexec::schedule(uring.get_scheduler(3))
+              | stdexec::then([] { return 3; });
+        });
+
+    std::vector<std::jthread> workers;
+    for(size_t i = 0; i < uring.ring_count(); ++i) {
+        workers.emplace_back([&](std::stop_token stop_token) { uring.run(stop_token); });
+    }
 
     // scope.spawn(std::move(s1) | stdexec::then([](...) {}));
     // scope.spawn(std::move(s2) | stdexec::then([](...) {}));
     // stdexec::sync_wait(scope.on_empty());
 
-    auto a = stdexec::when_all(std::move(s1), std::move(s2));
-    auto [v1, v2] = stdexec::sync_wait(std::move(a)).value();
-    std::cout << "ans: " << v1 << ' ' << v2 << std::endl;
+    auto a = stdexec::when_all(std::move(s1), std::move(s2), std::move(s3));
+    auto [v1, v2, v3] = stdexec::sync_wait(std::move(a)).value();
+    std::cout << "ans: " << v1 << ' ' << v2 << ' ' << v3 << std::endl;
+
+    // A read that never completes, cancelled when the deadline wins.
+    int pipefd[2];
+    if(::pipe(pipefd)) {
+        std::cerr << ::strerror(errno) , std::abort();
+    }
+    char stuck;
+    auto s4 =
+        with_deadline(scheduler, async_read(scheduler, pipefd[0], &stuck, 1), std::chrono::milliseconds(100))
+      | stdexec::upon_error([](std::exception_ptr) {
+            std::cout << "deadline exceeded" << std::endl;
+            return 0;
+        });
+    stdexec::sync_wait(std::move(s4));
 }